@@ -0,0 +1,169 @@
+#include "ArgumentForm.h"
+
+#include <QButtonGroup>
+#include <QCheckBox>
+#include <QCoreApplication>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QIntValidator>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QPushButton>
+#include <QRadioButton>
+
+namespace {
+
+QString translate(const char *text)
+{
+    return QCoreApplication::translate("ArgumentForm", text);
+}
+
+void setProperties(QWidget *widget, const ArgSpec &arg)
+{
+    widget->setProperty("argType", arg.typeName);
+    widget->setProperty("argFlag", arg.flag);
+    widget->setProperty("argName", arg.name);
+    widget->setProperty("mandatory", arg.mandatory);
+}
+
+// The line edit of a path row, inside its widget with the browse button
+QWidget *pathField(QWidget *parent, QLineEdit *lineEdit, ArgSpec::Type type)
+{
+    QWidget *widget = new QWidget(parent);
+    QHBoxLayout *hLayout = new QHBoxLayout(widget);
+    QPushButton *button = new QPushButton("...", widget);
+    hLayout->addWidget(lineEdit);
+    hLayout->addWidget(button);
+    hLayout->setContentsMargins(0, 0, 0, 0);
+
+    QObject::connect(button, &QPushButton::clicked, lineEdit, [button, lineEdit, type]() {
+        QString path;
+        if (type == ArgSpec::File) {
+            path = QFileDialog::getOpenFileName(button->window(), translate("Select File"));
+        } else if (type == ArgSpec::NewFile) {
+            path = QFileDialog::getSaveFileName(button->window(), translate("Select File"));
+        } else { // folder, newfolder
+            path = QFileDialog::getExistingDirectory(button->window(), translate("Select Folder"));
+        }
+        if (!path.isEmpty()) {
+            lineEdit->setText(path);
+        }
+    });
+    return widget;
+}
+
+}
+
+namespace ArgumentForm {
+
+QWidget *addRow(QFormLayout *layout, QWidget *parent, const ArgSpec &arg,
+                QMap<QString, QButtonGroup*> *buttonGroups, const std::function<void()> &changed)
+{
+    if (arg.type == ArgSpec::Unknown) {
+        return nullptr;
+    }
+    QString styleSheet = arg.mandatory ? "color: red;" : "";
+
+    if (arg.type == ArgSpec::Boolean) {
+        QAbstractButton *button;
+        if (arg.exclusiveGroup.isEmpty()) {
+            button = new QCheckBox(arg.name, parent);
+        } else {
+            button = new QRadioButton(arg.name, parent);
+            button->setProperty("exclusiveGroup", arg.exclusiveGroup);
+            if (!buttonGroups->contains(arg.exclusiveGroup)) {
+                buttonGroups->insert(arg.exclusiveGroup, new QButtonGroup(parent));
+            }
+            buttonGroups->value(arg.exclusiveGroup)->addButton(button);
+        }
+        if (arg.hasDefault) {
+            button->setChecked(arg.defaultChecked);
+        }
+        button->setStyleSheet(styleSheet);
+        setProperties(button, arg);
+        layout->addRow(button);
+        QObject::connect(button, &QAbstractButton::toggled, button, changed);
+        return button;
+    }
+
+    QLabel *label = new QLabel(arg.name, parent);
+    label->setStyleSheet(styleSheet);
+
+    if (arg.type == ArgSpec::Files) {
+        QListWidget *listWidget = new QListWidget(parent);
+        listWidget->setStyleSheet(styleSheet);
+        if (arg.hasDefault) {
+            listWidget->addItems(arg.defaultFiles);
+        }
+        QPushButton *button = new QPushButton("...", parent);
+        QObject::connect(button, &QPushButton::clicked, listWidget, [button, listWidget, changed]() {
+            QStringList files = QFileDialog::getOpenFileNames(button->window(), translate("Select Files"));
+            if (!files.isEmpty()) {
+                listWidget->addItems(files);
+                changed();
+            }
+        });
+        QObject::connect(listWidget, &QListWidget::itemChanged, listWidget, changed);
+        setProperties(listWidget, arg);
+        layout->addRow(label, listWidget);
+        layout->addRow(button);
+        return listWidget;
+    }
+
+    // string, raw_string, integer and the paths
+    QLineEdit *lineEdit = new QLineEdit(parent);
+    lineEdit->setInputMethodHints(Qt::ImhNone);
+    if (arg.type == ArgSpec::Integer) {
+        lineEdit->setValidator(new QIntValidator(lineEdit));
+    }
+    if (arg.hasDefault) {
+        lineEdit->setText(arg.defaultText);
+    }
+    lineEdit->setStyleSheet(styleSheet);
+    QObject::connect(lineEdit, &QLineEdit::textChanged, lineEdit, changed);
+    QWidget *field = arg.isPath() ? pathField(parent, lineEdit, arg.type) : lineEdit;
+    setProperties(field, arg);
+    layout->addRow(label, field);
+    return field;
+}
+
+void setValue(QWidget *field, const ArgSpec &arg, const CommandLine::Values &values)
+{
+    if (!field) {
+        return;
+    }
+    if (QAbstractButton *button = qobject_cast<QAbstractButton*>(field)) {
+        button->setChecked(values.booleans.value(arg.name));
+    } else if (QListWidget *listWidget = qobject_cast<QListWidget*>(field)) {
+        listWidget->clear();
+        listWidget->addItems(values.files.value(arg.name));
+    } else if (QLineEdit *lineEdit = qobject_cast<QLineEdit*>(field)) {
+        lineEdit->setText(values.strings.value(arg.name));
+    } else if (QLineEdit *lineEdit = field->findChild<QLineEdit*>()) {
+        lineEdit->setText(values.strings.value(arg.name));
+    }
+}
+
+void value(const QWidget *field, const ArgSpec &arg, CommandLine::Values *values)
+{
+    if (!field) {
+        return;
+    }
+    if (const QAbstractButton *button = qobject_cast<const QAbstractButton*>(field)) {
+        values->booleans.insert(arg.name, button->isChecked());
+    } else if (const QListWidget *listWidget = qobject_cast<const QListWidget*>(field)) {
+        QStringList files;
+        for (int i = 0; i < listWidget->count(); ++i) {
+            files.append(listWidget->item(i)->text());
+        }
+        values->files.insert(arg.name, files);
+    } else if (const QLineEdit *lineEdit = qobject_cast<const QLineEdit*>(field)) {
+        values->strings.insert(arg.name, lineEdit->text());
+    } else if (const QLineEdit *lineEdit = field->findChild<QLineEdit*>()) {
+        values->strings.insert(arg.name, lineEdit->text());
+    }
+}
+
+}
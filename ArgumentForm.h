@@ -0,0 +1,32 @@
+#ifndef ARGUMENTFORM_H
+#define ARGUMENTFORM_H
+
+#include <QMap>
+#include <QString>
+#include <functional>
+#include "CommandCatalog.h"
+
+class QButtonGroup;
+class QFormLayout;
+class QWidget;
+
+// The form rows of a command's arguments. The main window and the pipeline
+// stages lay a command out with the same widgets.
+namespace ArgumentForm {
+
+// Adds the row of arg to layout, with its default, and returns the widget that
+// holds the value: a check box or radio button, a list of files, a line edit,
+// or for paths the line edit and its browse button. Radio buttons of one
+// exclusive group share a group of buttonGroups. changed follows every edit.
+// Arguments of an unknown type get no row and nullptr.
+QWidget *addRow(QFormLayout *layout, QWidget *parent, const ArgSpec &arg,
+                QMap<QString, QButtonGroup*> *buttonGroups, const std::function<void()> &changed);
+
+// Shows the value of arg in field, as addRow() made it
+void setValue(QWidget *field, const ArgSpec &arg, const CommandLine::Values &values);
+// Reads field back into values
+void value(const QWidget *field, const ArgSpec &arg, CommandLine::Values *values);
+
+}
+
+#endif // ARGUMENTFORM_H
@@ -0,0 +1,430 @@
+#include "BenchmarkDialog.h"
+#include "QuishProcess.h"
+#include "Launcher.h"
+#include "ResourceMonitor.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+
+static const int MAX_SAVED_RESULTS = 20;
+
+// A mean further than this from the previous one, and outside both spreads, is flagged
+static const double SIGNIFICANT_CHANGE = 0.05;
+
+static double toMs(const struct timeval &time)
+{
+    return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+}
+
+BenchmarkDialog::BenchmarkDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Benchmark"));
+    setMinimumSize(750, 450);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QFormLayout *optionsLayout = new QFormLayout();
+    m_runsSpinBox = new QSpinBox(this);
+    m_runsSpinBox->setRange(2, 10000);
+    m_runsSpinBox->setValue(10);
+    optionsLayout->addRow(tr("Runs:"), m_runsSpinBox);
+    m_warmupSpinBox = new QSpinBox(this);
+    m_warmupSpinBox->setRange(0, 1000);
+    m_warmupSpinBox->setValue(1);
+    optionsLayout->addRow(tr("Warmup runs:"), m_warmupSpinBox);
+    m_prepareLineEdit = new QLineEdit(this);
+    m_prepareLineEdit->setPlaceholderText(tr("Run before every run, not timed (e.g. sync; echo 3 > /proc/sys/vm/drop_caches)"));
+    optionsLayout->addRow(tr("Prepare command:"), m_prepareLineEdit);
+    m_outputComboBox = new QComboBox(this);
+    m_outputComboBox->addItem(tr("Discard"));
+    m_outputComboBox->addItem(tr("Keep the last run"));
+    optionsLayout->addRow(tr("Output:"), m_outputComboBox);
+    mainLayout->addLayout(optionsLayout);
+
+    QHBoxLayout *controlsLayout = new QHBoxLayout();
+    m_lblPrevious = new QLabel(this);
+    controlsLayout->addWidget(m_lblPrevious);
+    controlsLayout->addStretch();
+    m_lblProgress = new QLabel(this);
+    controlsLayout->addWidget(m_lblProgress);
+    m_btnStart = new QPushButton(QIcon(":/icons/Player Play.png"), tr("Start"), this);
+    m_btnStop = new QPushButton(QIcon(":/icons/Player Stop.png"), tr("Stop"), this);
+    m_btnStop->setEnabled(false);
+    controlsLayout->addWidget(m_btnStart);
+    controlsLayout->addWidget(m_btnStop);
+    mainLayout->addLayout(controlsLayout);
+
+    m_resultsTable = new QTableWidget(3, 8, this);
+    m_resultsTable->setHorizontalHeaderLabels(QStringList() << tr("Time") << tr("Mean ± σ") << tr("Median")
+                                              << tr("Min") << tr("Max") << tr("Outliers") << tr("Previous") << tr("Change"));
+    m_resultsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_resultsTable->verticalHeader()->setVisible(false);
+    m_resultsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    mainLayout->addWidget(m_resultsTable, 1);
+
+    m_txtOutput = new QPlainTextEdit(this);
+    QFont monospaceFont("Monospace");
+    monospaceFont.setStyleHint(QFont::Monospace);
+    m_txtOutput->setFont(monospaceFont);
+    m_txtOutput->setReadOnly(true);
+    m_txtOutput->setVisible(false);
+    mainLayout->addWidget(m_txtOutput, 1);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+
+    connect(m_btnStart, &QPushButton::clicked, this, &BenchmarkDialog::onStartClicked);
+    connect(m_btnStop, &QPushButton::clicked, this, &BenchmarkDialog::onStopClicked);
+}
+
+void BenchmarkDialog::setCommand(const QString &key, const QString &commandLine, const QString &workingDirectory)
+{
+    m_key = key;
+    m_commandLine = commandLine;
+    m_workingDirectory = workingDirectory;
+    setWindowTitle(tr("Benchmark - %1").arg(key));
+
+    QJsonArray history = loadAll().value(m_key).toObject().value("history").toArray();
+    m_previous = history.isEmpty() ? QJsonObject() : history.last().toObject();
+    showPrevious();
+}
+
+BenchmarkStats BenchmarkDialog::computeStats(QVector<double> samples)
+{
+    BenchmarkStats stats;
+    const int n = samples.size();
+    if (n == 0) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    stats.min = samples.first();
+    stats.max = samples.last();
+    stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    stats.mean = sum / n;
+    if (n > 1) {
+        double squares = 0.0;
+        for (double sample : samples) {
+            squares += (sample - stats.mean) * (sample - stats.mean);
+        }
+        stats.stddev = std::sqrt(squares / (n - 1));
+    }
+
+    // Modified z-score (Iglewicz and Hoaglin), as used by hyperfine
+    QVector<double> deviations;
+    deviations.reserve(n);
+    for (double sample : samples) {
+        deviations.append(std::fabs(sample - stats.median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    double mad = n % 2 ? deviations[n / 2] : (deviations[n / 2 - 1] + deviations[n / 2]) / 2.0;
+    if (mad > 0.0) {
+        for (double sample : samples) {
+            if (std::fabs(0.6745 * (sample - stats.median) / mad) > 3.5) {
+                stats.outliers++;
+            }
+        }
+    }
+    return stats;
+}
+
+void BenchmarkDialog::onStartClicked()
+{
+    if (m_commandLine.isEmpty()) {
+        return;
+    }
+
+    m_wall.clear();
+    m_user.clear();
+    m_system.clear();
+    m_txtOutput->clear();
+    m_txtOutput->setVisible(m_outputComboBox->currentIndex() == 1);
+    for (int row = 0; row < m_resultsTable->rowCount(); ++row) {
+        for (int column = 0; column < m_resultsTable->columnCount(); ++column) {
+            delete m_resultsTable->takeItem(row, column);
+        }
+    }
+
+    m_totalRuns = m_warmupSpinBox->value() + m_runsSpinBox->value();
+    m_runIndex = 0;
+    m_stopRequested = false;
+    m_btnStart->setEnabled(false);
+    m_btnStop->setEnabled(true);
+    m_runsSpinBox->setEnabled(false);
+    m_warmupSpinBox->setEnabled(false);
+    m_prepareLineEdit->setEnabled(false);
+    m_outputComboBox->setEnabled(false);
+    startNext();
+}
+
+void BenchmarkDialog::onStopClicked()
+{
+    m_stopRequested = true;
+    if (m_process) {
+        m_process->terminateGroup();
+    }
+}
+
+void BenchmarkDialog::reject()
+{
+    if (m_process) {
+        m_stopRequested = true;
+        m_process->disconnect(this);
+        m_process->killGroup();
+        m_process->waitForFinished(1000);
+        m_process->deleteLater();
+        m_process = nullptr;
+    }
+    QDialog::reject();
+}
+
+void BenchmarkDialog::startNext()
+{
+    if (m_stopRequested) {
+        finish(tr("Stopped after %1 of %2 runs.").arg(m_runIndex).arg(m_totalRuns));
+        return;
+    }
+    if (m_runIndex >= m_totalRuns) {
+        showResults();
+        return;
+    }
+
+    int warmup = m_warmupSpinBox->value();
+    if (m_runIndex < warmup) {
+        m_lblProgress->setText(tr("Warmup %1 / %2").arg(m_runIndex + 1).arg(warmup));
+    } else {
+        m_lblProgress->setText(tr("Run %1 / %2").arg(m_runIndex - warmup + 1).arg(m_runsSpinBox->value()));
+    }
+
+    bool prepare = !m_prepareLineEdit->text().trimmed().isEmpty();
+    m_phase = prepare ? Preparing : Measuring;
+    startProcess(!prepare);
+}
+
+void BenchmarkDialog::startProcess(bool measured)
+{
+    m_process = new QuishProcess(this);
+    m_process->setWorkingDirectory(m_workingDirectory);
+    m_process->setProcessChannelMode(QProcess::MergedChannels);
+
+    // Output of every run but the kept one never reaches us at all
+    bool keepOutput = measured && m_outputComboBox->currentIndex() == 1 && m_runIndex == m_totalRuns - 1;
+    if (!keepOutput) {
+        m_process->setStandardOutputFile(QProcess::nullDevice());
+    }
+    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, &BenchmarkDialog::onProcessFinished);
+    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError error) {
+        if (error != QProcess::FailedToStart) {
+            return;
+        }
+        QString message = m_process->errorString();
+        m_process->deleteLater();
+        m_process = nullptr;
+        finish(tr("Could not start: %1").arg(message));
+    });
+
+    if (!measured) {
+        m_process->start("/bin/sh", QStringList() << "-c" << m_prepareLineEdit->text());
+        return;
+    }
+
+    // Exec the command directly when possible so the shell is not measured with it
+    QStringList arguments = Launcher::argumentsFor(m_commandLine);
+    m_process->setCollectResourceUsage(true);
+    m_timer.start();
+    m_process->start(arguments.takeFirst(), arguments);
+}
+
+void BenchmarkDialog::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    double wallMs = m_timer.nsecsElapsed() / 1e6;
+    QuishProcess *process = m_process;
+    m_process = nullptr;
+    process->deleteLater();
+
+    if (m_stopRequested) {
+        startNext();
+        return;
+    }
+
+    bool failed = exitStatus != QProcess::NormalExit || exitCode != 0;
+    if (m_phase == Preparing) {
+        if (failed) {
+            finish(tr("The prepare command failed with exit code %1.").arg(exitCode));
+            return;
+        }
+        m_phase = Measuring;
+        startProcess(true);
+        return;
+    }
+
+    if (failed) {
+        finish(tr("The command failed with exit code %1 in run %2; fix it before benchmarking.").arg(exitCode).arg(m_runIndex + 1));
+        return;
+    }
+    if (m_outputComboBox->currentIndex() == 1 && m_runIndex == m_totalRuns - 1) {
+        m_txtOutput->setPlainText(QString::fromLocal8Bit(process->readAll()));
+    }
+    if (m_runIndex >= m_warmupSpinBox->value()) {
+        m_wall.append(wallMs);
+        if (process->hasResourceUsage()) {
+            m_user.append(toMs(process->resourceUsage().ru_utime));
+            m_system.append(toMs(process->resourceUsage().ru_stime));
+        }
+    }
+    m_runIndex++;
+    startNext();
+}
+
+void BenchmarkDialog::finish(const QString &message)
+{
+    m_phase = Idle;
+    m_lblProgress->setText(message);
+    m_btnStart->setEnabled(true);
+    m_btnStop->setEnabled(false);
+    m_runsSpinBox->setEnabled(true);
+    m_warmupSpinBox->setEnabled(true);
+    m_prepareLineEdit->setEnabled(true);
+    m_outputComboBox->setEnabled(true);
+}
+
+void BenchmarkDialog::showResults()
+{
+    BenchmarkStats wall = computeStats(m_wall);
+    BenchmarkStats user = computeStats(m_user);
+    BenchmarkStats system = computeStats(m_system);
+
+    setRow(0, tr("Wall"), wall, m_previous.value("wall").toObject());
+    setRow(1, tr("User"), user, m_previous.value("user").toObject());
+    setRow(2, tr("Sys"), system, m_previous.value("sys").toObject());
+
+    QJsonObject result;
+    result["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    result["command"] = m_commandLine;
+    result["prepare"] = m_prepareLineEdit->text();
+    result["runs"] = m_wall.size();
+    result["warmup"] = m_warmupSpinBox->value();
+    result["wall"] = statsToJson(wall);
+    result["user"] = statsToJson(user);
+    result["sys"] = statsToJson(system);
+
+    QJsonObject all = loadAll();
+    QJsonObject entry = all.value(m_key).toObject();
+    QJsonArray history = entry.value("history").toArray();
+    history.append(result);
+    while (history.size() > MAX_SAVED_RESULTS) {
+        history.removeFirst();
+    }
+    entry["history"] = history;
+    all[m_key] = entry;
+
+    QDir().mkpath(QFileInfo(benchmarksPath()).absolutePath());
+    QSaveFile file(benchmarksPath());
+    QString message = tr("Done: %1 runs.").arg(m_wall.size());
+    if (wall.outliers > 0) {
+        message += " " + tr("%n statistical outlier(s) in wall time: the system may be busy, or more warmup runs are needed.",
+                            nullptr, wall.outliers);
+    }
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(all).toJson()) < 0 || !file.commit()) {
+        message += " " + tr("Could not save the result to %1.").arg(benchmarksPath());
+    }
+    finish(message);
+
+    m_previous = result;
+    showPrevious();
+}
+
+void BenchmarkDialog::showPrevious()
+{
+    if (m_previous.isEmpty()) {
+        m_lblPrevious->setText(tr("No previous result for this command."));
+        return;
+    }
+    QString text = tr("Compared with %1 (%2 runs)")
+        .arg(QLocale().toString(QDateTime::fromString(m_previous.value("timestamp").toString(), Qt::ISODate), QLocale::ShortFormat))
+        .arg(m_previous.value("runs").toInt());
+    if (m_previous.value("command").toString() != m_commandLine) {
+        text += " " + tr("with a different command line");
+        m_lblPrevious->setToolTip(m_previous.value("command").toString());
+    }
+    m_lblPrevious->setText(text);
+}
+
+QJsonObject BenchmarkDialog::statsToJson(const BenchmarkStats &stats) const
+{
+    QJsonObject object;
+    object["mean"] = stats.mean;
+    object["stddev"] = stats.stddev;
+    object["median"] = stats.median;
+    object["min"] = stats.min;
+    object["max"] = stats.max;
+    object["outliers"] = stats.outliers;
+    return object;
+}
+
+void BenchmarkDialog::setRow(int row, const QString &name, const BenchmarkStats &stats, const QJsonObject &previous)
+{
+    m_resultsTable->setItem(row, 0, new QTableWidgetItem(name));
+    m_resultsTable->setItem(row, 1, new QTableWidgetItem(QString("%1 ± %2").arg(ResourceMonitor::formatMs(stats.mean, 3, 1), ResourceMonitor::formatMs(stats.stddev, 3, 1))));
+    m_resultsTable->setItem(row, 2, new QTableWidgetItem(ResourceMonitor::formatMs(stats.median, 3, 1)));
+    m_resultsTable->setItem(row, 3, new QTableWidgetItem(ResourceMonitor::formatMs(stats.min, 3, 1)));
+    m_resultsTable->setItem(row, 4, new QTableWidgetItem(ResourceMonitor::formatMs(stats.max, 3, 1)));
+    m_resultsTable->setItem(row, 5, new QTableWidgetItem(QString::number(stats.outliers)));
+
+    if (previous.isEmpty()) {
+        return;
+    }
+    double previousMean = previous.value("mean").toDouble();
+    double previousStddev = previous.value("stddev").toDouble();
+    m_resultsTable->setItem(row, 6, new QTableWidgetItem(QString("%1 ± %2").arg(ResourceMonitor::formatMs(previousMean, 3, 1), ResourceMonitor::formatMs(previousStddev, 3, 1))));
+    if (previousMean <= 0.0) {
+        return;
+    }
+
+    double change = (stats.mean - previousMean) / previousMean;
+    QTableWidgetItem *changeItem = new QTableWidgetItem(QString("%1%2%").arg(change >= 0 ? "+" : "").arg(change * 100.0, 0, 'f', 1));
+    bool significant = std::fabs(change) > SIGNIFICANT_CHANGE
+                       && std::fabs(stats.mean - previousMean) > qMax(stats.stddev, previousStddev);
+    if (significant) {
+        changeItem->setForeground(change > 0 ? QColor("red") : QColor("green"));
+        changeItem->setToolTip(change > 0 ? tr("Slower than the previous result") : tr("Faster than the previous result"));
+    }
+    m_resultsTable->setItem(row, 7, changeItem);
+}
+
+QString BenchmarkDialog::benchmarksPath()
+{
+    return QDir::homePath() + "/.Quish/benchmarks.json";
+}
+
+QJsonObject BenchmarkDialog::loadAll()
+{
+    QFile file(benchmarksPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
@@ -0,0 +1,94 @@
+#ifndef BENCHMARKDIALOG_H
+#define BENCHMARKDIALOG_H
+
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QProcess>
+#include <QVector>
+#include <QSpinBox>
+#include <QComboBox>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QLabel>
+#include <QTableWidget>
+#include <QPlainTextEdit>
+
+class QuishProcess;
+
+struct BenchmarkStats {
+    double mean = 0.0;
+    double stddev = 0.0;
+    double median = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    int outliers = 0;
+};
+
+// Runs a command repeatedly, hyperfine-style, and compares with the last saved result
+class BenchmarkDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit BenchmarkDialog(QWidget *parent = nullptr);
+
+    // key identifies the command in ~/.Quish/benchmarks.json (topic/command)
+    void setCommand(const QString &key, const QString &commandLine, const QString &workingDirectory);
+
+    static BenchmarkStats computeStats(QVector<double> samples);
+
+public slots:
+    void reject() override;
+
+private slots:
+    void onStartClicked();
+    void onStopClicked();
+
+private:
+    enum Phase {
+        Idle,
+        Preparing,
+        Measuring
+    };
+
+    void startNext();
+    void startProcess(bool measured);
+    void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void finish(const QString &message);
+    void showResults();
+    void showPrevious();
+    QJsonObject statsToJson(const BenchmarkStats &stats) const;
+    void setRow(int row, const QString &name, const BenchmarkStats &stats, const QJsonObject &previous);
+
+    static QString benchmarksPath();
+    static QJsonObject loadAll();
+
+    QSpinBox *m_runsSpinBox;
+    QSpinBox *m_warmupSpinBox;
+    QLineEdit *m_prepareLineEdit;
+    QComboBox *m_outputComboBox;
+    QPushButton *m_btnStart;
+    QPushButton *m_btnStop;
+    QLabel *m_lblProgress;
+    QLabel *m_lblPrevious;
+    QTableWidget *m_resultsTable;
+    QPlainTextEdit *m_txtOutput;
+
+    QString m_key;
+    QString m_commandLine;
+    QString m_workingDirectory;
+    QJsonObject m_previous;
+
+    QuishProcess *m_process = nullptr;
+    Phase m_phase = Idle;
+    bool m_stopRequested = false;
+    int m_totalRuns = 0;
+    int m_runIndex = 0;
+    QElapsedTimer m_timer;
+    QVector<double> m_wall;
+    QVector<double> m_user;
+    QVector<double> m_system;
+};
+
+#endif // BENCHMARKDIALOG_H
@@ -0,0 +1,503 @@
+#include "Cli.h"
+#include "CommandLine.h"
+#include "ConfigCache.h"
+#include "ConfigFragments.h"
+#include "ConfigJournal.h"
+#include "Launcher.h"
+#include "InstanceServer.h"
+#include "Scheduling.h"
+#include "ProcessPool.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QStringList>
+#include <QVector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace Cli {
+
+namespace {
+
+const int EXIT_USAGE = 2;
+// A hung instance must not keep a new one from starting
+const int RAISE_TIMEOUT_MS = 2000;
+
+void printError(const QString &message)
+{
+    fprintf(stderr, "quish: %s\n", qPrintable(message));
+}
+
+void printUsage(FILE *stream)
+{
+    fprintf(stream,
+            "Usage: quish --run \"<topic>/<command>\" [--set Name=value]... [options]\n"
+            "\n"
+            "Runs a command of the Quish configuration without the GUI. The command\n"
+            "replaces Quish: its output goes to stdout/stderr and its exit code is\n"
+            "returned as is.\n"
+            "\n"
+            "Options:\n"
+            "  --set Name=value  Value of an argument, by its name in the config.\n"
+            "                    Booleans take true/false; repeat it for files.\n"
+            "  --misc ARGS       Extra arguments appended as is (like the Misc field).\n"
+            "  --config FILE     Configuration file (default ~/.Quish/config.json).\n"
+            "                    Fragments in /etc/quish/conf.d and ~/.Quish/conf.d are added.\n"
+            "  --cwd DIR         Working directory (default: the command's own, or the current one).\n"
+            "  --dry-run         Print the command line instead of running it.\n"
+            "  --help            Show this help.\n"
+            "\n"
+            "       quish --remote '<json request>'\n"
+            "\n"
+            "Sends one request to the running Quish and prints the JSON replies, e.g.\n"
+            "  {\"request\": \"run\", \"command\": \"<topic>/<command>\", \"follow\": true}\n"
+            "Requests: ping, list, select, run, status, stream, raise. With \"follow\"\n"
+            "(run) or for stream, it waits for the run and returns its exit code.\n"
+            "\n"
+            "       quish --io-bench\n"
+            "\n"
+            "Reads 1, 16 and 256 noisy children at once, with a QProcess each and\n"
+            "with the I/O engine thread, and prints the throughput and Quish's CPU time.\n");
+}
+
+bool applySetting(const QJsonObject &command, const QString &setting, QStringList *filesSet, CommandLine::Values *values)
+{
+    int equals = setting.indexOf('=');
+    if (equals <= 0) {
+        printError(QString("--set expects Name=value, got \"%1\"").arg(setting));
+        return false;
+    }
+    QString name = setting.left(equals);
+
+    // The first --set of a files argument replaces its defaults, the next ones add to it
+    if (!filesSet->contains(name)) {
+        filesSet->append(name);
+        values->files.remove(name);
+    }
+    QString errorMessage;
+    if (!CommandLine::setValue(command, name, setting.mid(equals + 1), values, &errorMessage)) {
+        printError(errorMessage);
+        return false;
+    }
+    return true;
+}
+
+// The server side is a QLocalServer: a plain Unix socket in the temp folder
+int connectToInstance()
+{
+    QByteArray path = QFile::encodeName(QDir::tempPath() + "/" + InstanceServer::socketName());
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= static_cast<int>(sizeof(address.sun_path))) {
+        return -1;
+    }
+    memcpy(address.sun_path, path.constData(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool writeAll(int fd, const QByteArray &data)
+{
+    qint64 written = 0;
+    while (written < data.size()) {
+        ssize_t count = send(fd, data.constData() + written, data.size() - written, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        written += count;
+    }
+    return true;
+}
+
+// Reads one reply line, keeping whatever follows it in buffer
+// Gives up after timeoutMs when it is not negative
+bool readLine(int fd, QByteArray *buffer, QByteArray *line, int timeoutMs = -1)
+{
+    char chunk[65536];
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        int newline = buffer->indexOf('\n');
+        if (newline >= 0) {
+            *line = buffer->left(newline);
+            buffer->remove(0, newline + 1);
+            return true;
+        }
+        if (timeoutMs >= 0) {
+            struct pollfd input = { fd, POLLIN, 0 };
+            int left = qMax<qint64>(0, timeoutMs - timer.elapsed());
+            int ready = poll(&input, 1, left);
+            if (ready < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ready <= 0) {
+                return false;
+            }
+        }
+        ssize_t count = read(fd, chunk, sizeof(chunk));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        buffer->append(chunk, count);
+    }
+}
+
+int remote(const QString &requestText)
+{
+    QJsonParseError parseError;
+    QJsonDocument request = QJsonDocument::fromJson(requestText.toUtf8(), &parseError);
+    if (!request.isObject()) {
+        printError(QString("invalid request: %1").arg(parseError.errorString()));
+        return EXIT_USAGE;
+    }
+    int fd = connectToInstance();
+    if (fd < 0) {
+        printError("Quish is not running");
+        return EXIT_USAGE;
+    }
+    if (!writeAll(fd, QJsonDocument(request.object()).toJson(QJsonDocument::Compact) + "\n")) {
+        printError(QString("could not send the request: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+        close(fd);
+        return EXIT_USAGE;
+    }
+
+    QString type = request.object()["request"].toString();
+    bool following = type == "stream" || (type == "run" && request.object()["follow"].toBool());
+    QByteArray buffer;
+    QByteArray line;
+    int exitCode = 0;
+    if (!readLine(fd, &buffer, &line)) {
+        printError("no reply from Quish");
+        close(fd);
+        return EXIT_USAGE;
+    }
+    printf("%s\n", line.constData());
+    QJsonObject reply = QJsonDocument::fromJson(line).object();
+    if (!reply["ok"].toBool()) {
+        close(fd);
+        return 1;
+    }
+
+    while (following && readLine(fd, &buffer, &line)) {
+        printf("%s\n", line.constData());
+        fflush(stdout);
+        QJsonObject event = QJsonDocument::fromJson(line).object();
+        if (event["event"].toString() == "finished") {
+            exitCode = event["exitCode"].toInt();
+            break;
+        }
+    }
+    close(fd);
+    return exitCode;
+}
+
+
+// Children that write as fast as they can, all at the same time
+const qint64 IO_BENCH_TOTAL = 256 * 1024 * 1024;
+
+struct IoBenchResult {
+    qint64 bytes = 0;
+    qint64 wallMs = 0;
+    qint64 cpuMs = 0;       // Quish's own user + sys time, all threads
+};
+
+qint64 cpuTimeMs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000
+           + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+}
+
+IoBenchResult ioBench(int children, bool engine)
+{
+    QString commandLine = QString("yes 'quish io bench 0123456789 abcdefghijklmnopqrstuvwxyz' | head -c %1")
+                          .arg(IO_BENCH_TOTAL / children);
+    IoBenchResult result;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    qint64 cpuStart = cpuTimeMs();
+    timer.start();
+
+    // Both keep the output, as the runs do
+    if (engine) {
+        ProcessPool pool;
+        pool.setMaxConcurrent(children);
+        for (int i = 0; i < children; ++i) {
+            pool.addJob(commandLine, QString());
+        }
+        QObject::connect(&pool, &ProcessPool::allFinished, &loop, &QEventLoop::quit);
+        pool.start();
+        loop.exec();
+        for (int i = 0; i < children; ++i) {
+            result.bytes += pool.job(i).output.size();
+        }
+    } else {
+        QVector<QByteArray> outputs(children);
+        int running = children;
+        QList<QProcess*> processes;
+        for (int i = 0; i < children; ++i) {
+            QProcess *process = new QProcess;
+            process->setProcessChannelMode(QProcess::MergedChannels);
+            QObject::connect(process, &QProcess::readyReadStandardOutput, [process, &outputs, i]() {
+                outputs[i].append(process->readAllStandardOutput());
+            });
+            QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+                             [process, &outputs, &running, &loop, i]() {
+                outputs[i].append(process->readAllStandardOutput());
+                if (--running == 0) {
+                    loop.quit();
+                }
+            });
+            processes.append(process);
+        }
+        for (QProcess *process : processes) {
+            process->start("/bin/sh", QStringList() << "-c" << commandLine);
+        }
+        loop.exec();
+        for (const QByteArray &output : outputs) {
+            result.bytes += output.size();
+        }
+        qDeleteAll(processes);
+    }
+
+    result.wallMs = qMax<qint64>(1, timer.elapsed());
+    result.cpuMs = cpuTimeMs() - cpuStart;
+    return result;
+}
+
+int ioBenchmark(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    // A few descriptors per child, with 256 of them at once
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    printf("%d MB in total per round, split between the children\n\n", int(IO_BENCH_TOTAL / (1024 * 1024)));
+    printf("%8s  %-9s  %10s  %9s  %9s  %9s\n", "children", "reader", "MB/s", "wall ms", "CPU ms", "CPU/wall");
+    for (int children : { 1, 16, 256 }) {
+        for (bool engine : { false, true }) {
+            IoBenchResult result = ioBench(children, engine);
+            printf("%8d  %-9s  %10.1f  %9lld  %9lld  %8.0f%%\n", children, engine ? "io engine" : "qprocess",
+                   result.bytes / 1048576.0 / (result.wallMs / 1000.0), static_cast<long long>(result.wallMs),
+                   static_cast<long long>(result.cpuMs), 100.0 * result.cpuMs / result.wallMs);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+bool requested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--run") == 0 || strcmp(argv[i], "--remote") == 0 || strcmp(argv[i], "--io-bench") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool raiseRunningInstance()
+{
+    int fd = connectToInstance();
+    if (fd < 0) {
+        return false;
+    }
+    QByteArray buffer;
+    QByteArray line;
+    bool raised = writeAll(fd, "{\"request\":\"raise\"}\n") && readLine(fd, &buffer, &line, RAISE_TIMEOUT_MS);
+    close(fd);
+    return raised;
+}
+
+int run(int argc, char *argv[])
+{
+    QString target;
+    QString configPath = QDir::homePath() + "/.Quish/config.json";
+    QString workingDirectory;
+    QString misc;
+    QStringList settings;
+    bool dryRun = false;
+
+    for (int i = 1; i < argc; ++i) {
+        QString option = QString::fromLocal8Bit(argv[i]);
+        bool takesValue = option == "--run" || option == "--set" || option == "--config" || option == "--cwd"
+                          || option == "--misc" || option == "--remote";
+        if (takesValue && i + 1 >= argc) {
+            printError(QString("%1 expects a value").arg(option));
+            return EXIT_USAGE;
+        }
+        if (option == "--remote") {
+            return remote(QString::fromLocal8Bit(argv[++i]));
+        } else if (option == "--io-bench") {
+            return ioBenchmark(argc, argv);
+        } else if (option == "--run") {
+            target = QString::fromLocal8Bit(argv[++i]);
+        } else if (option == "--set") {
+            settings.append(QString::fromLocal8Bit(argv[++i]));
+        } else if (option == "--config") {
+            configPath = QString::fromLocal8Bit(argv[++i]);
+        } else if (option == "--cwd") {
+            workingDirectory = QString::fromLocal8Bit(argv[++i]);
+        } else if (option == "--misc") {
+            misc = QString::fromLocal8Bit(argv[++i]);
+        } else if (option == "--dry-run") {
+            dryRun = true;
+        } else if (option == "--help" || option == "-h") {
+            printUsage(stdout);
+            return 0;
+        } else {
+            printError(QString("unknown option %1").arg(option));
+            printUsage(stderr);
+            return EXIT_USAGE;
+        }
+    }
+
+    // Same compiled cache as the window: scripts calling --run in a loop skip the parse
+    QJsonObject root;
+    QString configError;
+    bool fragmentsOnly = !QFile::exists(configPath)
+                         && (!ConfigFragments::files().isEmpty() || ConfigJournal::exists(configPath));
+    if (!fragmentsOnly && !ConfigCache::load(configPath, &root, &configError)) {
+        printError(configError);
+        return EXIT_USAGE;
+    }
+    // Presets saved in the window and not yet folded into the file
+    QStringList warnings;
+    ConfigJournal::replay(configPath, &root, &warnings);
+    ConfigFragments::merge(&root, &warnings);
+    for (const QString &warning : warnings) {
+        printError(QString("skipped %1").arg(warning));
+    }
+    QJsonObject topics = root["topics"].toObject();
+    if (topics.isEmpty()) {
+        printError(QString("no 'topics' object in %1").arg(configPath));
+        return EXIT_USAGE;
+    }
+
+    QJsonObject command;
+    if (!CommandLine::findCommand(topics, target, &command)) {
+        printError(QString("no command \"%1\" in %2 (expected \"<topic>/<command>\")").arg(target, configPath));
+        return EXIT_USAGE;
+    }
+
+    CommandLine::Values values = CommandLine::defaults(command);
+    values.misc = misc;
+    QStringList filesSet;
+    for (const QString &setting : settings) {
+        if (!applySetting(command, setting, &filesSet, &values)) {
+            return EXIT_USAGE;
+        }
+    }
+
+    QString errorMessage;
+    QString commandLine = CommandLine::build(command, values, &errorMessage);
+    if (commandLine.isEmpty()) {
+        printError(errorMessage);
+        return EXIT_USAGE;
+    }
+    if (dryRun) {
+        printf("%s\n", qPrintable(commandLine));
+        return 0;
+    }
+
+    if (workingDirectory.isEmpty()) {
+        workingDirectory = CommandLine::expandHome(command["working_directory"].toString());
+    }
+    if (!workingDirectory.isEmpty() && chdir(QFile::encodeName(workingDirectory).constData()) != 0) {
+        printError(QString("cannot change to %1: %2").arg(workingDirectory, QString::fromLocal8Bit(strerror(errno))));
+        return EXIT_USAGE;
+    }
+
+    // The command's envelope is ours too, since it replaces us
+    if (command.contains("scheduling")) {
+        Scheduling::Prepared prepared;
+        QStringList warnings;
+        if (!Scheduling::prepare(command["scheduling"].toObject(), &prepared, &warnings, &errorMessage)) {
+            printError(errorMessage);
+            return EXIT_USAGE;
+        }
+        for (const QString &warning : warnings) {
+            printError(QString("scheduling: %1").arg(warning));
+        }
+        Scheduling::apply(prepared);
+    }
+
+    // The command reads its stdin file itself, there is nothing in between to copy
+    if (command["stdin"].toObject()["previous_output"].toBool()) {
+        printError("stdin from the previous output is only available in the window");
+        return EXIT_USAGE;
+    }
+    QString stdinName = CommandLine::stdinArgument(command);
+    if (!stdinName.isEmpty()) {
+        QString path = values.strings.value(stdinName);
+        if (path.isEmpty()) {
+            printError(QString("no file given for stdin (argument \"%1\")").arg(stdinName));
+            return EXIT_USAGE;
+        }
+        int fd = open(QFile::encodeName(path).constData(), O_RDONLY);
+        if (fd < 0 || dup2(fd, STDIN_FILENO) < 0) {
+            printError(QString("cannot open %1 for stdin: %2").arg(path, QString::fromLocal8Bit(strerror(errno))));
+            return EXIT_USAGE;
+        }
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+
+    // Exec in place: no extra process, and signals and the exit status are the command's own
+    QStringList arguments = Launcher::argumentsFor(commandLine);
+    QList<QByteArray> encoded;
+    for (const QString &argument : arguments) {
+        encoded.append(argument.toLocal8Bit());
+    }
+    QVector<char *> execArgv;
+    for (QByteArray &argument : encoded) {
+        execArgv.append(argument.data());
+    }
+    execArgv.append(nullptr);
+
+    fflush(stdout);
+    execvp(execArgv[0], execArgv.data());
+    int error = errno;
+    printError(QString("cannot run %1: %2").arg(arguments.first(), QString::fromLocal8Bit(strerror(error))));
+    return error == ENOENT ? 127 : 126;
+}
+
+}
@@ -0,0 +1,21 @@
+#ifndef CLI_H
+#define CLI_H
+
+// Headless mode: quish --run "<topic>/<command>" [--set Name=value]... [--config file]
+// Resolves the command from the config, builds its command line like the form
+// does and execs it in place of Quish, so output and exit code pass straight through.
+// quish --remote '<json request>' talks to the running instance instead, and
+// quish --io-bench measures how the output of many children is read.
+namespace Cli {
+
+bool requested(int argc, char *argv[]);
+
+// Only returns on error (with the exit code to use) or for --dry-run and --help
+int run(int argc, char *argv[]);
+
+// Asks an already running Quish to come to the front; false when there is none
+bool raiseRunningInstance();
+
+}
+
+#endif // CLI_H
@@ -0,0 +1,302 @@
+#include "CommandCatalog.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+
+#include <algorithm>
+
+namespace {
+
+// One shared copy per distinct text: a config with hundreds of presets of the
+// same few tools repeats the same names, flags and executables
+QString intern(const QString &text, QHash<QString, QString> *strings)
+{
+    if (!strings || text.isEmpty()) {
+        return text;
+    }
+    auto it = strings->constFind(text);
+    if (it != strings->constEnd()) {
+        return it.value();
+    }
+    strings->insert(text, text);
+    return text;
+}
+
+bool parseBoolean(const QString &text, bool *value)
+{
+    QString lower = text.trimmed().toLower();
+    if (lower == "true" || lower == "1" || lower == "yes" || lower == "on") {
+        *value = true;
+        return true;
+    }
+    if (lower == "false" || lower == "0" || lower == "no" || lower == "off") {
+        *value = false;
+        return true;
+    }
+    return false;
+}
+
+const QVector<CommandSpec> NO_COMMANDS;
+
+}
+
+ArgSpec::Type ArgSpec::typeFromName(const QString &name)
+{
+    static const QHash<QString, Type> types = {
+        { "boolean", Boolean },
+        { "string", String },
+        { "raw_string", RawString },
+        { "integer", Integer },
+        { "file", File },
+        { "folder", Folder },
+        { "newfile", NewFile },
+        { "newfolder", NewFolder },
+        { "files", Files },
+    };
+    return types.value(name, Unknown);
+}
+
+CommandSpec CommandSpec::compile(const QJsonObject &config, const QString &topic, QHash<QString, QString> *strings)
+{
+    CommandSpec spec;
+    spec.config = config;
+    spec.topic = intern(topic, strings);
+    spec.name = config.value("name").toString();
+    spec.executable = intern(config.value("executable").toString(), strings);
+    spec.sudo = config.value("sudo").toBool(false);
+    spec.cpuCounters = config.value("cpu_counters").toBool(false);
+    spec.cacheable = config.value("cacheable").toBool(false);
+    spec.clearOutput = config.value("clear_output").toBool(false);
+    spec.pty = config.value("pty").toBool(false);
+    spec.hasWorkingDirectory = config.contains("working_directory");
+    spec.workingDirectory = config.value("working_directory").toString();
+    spec.timeout = config.value("timeout").toDouble(0);
+    spec.stopSequence = config.value("stop_sequence").toString();
+    spec.man = config.value("man").toString();
+
+    QJsonObject stdinSource = config.value("stdin").toObject();
+    spec.hasStdin = !stdinSource.isEmpty();
+    spec.stdinArgument = stdinSource.value("argument").toString();
+    spec.stdinFromPreviousOutput = stdinSource.value("previous_output").toBool();
+
+    const QJsonArray arguments = config.value("arguments").toArray();
+    spec.arguments.reserve(arguments.size());
+    spec.m_lengthHint = spec.executable.size() + 5;
+    for (const QJsonValue &value : arguments) {
+        QJsonObject object = value.toObject();
+        ArgSpec arg;
+        arg.name = intern(object.value("name").toString(), strings);
+        arg.typeName = intern(object.value("type").toString(), strings);
+        arg.type = ArgSpec::typeFromName(arg.typeName);
+        arg.flag = intern(object.value("flag").toString(), strings);
+        arg.exclusiveGroup = intern(object.value("exclusive_group").toString(), strings);
+        arg.mandatory = object.value("mandatory").toBool();
+        arg.batch = object.value("batch").toBool(false);
+        arg.batchWorkers = object.value("batch_workers").toInt(0);
+        arg.sweep = object.value("sweep").toString();
+
+        arg.hasDefault = object.contains("default");
+        QJsonValue defaultValue = object.value("default");
+        if (arg.type == ArgSpec::Boolean) {
+            arg.defaultChecked = defaultValue.toBool();
+        } else if (arg.type == ArgSpec::Files) {
+            for (const QJsonValue &file : defaultValue.toArray()) {
+                arg.defaultFiles.append(file.toString());
+            }
+        } else if (arg.type == ArgSpec::Integer) {
+            arg.defaultText = QString::number(defaultValue.toInt());
+        } else {
+            arg.defaultText = defaultValue.toString();
+        }
+
+        // A boolean always adds its flag, even an empty one, as the form always did
+        if (arg.type == ArgSpec::Boolean || !arg.flag.isEmpty()) {
+            arg.flagPiece = intern(" " + arg.flag, strings);
+        }
+        arg.verbatim = arg.type == ArgSpec::RawString || arg.type == ArgSpec::Files;
+        arg.onCommandLine = arg.name != spec.stdinArgument;
+        if (arg.onCommandLine) {
+            spec.m_lengthHint += arg.flagPiece.size() + 1;
+        }
+
+        if (!spec.m_index.contains(arg.name)) {
+            spec.m_index.insert(arg.name, spec.arguments.size());
+        }
+        spec.arguments.append(arg);
+    }
+    return spec;
+}
+
+const ArgSpec *CommandSpec::argument(const QString &argumentName) const
+{
+    int index = indexOf(argumentName);
+    return index < 0 ? nullptr : &arguments.at(index);
+}
+
+CommandLine::Values CommandSpec::defaults() const
+{
+    CommandLine::Values values;
+    values.sudo = sudo;
+    for (const ArgSpec &arg : arguments) {
+        if (!arg.hasDefault) {
+            continue;
+        }
+        if (arg.type == ArgSpec::Boolean) {
+            values.booleans.insert(arg.name, arg.defaultChecked);
+        } else if (arg.type == ArgSpec::Files) {
+            values.files.insert(arg.name, arg.defaultFiles);
+        } else {
+            values.strings.insert(arg.name, arg.defaultText);
+        }
+    }
+    return values;
+}
+
+QString CommandSpec::build(const CommandLine::Values &values, QString *errorMessage) const
+{
+    if (executable.isEmpty()) {
+        if (errorMessage) {
+            *errorMessage = QCoreApplication::translate("CommandLine", "No executable specified in configuration");
+        }
+        return QString();
+    }
+
+    QString commandLine;
+    commandLine.reserve(m_lengthHint + values.misc.size());
+    if (values.sudo) {
+        commandLine += QLatin1String("sudo ");
+    }
+    commandLine += executable;
+
+    for (const ArgSpec &arg : arguments) {
+        if (!arg.onCommandLine) {
+            continue;
+        }
+        if (arg.type == ArgSpec::Boolean) {
+            if (values.booleans.value(arg.name)) {
+                commandLine += arg.flagPiece;
+            }
+            continue;
+        }
+
+        QString paramValue = arg.type == ArgSpec::Files ? CommandLine::shellQuote(values.files.value(arg.name)).join(' ')
+                                                        : values.strings.value(arg.name);
+        if (paramValue.isEmpty()) {
+            continue;
+        }
+        commandLine += arg.flagPiece;
+        commandLine += QLatin1Char(' ');
+        if (!arg.verbatim && paramValue.contains(' ')) {
+            commandLine += QLatin1Char('"') + paramValue + QLatin1Char('"');
+        } else {
+            commandLine += paramValue;
+        }
+    }
+
+    if (!values.misc.isEmpty()) {
+        commandLine += QLatin1Char(' ') + values.misc;
+    }
+    return commandLine;
+}
+
+bool CommandSpec::setValue(const QString &argumentName, const QString &text, CommandLine::Values *values,
+                           QString *errorMessage) const
+{
+    const ArgSpec *arg = argument(argumentName);
+    if (!arg) {
+        if (errorMessage) {
+            QStringList names;
+            for (const ArgSpec &other : arguments) {
+                names.append(other.name);
+            }
+            *errorMessage = QCoreApplication::translate("CommandLine", "unknown argument \"%1\"; this command takes: %2")
+                                .arg(argumentName, names.join(", "));
+        }
+        return false;
+    }
+
+    if (arg->type == ArgSpec::Boolean) {
+        bool checked;
+        if (!parseBoolean(text, &checked)) {
+            if (errorMessage) {
+                *errorMessage = QCoreApplication::translate("CommandLine", "\"%1\" is a boolean, expected true or false").arg(argumentName);
+            }
+            return false;
+        }
+        // Like the radio buttons: selecting one clears the rest of its group
+        if (checked && !arg->exclusiveGroup.isEmpty()) {
+            for (const ArgSpec &other : arguments) {
+                if (other.exclusiveGroup == arg->exclusiveGroup) {
+                    values->booleans.insert(other.name, false);
+                }
+            }
+        }
+        values->booleans.insert(argumentName, checked);
+    } else if (arg->type == ArgSpec::Files) {
+        if (!text.isEmpty()) {
+            values->files[argumentName].append(text);
+        }
+    } else {
+        values->strings.insert(argumentName, text);
+    }
+    return true;
+}
+
+void CommandCatalog::clear()
+{
+    m_topics.clear();
+    m_commands.clear();
+    m_commandCount = 0;
+}
+
+void CommandCatalog::compile(const QJsonObject &topics)
+{
+    clear();
+    QHash<QString, QString> strings;
+    const QStringList names = topics.keys();
+    m_topics = names;
+    for (const QString &topic : names) {
+        const QJsonArray array = topics.value(topic).toArray();
+        QVector<CommandSpec> &commands = m_commands[topic];
+        commands.reserve(array.size());
+        for (const QJsonValue &value : array) {
+            commands.append(CommandSpec::compile(value.toObject(), topic, &strings));
+        }
+        m_commandCount += commands.size();
+    }
+}
+
+int CommandCatalog::append(const CommandSpec &command)
+{
+    if (!m_commands.contains(command.topic)) {
+        // Where compile() puts it, as the object keys are sorted
+        m_topics.insert(std::lower_bound(m_topics.begin(), m_topics.end(), command.topic), command.topic);
+    }
+    QVector<CommandSpec> &commands = m_commands[command.topic];
+    commands.append(command);
+    ++m_commandCount;
+    return commands.size() - 1;
+}
+
+const QVector<CommandSpec> &CommandCatalog::commands(const QString &topic) const
+{
+    auto it = m_commands.constFind(topic);
+    return it == m_commands.constEnd() ? NO_COMMANDS : it.value();
+}
+
+const CommandSpec *CommandCatalog::find(const QString &target) const
+{
+    for (int slash = target.indexOf('/'); slash >= 0; slash = target.indexOf('/', slash + 1)) {
+        auto it = m_commands.constFind(target.left(slash));
+        if (it == m_commands.constEnd()) {
+            continue;
+        }
+        QString name = target.mid(slash + 1);
+        for (const CommandSpec &command : it.value()) {
+            if (command.name == name) {
+                return &command;
+            }
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,105 @@
+#ifndef COMMANDCATALOG_H
+#define COMMANDCATALOG_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "CommandLine.h"
+
+// One argument of a command, with its type resolved once
+struct ArgSpec {
+    enum Type { Boolean, String, RawString, Integer, File, Folder, NewFile, NewFolder, Files, Unknown };
+
+    QString name;
+    Type type = Unknown;
+    QString typeName;               // as written, for the widgets' argType property
+    QString flag;
+    QString exclusiveGroup;
+    bool mandatory = false;
+    bool hasDefault = false;
+    bool defaultChecked = false;
+    QString defaultText;            // integers already formatted
+    QStringList defaultFiles;
+    bool batch = false;
+    int batchWorkers = 0;
+    QString sweep;
+
+    // Command-line template: " <flag>" or empty, and whether the value is
+    // pasted as is (raw strings, quoted file lists) or quoted when it has spaces
+    QString flagPiece;
+    bool verbatim = false;
+    bool onCommandLine = true;      // false for the stdin argument
+
+    bool isPath() const { return type == File || type == Folder || type == NewFile || type == NewFolder; }
+    // The form keeps these in a line edit, and Values::strings holds them
+    bool isText() const { return type != Boolean && type != Files; }
+    static Type typeFromName(const QString &name);
+};
+
+// A command of the config compiled once: typed arguments, the switches the
+// run path checks, and its command line as a template. The form, the preview
+// and the run read this instead of walking the JSON on every keystroke.
+struct CommandSpec {
+    QString topic;
+    QString name;
+    QString executable;
+    QVector<ArgSpec> arguments;
+    bool hasStdin = false;          // a "stdin" object was given
+    QString stdinArgument;          // its file goes to stdin, not onto the command line
+    bool stdinFromPreviousOutput = false;
+    bool sudo = false;
+    bool cpuCounters = false;
+    bool cacheable = false;
+    bool clearOutput = false;
+    bool pty = false;
+    bool hasWorkingDirectory = false;
+    QString workingDirectory;
+    double timeout = 0;
+    QString stopSequence;
+    QString man;
+    QJsonObject config;             // as written, for presets and the less common keys
+
+    static CommandSpec compile(const QJsonObject &config, const QString &topic = QString(),
+                               QHash<QString, QString> *strings = nullptr);
+
+    bool isNull() const { return config.isEmpty(); }
+    QString target() const { return topic + "/" + name; }
+    int indexOf(const QString &argumentName) const { return m_index.value(argumentName, -1); }
+    const ArgSpec *argument(const QString &argumentName) const;
+
+    CommandLine::Values defaults() const;
+    // Empty, with errorMessage set, when the command has no executable
+    QString build(const CommandLine::Values &values, QString *errorMessage = nullptr) const;
+    bool setValue(const QString &argumentName, const QString &text, CommandLine::Values *values,
+                  QString *errorMessage = nullptr) const;
+
+private:
+    QHash<QString, int> m_index;
+    int m_lengthHint = 0;
+};
+
+// Every command of the "topics" object, compiled at load. Names, flags and
+// types repeated across presets share one string.
+class CommandCatalog
+{
+public:
+    void clear();
+    void compile(const QJsonObject &topics);
+    // Adds command at the end of its topic and returns its index there
+    int append(const CommandSpec &command);
+
+    const QStringList &topics() const { return m_topics; }
+    const QVector<CommandSpec> &commands(const QString &topic) const;
+    // "<topic>/<name>"; topic names may contain '/'
+    const CommandSpec *find(const QString &target) const;
+    int commandCount() const { return m_commandCount; }
+
+private:
+    QStringList m_topics;
+    QHash<QString, QVector<CommandSpec>> m_commands;
+    int m_commandCount = 0;
+};
+
+#endif // COMMANDCATALOG_H
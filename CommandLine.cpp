@@ -0,0 +1,99 @@
+#include "CommandLine.h"
+#include "CommandCatalog.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QJsonArray>
+#include <QRegularExpression>
+
+namespace CommandLine {
+
+// The spec owns the rules; these keep the one-shot callers on plain JSON
+Values defaults(const QJsonObject &config)
+{
+    return CommandSpec::compile(config).defaults();
+}
+
+QString build(const QJsonObject &config, const Values &values, QString *errorMessage)
+{
+    return CommandSpec::compile(config).build(values, errorMessage);
+}
+
+QString stdinArgument(const QJsonObject &config)
+{
+    return config["stdin"].toObject()["argument"].toString();
+}
+
+bool findCommand(const QJsonObject &topics, const QString &target, QJsonObject *command)
+{
+    for (int slash = target.indexOf('/'); slash >= 0; slash = target.indexOf('/', slash + 1)) {
+        QString topic = target.left(slash);
+        QString name = target.mid(slash + 1);
+        if (!topics.contains(topic)) {
+            continue;
+        }
+        for (const QJsonValue &value : topics[topic].toArray()) {
+            if (value.toObject()["name"].toString() == name) {
+                *command = value.toObject();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool setValue(const QJsonObject &config, const QString &name, const QString &text, Values *values,
+              QString *errorMessage)
+{
+    return CommandSpec::compile(config).setValue(name, text, values, errorMessage);
+}
+
+bool setValues(const QJsonObject &config, const QJsonObject &settings, Values *values, QString *errorMessage)
+{
+    CommandSpec spec = CommandSpec::compile(config);
+    for (auto it = settings.begin(); it != settings.end(); ++it) {
+        QJsonArray texts;
+        if (it.value().isArray()) {
+            values->files.remove(it.key());
+            texts = it.value().toArray();
+        } else {
+            texts.append(it.value());
+        }
+        for (const QJsonValue &text : texts) {
+            if (!spec.setValue(it.key(), text.toVariant().toString(), values, errorMessage)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+QString shellQuote(const QString &value)
+{
+    static const QRegularExpression safeRe("^[A-Za-z0-9_@%+=:,./-]+$");
+    if (!value.isEmpty() && safeRe.match(value).hasMatch()) {
+        return value;
+    }
+    QString quoted = value;
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+}
+
+QStringList shellQuote(const QStringList &values)
+{
+    QStringList quoted;
+    for (const QString &value : values) {
+        quoted.append(shellQuote(value));
+    }
+    return quoted;
+}
+
+QString expandHome(const QString &path)
+{
+    if (path == "~" || path.startsWith("~/")) {
+        return QDir::homePath() + path.mid(1);
+    }
+    return path;
+}
+
+}
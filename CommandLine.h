@@ -0,0 +1,52 @@
+#ifndef COMMANDLINE_H
+#define COMMANDLINE_H
+
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+// Turns a command of the config and the values of its arguments into the
+// shell command line. Shared by the form and the headless --run mode.
+namespace CommandLine {
+
+struct Values {
+    bool sudo = false;
+    QMap<QString, bool> booleans;       // by argument name
+    QMap<QString, QString> strings;     // string, raw_string, integer, file and folder arguments
+    QMap<QString, QStringList> files;   // files arguments
+    QString misc;
+};
+
+// Values as the form shows them before any edit
+Values defaults(const QJsonObject &config);
+
+// Empty, with errorMessage set, when the command has no executable
+QString build(const QJsonObject &config, const Values &values, QString *errorMessage = nullptr);
+
+// Argument whose file goes to the command's stdin instead of onto its
+// command line ("stdin": {"argument": name}); empty when there is none
+QString stdinArgument(const QJsonObject &config);
+
+// Command "<topic>/<name>" of the topics object; topic names may contain '/'
+bool findCommand(const QJsonObject &topics, const QString &target, QJsonObject *command);
+
+// Sets one argument by its name as the form would: booleans take true/false
+// and clear the rest of their exclusive group, files arguments accumulate
+bool setValue(const QJsonObject &config, const QString &name, const QString &text, Values *values,
+              QString *errorMessage = nullptr);
+
+// setValue() for every entry of a "set" object, as workflows and pipelines
+// give them; an array sets a files argument to exactly its entries
+bool setValues(const QJsonObject &config, const QJsonObject &settings, Values *values,
+               QString *errorMessage = nullptr);
+
+QString shellQuote(const QString &value);
+QStringList shellQuote(const QStringList &values);
+
+// "~" and "~/..." of working directories the config gives
+QString expandHome(const QString &path);
+
+}
+
+#endif // COMMANDLINE_H
@@ -0,0 +1,106 @@
+#include "CommandPalette.h"
+#include "FuzzyIndex.h"
+#include "RunHistory.h"
+
+#include <QCoreApplication>
+#include <QVBoxLayout>
+#include <QKeyEvent>
+#include <QSignalBlocker>
+
+static const int MAX_RESULTS = 50;
+
+CommandPalette::CommandPalette(FuzzyIndex *index, RunHistory *history, QWidget *parent)
+    : QDialog(parent)
+    , m_index(index)
+    , m_history(history)
+{
+    setWindowTitle(tr("Go to Command"));
+    setMinimumSize(600, 400);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    m_queryLineEdit = new QLineEdit(this);
+    m_queryLineEdit->setPlaceholderText(tr("Topic, command, executable or argument"));
+    m_queryLineEdit->setClearButtonEnabled(true);
+    m_queryLineEdit->installEventFilter(this);
+    mainLayout->addWidget(m_queryLineEdit);
+
+    m_resultsList = new QListWidget(this);
+    m_resultsList->setUniformItemSizes(true);
+    mainLayout->addWidget(m_resultsList, 1);
+
+    m_lblCount = new QLabel(this);
+    mainLayout->addWidget(m_lblCount);
+
+    connect(m_queryLineEdit, &QLineEdit::textChanged, this, &CommandPalette::search);
+    connect(m_queryLineEdit, &QLineEdit::returnPressed, this, &CommandPalette::selectCurrent);
+    connect(m_resultsList, &QListWidget::itemActivated, this, &CommandPalette::selectCurrent);
+}
+
+void CommandPalette::refresh()
+{
+    // Read again each time: the runs since the last opening count too
+    if (m_history) {
+        m_index->setStats(m_history->commandStats());
+    }
+    m_hasLastMatches = false;
+    search();
+}
+
+void CommandPalette::showEvent(QShowEvent *event)
+{
+    {
+        QSignalBlocker blocker(m_queryLineEdit);
+        m_queryLineEdit->clear();
+    }
+    refresh();
+    m_queryLineEdit->setFocus();
+    QDialog::showEvent(event);
+}
+
+// Arrows and paging move in the list while typing goes on in the line edit
+bool CommandPalette::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_queryLineEdit && event->type() == QEvent::KeyPress) {
+        int key = static_cast<QKeyEvent*>(event)->key();
+        if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp || key == Qt::Key_PageDown) {
+            QCoreApplication::sendEvent(m_resultsList, event);
+            return true;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void CommandPalette::search()
+{
+    // Typing on only narrows the previous matches down
+    QString query = m_queryLineEdit->text();
+    bool narrow = m_hasLastMatches && query.startsWith(m_lastQuery);
+    QVector<int> matched;
+    const QVector<FuzzyIndex::Match> matches = m_index->search(query, MAX_RESULTS, &matched,
+                                                               narrow ? &m_lastMatches : nullptr);
+    m_lastQuery = query;
+    m_lastMatches = matched;
+    m_hasLastMatches = true;
+
+    m_resultsList->clear();
+    for (const FuzzyIndex::Match &match : matches) {
+        QString target = m_index->target(match.entry);
+        QListWidgetItem *item = new QListWidgetItem(tr("%1  —  %2").arg(target, m_index->executable(match.entry)), m_resultsList);
+        item->setData(Qt::UserRole, target);
+    }
+    if (m_resultsList->count() > 0) {
+        m_resultsList->setCurrentRow(0);
+    }
+    m_lblCount->setText(tr("%1 of %2 commands").arg(matched.size()).arg(m_index->size()));
+}
+
+void CommandPalette::selectCurrent()
+{
+    QListWidgetItem *item = m_resultsList->currentItem();
+    if (!item) {
+        return;
+    }
+    QString target = item->data(Qt::UserRole).toString();
+    accept();
+    emit commandSelected(target);
+}
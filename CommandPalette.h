@@ -0,0 +1,48 @@
+#ifndef COMMANDPALETTE_H
+#define COMMANDPALETTE_H
+
+#include <QDialog>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QLabel>
+#include <QVector>
+
+class FuzzyIndex;
+class RunHistory;
+
+// Ctrl+P: type a few letters of a topic, command, executable or argument
+// and pick the command from every topic at once
+class CommandPalette : public QDialog
+{
+    Q_OBJECT
+
+public:
+    CommandPalette(FuzzyIndex *index, RunHistory *history, QWidget *parent = nullptr);
+
+public slots:
+    // The index was rebuilt, or the palette is opened again
+    void refresh();
+
+signals:
+    void commandSelected(const QString &target);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void search();
+    void selectCurrent();
+
+private:
+    FuzzyIndex *m_index;
+    RunHistory *m_history;
+    QLineEdit *m_queryLineEdit;
+    QListWidget *m_resultsList;
+    QLabel *m_lblCount;
+    QString m_lastQuery;
+    QVector<int> m_lastMatches;     // every entry matching m_lastQuery
+    bool m_hasLastMatches = false;
+};
+
+#endif // COMMANDPALETTE_H
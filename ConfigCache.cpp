@@ -0,0 +1,200 @@
+#include "ConfigCache.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+#include <QCborMap>
+#include <QCborValue>
+#endif
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ConfigCache {
+
+namespace {
+
+const char CACHE_MAGIC[4] = { 'Q', 'C', 'F', 'G' };
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+const quint32 PAYLOAD_FORMAT = 1;   // QJsonDocument binary data, no parsing on load
+#else
+const quint32 PAYLOAD_FORMAT = 2;   // CBOR, which Qt 6 JSON objects are built on
+#endif
+
+struct Header {
+    char magic[4];
+    quint32 format;
+    qint64 sourceSize;
+    qint64 sourceMtimeNs;
+    qint64 payloadSize;
+    unsigned char sourceHash[32];
+};
+
+QByteArray sourceHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+QByteArray encode(const QJsonObject &root)
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QT_WARNING_PUSH
+    QT_WARNING_DISABLE_DEPRECATED
+    return QJsonDocument(root).toBinaryData();
+    QT_WARNING_POP
+#else
+    return QCborValue::fromJsonValue(root).toCbor();
+#endif
+}
+
+bool decode(const char *data, qint64 size, QJsonObject *root)
+{
+    // fromRawData: the bytes are only read while the cache is mapped
+    QByteArray payload = QByteArray::fromRawData(data, size);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    QT_WARNING_PUSH
+    QT_WARNING_DISABLE_DEPRECATED
+    QJsonDocument doc = QJsonDocument::fromBinaryData(payload);
+    QT_WARNING_POP
+    if (!doc.isObject()) {
+        return false;
+    }
+    *root = doc.object();
+#else
+    QCborValue value = QCborValue::fromCbor(payload);
+    if (!value.isMap()) {
+        return false;
+    }
+    *root = value.toMap().toJsonObject();
+#endif
+    return true;
+}
+
+// The header is checked against the source by the caller; the payload is
+// decoded straight from the mapping
+bool readCache(const QString &path, Header *header, const struct stat &source, const QByteArray &hash, QJsonObject *root)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+        ::close(fd);
+        return false;
+    }
+    void *map = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    memcpy(header, map, sizeof(Header));
+    qint64 mtimeNs = qint64(source.st_mtim.tv_sec) * 1000000000 + source.st_mtim.tv_nsec;
+    bool valid = memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+                 && header->format == PAYLOAD_FORMAT
+                 && qint64(sizeof(Header)) + header->payloadSize == info.st_size;
+    // Size and mtime are enough when both match; a touched but identical file
+    // is recognised by its hash
+    bool current = valid && header->sourceSize == source.st_size
+                   && (hash.isEmpty() ? header->sourceMtimeNs == mtimeNs
+                                      : memcmp(header->sourceHash, hash.constData(), sizeof(header->sourceHash)) == 0);
+    bool decoded = current && decode(static_cast<const char *>(map) + sizeof(Header), header->payloadSize, root);
+    munmap(map, info.st_size);
+    return decoded;
+}
+
+void writeCache(const QString &path, const struct stat &source, const QByteArray &hash, const QByteArray &payload)
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.format = PAYLOAD_FORMAT;
+    header.sourceSize = source.st_size;
+    header.sourceMtimeNs = qint64(source.st_mtim.tv_sec) * 1000000000 + source.st_mtim.tv_nsec;
+    header.payloadSize = payload.size();
+    memcpy(header.sourceHash, hash.constData(), qMin<int>(hash.size(), sizeof(header.sourceHash)));
+
+    // Atomic: a reader maps either the old cache or the new one; a folder we
+    // cannot write to just means no cache
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(payload);
+    file.commit();
+}
+
+} // namespace
+
+QString translate(const char *text)
+{
+    return QCoreApplication::translate("Config", text);
+}
+
+// Files in folders we cannot write to, such as /etc/quish/conf.d, get theirs
+// in ~/.Quish/config-cache, named after the hash of their path
+QString cachePath(const QString &sourcePath)
+{
+    QFileInfo info(sourcePath);
+    if (access(QFile::encodeName(info.absolutePath()).constData(), W_OK) == 0) {
+        return info.absolutePath() + "/." + info.fileName() + ".qcache";
+    }
+    QByteArray key = QCryptographicHash::hash(info.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir::homePath() + "/.Quish/config-cache/" + QString::fromLatin1(key) + ".qcache";
+}
+
+bool load(const QString &sourcePath, QJsonObject *root, QString *errorMessage, const QByteArray &sourceData)
+{
+    struct stat source;
+    if (stat(QFile::encodeName(sourcePath).constData(), &source) != 0) {
+        *errorMessage = translate("Could not open file: %1").arg(sourcePath);
+        return false;
+    }
+    QString path = cachePath(sourcePath);
+    Header header;
+    if (readCache(path, &header, source, QByteArray(), root)) {
+        return true;
+    }
+
+    QByteArray data = sourceData;
+    if (data.isNull()) {
+        QFile file(sourcePath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *errorMessage = translate("Could not open file: %1").arg(sourcePath);
+            return false;
+        }
+        data = file.readAll();
+    }
+    QByteArray hash = sourceHash(data);
+    if (readCache(path, &header, source, hash, root)) {
+        // Same content under a new mtime: only the key needs refreshing
+        writeCache(path, source, hash, encode(*root));
+        return true;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &parseError);
+    if (doc.isNull() || !doc.isObject()) {
+        *errorMessage = translate("Invalid JSON file: %1").arg(sourcePath);
+        if (parseError.error != QJsonParseError::NoError) {
+            *errorMessage += QString(" (%1 at offset %2)").arg(parseError.errorString()).arg(parseError.offset);
+        }
+        return false;
+    }
+    *root = doc.object();
+    writeCache(path, source, hash, encode(*root));
+    return true;
+}
+
+}
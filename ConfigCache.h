@@ -0,0 +1,27 @@
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+// Compiled form of a JSON config, kept next to it as .<name>.qcache (in
+// ~/.Quish/config-cache when its folder is not writable) and keyed by the
+// source's size, mtime and SHA-256. A hit is mapped and handed over without
+// parsing (Qt 5 binary JSON, CBOR on Qt 6); the JSON text is only parsed
+// when the source really changed.
+namespace ConfigCache {
+
+// sourceData is the content of the file when the caller already has it; it
+// is read from the file otherwise, and only if the cache cannot be used
+bool load(const QString &sourcePath, QJsonObject *root, QString *errorMessage,
+          const QByteArray &sourceData = QByteArray());
+
+QString cachePath(const QString &sourcePath);
+
+// Messages of the config modules, in one translation context
+QString translate(const char *text);
+
+}
+
+#endif // CONFIGCACHE_H
@@ -0,0 +1,194 @@
+#include "ConfigFragments.h"
+#include "ConfigCache.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+
+namespace ConfigFragments {
+
+namespace {
+
+struct Fragment {
+    QString path;
+    QJsonObject root;
+    QString errorMessage;
+    bool ok = false;
+};
+
+class FragmentLoader : public QRunnable
+{
+public:
+    explicit FragmentLoader(Fragment *fragment) : m_fragment(fragment) {}
+
+    void run() override
+    {
+        m_fragment->ok = ConfigCache::load(m_fragment->path, &m_fragment->root, &m_fragment->errorMessage);
+    }
+
+private:
+    Fragment *m_fragment;
+};
+
+void mergeTopics(QJsonObject *topics, const QJsonObject &fragmentTopics)
+{
+    for (auto it = fragmentTopics.begin(); it != fragmentTopics.end(); ++it) {
+        QJsonArray commands = topics->value(it.key()).toArray();
+        for (const QJsonValue &value : it.value().toArray()) {
+            QString name = value.toObject().value("name").toString();
+            int existing = -1;
+            for (int i = 0; i < commands.size(); ++i) {
+                if (commands.at(i).toObject().value("name").toString() == name) {
+                    existing = i;
+                    break;
+                }
+            }
+            if (existing >= 0) {
+                commands.replace(existing, value);
+            } else {
+                commands.append(value);
+            }
+        }
+        topics->insert(it.key(), commands);
+    }
+}
+
+void mergeObject(QJsonObject *root, const QJsonObject &fragment, const QString &key)
+{
+    if (!fragment.contains(key)) {
+        return;
+    }
+    QJsonObject merged = root->value(key).toObject();
+    const QJsonObject entries = fragment.value(key).toObject();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        merged.insert(it.key(), it.value());
+    }
+    root->insert(key, merged);
+}
+
+// The config's own commands win over the fragments' ones of the same name
+void addMissingCommands(QJsonObject *topics, const QJsonObject &fragmentTopics)
+{
+    for (auto it = fragmentTopics.begin(); it != fragmentTopics.end(); ++it) {
+        QJsonArray commands = topics->value(it.key()).toArray();
+        QSet<QString> names;
+        for (const QJsonValue &value : commands) {
+            names.insert(value.toObject().value("name").toString());
+        }
+        for (const QJsonValue &value : it.value().toArray()) {
+            if (!names.contains(value.toObject().value("name").toString())) {
+                commands.append(value);
+            }
+        }
+        topics->insert(it.key(), commands);
+    }
+}
+
+void addMissingEntries(QJsonObject *root, const QJsonObject &fragments, const QString &key)
+{
+    if (!fragments.contains(key)) {
+        return;
+    }
+    QJsonObject merged = root->value(key).toObject();
+    const QJsonObject entries = fragments.value(key).toObject();
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        if (!merged.contains(it.key())) {
+            merged.insert(it.key(), it.value());
+        }
+    }
+    root->insert(key, merged);
+}
+
+} // namespace
+
+QStringList directories()
+{
+    return QStringList() << "/etc/quish/conf.d" << QDir::homePath() + "/.Quish/conf.d";
+}
+
+QStringList files()
+{
+    QStringList paths;
+    for (const QString &directory : directories()) {
+        QDir dir(directory);
+        for (const QString &name : dir.entryList(QStringList("*.json"), QDir::Files | QDir::Readable, QDir::Name)) {
+            paths.append(dir.filePath(name));
+        }
+    }
+    return paths;
+}
+
+QJsonObject load(QStringList *warnings)
+{
+    QJsonObject fragmentRoot;
+    const QStringList paths = files();
+    if (paths.isEmpty()) {
+        return fragmentRoot;
+    }
+
+    // Parsed side by side; merged afterwards in order, so the result does not
+    // depend on which file finished first
+    QVector<Fragment> fragments(paths.size());
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMin(paths.size(), qMax(1, QThread::idealThreadCount())));
+    for (int i = 0; i < paths.size(); ++i) {
+        fragments[i].path = paths.at(i);
+        pool.start(new FragmentLoader(&fragments[i]));
+    }
+    pool.waitForDone();
+
+    QJsonObject fragmentTopics;
+    for (const Fragment &fragment : fragments) {
+        if (!fragment.ok) {
+            warnings->append(fragment.errorMessage);
+            continue;
+        }
+        if (!fragment.root.value("topics").isObject()) {
+            warnings->append(ConfigCache::translate("No 'topics' object in %1").arg(fragment.path));
+            continue;
+        }
+        mergeTopics(&fragmentTopics, fragment.root.value("topics").toObject());
+        mergeObject(&fragmentRoot, fragment.root, "workflows");
+        mergeObject(&fragmentRoot, fragment.root, "pipelines");
+    }
+    fragmentRoot.insert("topics", fragmentTopics);
+    return fragmentRoot;
+}
+
+void apply(QJsonObject *root, const QJsonObject &fragments)
+{
+    if (fragments.isEmpty()) {
+        return;
+    }
+    // Applied under the config rather than over it: a preset saved with the
+    // name of a fragment's command must not be replaced by it on the next load
+    QJsonObject topics = root->value("topics").toObject();
+    addMissingCommands(&topics, fragments.value("topics").toObject());
+    root->insert("topics", topics);
+    addMissingEntries(root, fragments, "workflows");
+    addMissingEntries(root, fragments, "pipelines");
+}
+
+void merge(QJsonObject *root, QStringList *warnings)
+{
+    apply(root, load(warnings));
+}
+
+QByteArray stamp(const QStringList &paths)
+{
+    QByteArray stamp;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        stamp += QFile::encodeName(path) + '\t' + QByteArray::number(info.exists() ? info.size() : -1) + '\t'
+                 + QByteArray::number(info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1) + '\n';
+    }
+    return stamp;
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef CONFIGFRAGMENTS_H
+#define CONFIGFRAGMENTS_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QStringList>
+
+// Topic fragments in conf.d folders: each *.json there has the shape of the
+// main config and adds its topics, workflows and pipelines to it. System-wide
+// fragments come first, then the user's, each folder in file name order; a
+// command with the topic and name of an earlier one replaces it. The main
+// config, journal included, has the last word: what it defines itself is
+// never replaced by a fragment.
+namespace ConfigFragments {
+
+// /etc/quish/conf.d, then ~/.Quish/conf.d
+QStringList directories();
+
+// The fragments of directories(), in merge order
+QStringList files();
+
+// Loads every fragment in parallel, each through its own compiled cache, and
+// merges them into one object of topics, workflows and pipelines. A fragment
+// that cannot be used is skipped with a warning.
+QJsonObject load(QStringList *warnings);
+
+// Adds what root does not define itself from the result of load()
+void apply(QJsonObject *root, const QJsonObject &fragments);
+
+// load() and apply()
+void merge(QJsonObject *root, QStringList *warnings);
+
+// Size and mtime of each path, to tell whether any of them changed
+QByteArray stamp(const QStringList &paths);
+
+}
+
+#endif // CONFIGFRAGMENTS_H
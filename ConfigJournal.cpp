@@ -0,0 +1,346 @@
+#include "ConfigJournal.h"
+#include "ConfigCache.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QThread>
+#include <QTimer>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Saves in a burst are folded into the file at once
+static const int COMPACT_DELAY_MS = 2000;
+
+namespace {
+
+// The journal being folded into the file; new records go to a fresh one meanwhile
+QString compactingPath(const QString &configPath)
+{
+    return ConfigJournal::journalPath(configPath) + ".compacting";
+}
+
+// Written before a compaction replaces the config and removed after it: the
+// id of the last record folded in and the SHA-256 of the file it wrote
+QString appliedPath(const QString &configPath)
+{
+    return ConfigJournal::journalPath(configPath) + ".applied";
+}
+
+// The last record the config file already holds; 0 unless the file is still
+// the one a compaction wrote, so a user's edit or a replace that never
+// happened gets every record again
+qint64 appliedRecordId(const QString &configPath)
+{
+    QFile marker(appliedPath(configPath));
+    if (!marker.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    QList<QByteArray> fields = marker.readAll().trimmed().split(' ');
+    QFile config(configPath);
+    if (fields.size() != 2 || !config.open(QIODevice::ReadOnly)
+        || QCryptographicHash::hash(config.readAll(), QCryptographicHash::Sha256).toHex() != fields.at(1)) {
+        return 0;
+    }
+    return fields.at(0).toLongLong();
+}
+
+// A new file is only found after a crash once its folder entry is on disk too
+void syncDirectory(const QString &path)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+// Where the last complete line of the journal ends. A crash while a record
+// was written leaves it without its newline, and the next one must not be
+// glued to it.
+qint64 completeLinesSize(QFile *file)
+{
+    qint64 end = file->size();
+    if (end == 0 || (file->seek(end - 1) && file->read(1) == "\n")) {
+        return end;
+    }
+    while (end > 0) {
+        qint64 chunk = qMin<qint64>(end, 4096);
+        if (!file->seek(end - chunk)) {
+            break;
+        }
+        int newline = file->read(chunk).lastIndexOf('\n');
+        if (newline >= 0) {
+            return end - chunk + newline + 1;
+        }
+        end -= chunk;
+    }
+    return 0;
+}
+
+// Records up to applied, the id the file already holds, are skipped
+void replayFile(const QString &path, QJsonObject *root, QStringList *warnings, qint64 applied,
+                qint64 *lastRecordId)
+{
+    *lastRecordId = qMax(*lastRecordId, applied);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const QByteArray data = file.readAll();
+    int damaged = 0;
+    for (int start = 0; start < data.size();) {
+        int end = data.indexOf('\n', start);
+        if (end < 0) {
+            // Torn by a crash while it was written: its save never returned
+            break;
+        }
+        QJsonObject record = QJsonDocument::fromJson(data.mid(start, end - start)).object();
+        start = end + 1;
+        qint64 id = qint64(record.value("id").toDouble());
+        *lastRecordId = qMax(*lastRecordId, id);
+        if (id > 0 && id <= applied) {
+            continue;
+        }
+        QString type = record.value("type").toString();
+        if (type == "preset") {
+            ConfigJournal::applyPreset(root, record.value("topic").toString(), record.value("command").toObject());
+        } else if (type == "import") {
+            ConfigJournal::applyImport(root, record.value("config").toObject());
+        } else {
+            ++damaged;
+        }
+    }
+    if (damaged > 0) {
+        warnings->append(ConfigCache::translate("%1 damaged record(s) in %2").arg(damaged).arg(path));
+    }
+}
+
+} // namespace
+
+ConfigJournal::ConfigJournal(QObject *parent)
+    : QObject(parent)
+    , m_compactTimer(new QTimer(this))
+{
+    m_compactTimer->setSingleShot(true);
+    m_compactTimer->setInterval(COMPACT_DELAY_MS);
+    connect(m_compactTimer, &QTimer::timeout, this, &ConfigJournal::startCompaction);
+}
+
+ConfigJournal::~ConfigJournal()
+{
+    // Records still in the journal are replayed by the next load
+    waitForCompaction();
+}
+
+void ConfigJournal::setConfigFile(const QString &configPath, qint64 lastRecordId)
+{
+    if (configPath == m_configPath) {
+        m_lastRecordId = qMax(m_lastRecordId, lastRecordId);
+        return;
+    }
+    if (m_compactTimer->isActive()) {
+        m_compactTimer->stop();
+        startCompaction();
+    }
+    m_configPath = configPath;
+    m_lastRecordId = lastRecordId;
+    if (exists(configPath)) {
+        m_compactTimer->start();
+    }
+}
+
+bool ConfigJournal::appendPreset(const QString &topic, const QJsonObject &command, QString *errorMessage)
+{
+    QJsonObject record;
+    record.insert("type", "preset");
+    record.insert("topic", topic);
+    record.insert("command", command);
+    return append(record, errorMessage);
+}
+
+bool ConfigJournal::appendImport(const QJsonObject &config, QString *errorMessage)
+{
+    QJsonObject record;
+    record.insert("type", "import");
+    record.insert("config", config);
+    return append(record, errorMessage);
+}
+
+bool ConfigJournal::append(const QJsonObject &record, QString *errorMessage)
+{
+    if (m_configPath.isEmpty()) {
+        *errorMessage = ConfigCache::translate("No configuration file loaded.");
+        return false;
+    }
+    QString path = journalPath(m_configPath);
+    bool created = !QFile::exists(path);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        *errorMessage = ConfigCache::translate("Could not open file for writing: %1").arg(path);
+        return false;
+    }
+
+    QJsonObject numbered = record;
+    numbered.insert("id", double(m_lastRecordId + 1));
+    QByteArray line = QJsonDocument(numbered).toJson(QJsonDocument::Compact) + '\n';
+    qint64 size = completeLinesSize(&file);
+    if (size != file.size() && !file.resize(size)) {
+        *errorMessage = ConfigCache::translate("Could not write to %1: %2").arg(path, file.errorString());
+        return false;
+    }
+    if (!file.seek(size) || file.write(line) != line.size() || !file.flush() || ::fsync(file.handle()) != 0) {
+        *errorMessage = ConfigCache::translate("Could not write to %1: %2").arg(path, file.errorString());
+        // A partial line would swallow the next record
+        file.resize(size);
+        return false;
+    }
+    file.close();
+    if (created) {
+        syncDirectory(QFileInfo(path).absolutePath());
+    }
+
+    ++m_lastRecordId;
+    ++m_appendCount;
+    m_compactTimer->start();
+    return true;
+}
+
+void ConfigJournal::waitForCompaction()
+{
+    if (m_compactor) {
+        m_compactor->wait();
+    }
+}
+
+QString ConfigJournal::journalPath(const QString &configPath)
+{
+    QFileInfo info(configPath);
+    return info.absolutePath() + "/." + info.fileName() + ".journal";
+}
+
+bool ConfigJournal::exists(const QString &configPath)
+{
+    return QFile::exists(journalPath(configPath)) || QFile::exists(compactingPath(configPath));
+}
+
+void ConfigJournal::replay(const QString &configPath, QJsonObject *root, QStringList *warnings, qint64 *lastRecordId)
+{
+    qint64 lastId = 0;
+    qint64 applied = QFile::exists(appliedPath(configPath)) ? appliedRecordId(configPath) : 0;
+    replayFile(compactingPath(configPath), root, warnings, applied, &lastId);
+    replayFile(journalPath(configPath), root, warnings, applied, &lastId);
+    if (lastRecordId) {
+        *lastRecordId = lastId;
+    }
+}
+
+void ConfigJournal::applyPreset(QJsonObject *root, const QString &topic, const QJsonObject &command)
+{
+    QJsonObject topics = root->value("topics").toObject();
+    QJsonArray commands = topics.value(topic).toArray();
+    commands.append(command);
+    topics.insert(topic, commands);
+    root->insert("topics", topics);
+}
+
+// Top-level keys of the imported file replace those of the config
+void ConfigJournal::applyImport(QJsonObject *root, const QJsonObject &config)
+{
+    for (auto it = config.begin(); it != config.end(); ++it) {
+        root->insert(it.key(), it.value());
+    }
+}
+
+void ConfigJournal::startCompaction()
+{
+    if (m_configPath.isEmpty()) {
+        return;
+    }
+    if (m_compactor) {
+        // After the running one
+        m_compactTimer->start();
+        return;
+    }
+
+    QString configPath = m_configPath;
+    QString journal = journalPath(configPath);
+    QString compacting = compactingPath(configPath);
+    // A journal left from a compaction that did not finish goes first
+    if (!QFile::exists(compacting) && QFile::exists(journal) && !QFile::rename(journal, compacting)) {
+        emit compactionFailed(ConfigCache::translate("Could not rename %1").arg(journal));
+        return;
+    }
+    if (!QFile::exists(compacting)) {
+        return;
+    }
+
+    QThread *thread = QThread::create([this, configPath]() {
+        QString errorMessage;
+        if (!compact(configPath, &errorMessage)) {
+            QMetaObject::invokeMethod(this, [this, errorMessage]() {
+                emit compactionFailed(errorMessage);
+            }, Qt::QueuedConnection);
+        }
+    });
+    connect(thread, &QThread::finished, this, [this, configPath]() {
+        // Records saved meanwhile; a failed compaction waits for the next save
+        if (configPath == m_configPath && !QFile::exists(compactingPath(configPath))
+            && QFile::exists(journalPath(configPath))) {
+            m_compactTimer->start();
+        }
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_compactor = thread;
+    thread->start();
+}
+
+// Runs on the compaction thread
+bool ConfigJournal::compact(const QString &configPath, QString *errorMessage)
+{
+    QJsonObject root;
+    if (QFile::exists(configPath)) {
+        if (!ConfigCache::load(configPath, &root, errorMessage)) {
+            return false;
+        }
+    } else {
+        root.insert("topics", QJsonObject());
+    }
+    QStringList warnings;
+    qint64 lastRecordId = 0;
+    replayFile(compactingPath(configPath), &root, &warnings, appliedRecordId(configPath), &lastRecordId);
+    QByteArray data = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    // The marker goes first: should the replace below not happen, the file
+    // does not match it and its records are not lost
+    QSaveFile marker(appliedPath(configPath));
+    if (!marker.open(QIODevice::WriteOnly)) {
+        *errorMessage = ConfigCache::translate("Could not open file for writing: %1").arg(appliedPath(configPath));
+        return false;
+    }
+    marker.write(QByteArray::number(lastRecordId) + ' '
+                 + QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex() + '\n');
+    if (!marker.commit()) {
+        *errorMessage = ConfigCache::translate("Could not write to %1: %2").arg(appliedPath(configPath), marker.errorString());
+        return false;
+    }
+
+    // Readers see the old file or the new one, never a half-written one
+    QSaveFile file(configPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorMessage = ConfigCache::translate("Could not open file for writing: %1").arg(configPath);
+        return false;
+    }
+    file.write(data);
+    if (!file.commit()) {
+        *errorMessage = ConfigCache::translate("Could not write to %1: %2").arg(configPath, file.errorString());
+        return false;
+    }
+    QFile::remove(compactingPath(configPath));
+    QFile::remove(appliedPath(configPath));
+    return true;
+}
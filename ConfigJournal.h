@@ -0,0 +1,66 @@
+#ifndef CONFIGJOURNAL_H
+#define CONFIGJOURNAL_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+
+class QThread;
+class QTimer;
+
+// Preset saves and imports as one-line records appended to .<name>.journal
+// next to the config, each synced to disk before the save returns, so a save
+// costs the same whatever the size of the file. Loading replays the records
+// on top of the file; a compaction on a background thread later folds them
+// into it and replaces it atomically.
+//
+// Each record has an id. A compaction notes the last one it folds in, with
+// the hash of the file it writes, in .<name>.journal.applied until the
+// folded journal is removed: a crash between the replace and the removal
+// loses nothing and applies nothing twice, and the config keeps its schema.
+class ConfigJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConfigJournal(QObject *parent = nullptr);
+    ~ConfigJournal();
+
+    // Records from now on go to this config's journal, numbered after
+    // lastRecordId; a journal left over from an earlier run is compacted soon
+    void setConfigFile(const QString &configPath, qint64 lastRecordId);
+    bool appendPreset(const QString &topic, const QJsonObject &command, QString *errorMessage);
+    bool appendImport(const QJsonObject &config, QString *errorMessage);
+    // Bumped by every append, to tell a load that started before one
+    int appendCount() const { return m_appendCount; }
+    // Before anything else writes the config file
+    void waitForCompaction();
+
+    static QString journalPath(const QString &configPath);
+    static bool exists(const QString &configPath);
+    // Applies the journal of configPath to root, the content of that file,
+    // and gives the last record id seen. Damaged records are skipped with a
+    // warning, except a torn last one, which is a save that never returned.
+    static void replay(const QString &configPath, QJsonObject *root, QStringList *warnings,
+                       qint64 *lastRecordId = nullptr);
+    static void applyPreset(QJsonObject *root, const QString &topic, const QJsonObject &command);
+    static void applyImport(QJsonObject *root, const QJsonObject &config);
+
+signals:
+    void compactionFailed(const QString &errorMessage);
+
+private:
+    bool append(const QJsonObject &record, QString *errorMessage);
+    void startCompaction();
+    static bool compact(const QString &configPath, QString *errorMessage);
+
+    QString m_configPath;
+    QTimer *m_compactTimer;
+    QPointer<QThread> m_compactor;
+    int m_appendCount = 0;
+    qint64 m_lastRecordId = 0;
+};
+
+#endif // CONFIGJOURNAL_H
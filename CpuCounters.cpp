@@ -0,0 +1,142 @@
+#include "CpuCounters.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QLocale>
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+namespace CpuCounters {
+
+namespace {
+
+struct CounterConfig {
+    quint32 type;
+    quint64 config;
+};
+
+const CounterConfig COUNTER_CONFIGS[CounterCount] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }
+};
+
+// Value followed by PERF_FORMAT_TOTAL_TIME_ENABLED and _RUNNING
+struct ReadFormat {
+    quint64 value;
+    quint64 timeEnabled;
+    quint64 timeRunning;
+};
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("CpuCounters", text);
+}
+
+}
+
+bool isAvailable(QString *reason, bool *excludeKernel)
+{
+    *excludeKernel = false;
+    if (geteuid() == 0) {
+        return true;
+    }
+
+    QFile file("/proc/sys/kernel/perf_event_paranoid");
+    if (!file.open(QIODevice::ReadOnly)) {
+        *reason = tr("perf events are not supported by this kernel");
+        return false;
+    }
+    int paranoid = file.readAll().trimmed().toInt();
+    if (paranoid > 2) {
+        *reason = tr("kernel.perf_event_paranoid is %1, unprivileged counters need 2 or less").arg(paranoid);
+        return false;
+    }
+    // Level 2 only allows user-space measurements
+    *excludeKernel = paranoid >= 2;
+    return true;
+}
+
+void open(pid_t pid, bool excludeKernel, int fds[CounterCount], Values *values)
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = COUNTER_CONFIGS[i].type;
+        attr.config = COUNTER_CONFIGS[i].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = excludeKernel ? 1 : 0;
+        attr.exclude_hv = 1;
+
+        fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+        if (fds[i] < 0 && values->error == 0) {
+            values->error = errno;
+        }
+    }
+}
+
+void read(const int fds[CounterCount], Values *values)
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        ReadFormat data;
+        if (fds[i] < 0 || ::read(fds[i], &data, sizeof(data)) != sizeof(data) || data.timeRunning == 0) {
+            continue;
+        }
+        // Scale up when the counter was multiplexed with others
+        double scale = data.timeRunning < data.timeEnabled ? static_cast<double>(data.timeEnabled) / data.timeRunning : 1.0;
+        values->value[i] = static_cast<unsigned long long>(data.value * scale);
+        values->valid[i] = true;
+    }
+}
+
+void close(int fds[CounterCount])
+{
+    for (int i = 0; i < CounterCount; ++i) {
+        if (fds[i] >= 0) {
+            ::close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+}
+
+QString format(const Values &values)
+{
+    QLocale locale;
+    QStringList parts;
+    if (values.valid[Cycles]) {
+        parts << tr("%1 cycles").arg(locale.toString(values.value[Cycles]));
+    }
+    if (values.valid[Instructions]) {
+        QString instructions = tr("%1 instructions").arg(locale.toString(values.value[Instructions]));
+        if (values.valid[Cycles] && values.value[Cycles] > 0) {
+            instructions += tr(" (IPC %1)").arg(static_cast<double>(values.value[Instructions]) / values.value[Cycles], 0, 'f', 2);
+        }
+        parts << instructions;
+    }
+    if (values.valid[CacheMisses]) {
+        parts << tr("%1 cache misses").arg(locale.toString(values.value[CacheMisses]));
+    }
+    if (values.valid[BranchMisses]) {
+        parts << tr("%1 branch misses").arg(locale.toString(values.value[BranchMisses]));
+    }
+    if (values.valid[TaskClock]) {
+        parts << tr("task-clock %1 ms").arg(values.value[TaskClock] / 1e6, 0, 'f', 2);
+    }
+
+    if (parts.isEmpty()) {
+        return tr("CPU counters unavailable: %1").arg(QString::fromLocal8Bit(strerror(values.error ? values.error : ENOENT)));
+    }
+    return parts.join(", ");
+}
+
+}
@@ -0,0 +1,39 @@
+#ifndef CPUCOUNTERS_H
+#define CPUCOUNTERS_H
+
+#include <QString>
+
+#include <sys/types.h>
+
+// Hardware and software performance counters attached to a launched command
+// with perf_event_open(), inherited by everything it forks.
+namespace CpuCounters {
+
+enum Counter {
+    Cycles = 0,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+    TaskClock,
+    CounterCount
+};
+
+struct Values {
+    int error = 0;                        // errno of the first counter that failed to open
+    bool valid[CounterCount] = {};
+    unsigned long long value[CounterCount] = {};
+};
+
+// Checked in Quish before the run; reason explains a refusal
+bool isAvailable(QString *reason, bool *excludeKernel);
+
+// Async-signal-safe: called between fork and exec, from the reaper process
+void open(pid_t pid, bool excludeKernel, int fds[CounterCount], Values *values);
+void read(const int fds[CounterCount], Values *values);
+void close(int fds[CounterCount]);
+
+QString format(const Values &values);
+
+}
+
+#endif // CPUCOUNTERS_H
@@ -0,0 +1,218 @@
+#include "FuzzyIndex.h"
+
+#include <QDateTime>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+
+static const int MATCH_SCORE = 16;
+static const int CONSECUTIVE_BONUS = 18;
+static const int BOUNDARY_BONUS = 24;
+static const int NAME_BONUS = 20;           // the whole term inside the command name
+static const int MAX_GAP_PENALTY = 10;
+// Start positions tried per term: enough for "push" to find the word after a stray 'p'
+static const int MAX_STARTS = 8;
+static const int MAX_FREQUENCY_BOOST = 48;
+
+// Letters and digits get a bit each, anything else shares the rest
+static quint64 characterBit(QChar c)
+{
+    ushort code = c.unicode();
+    if (code >= 'a' && code <= 'z') {
+        return quint64(1) << (code - 'a');
+    }
+    if (code >= '0' && code <= '9') {
+        return quint64(1) << (26 + code - '0');
+    }
+    return quint64(1) << (36 + code % 28);
+}
+
+static bool isSeparator(QChar c)
+{
+    return c.isSpace() || c == '/' || c == '-' || c == '_' || c == '.' || c == ':';
+}
+
+// QString::toLower() may change the length; the index and the query must not
+static QString lowered(const QString &text)
+{
+    QString lower = text;
+    for (QChar &c : lower) {
+        c = c.toLower();
+    }
+    return lower;
+}
+
+void FuzzyIndex::build(const CommandCatalog &catalog)
+{
+    m_entries.clear();
+    m_text.clear();
+    m_boundary.clear();
+    m_entries.reserve(catalog.commandCount());
+
+    for (const QString &topic : catalog.topics()) {
+        for (const CommandSpec &command : catalog.commands(topic)) {
+            addEntry(command);
+        }
+    }
+}
+
+void FuzzyIndex::addEntry(const CommandSpec &command)
+{
+    Entry entry;
+    entry.target = command.target();
+    entry.executable = command.executable;
+    QString line = entry.target;
+    entry.nameBegin = command.topic.size() + 1;
+    entry.nameEnd = line.size();
+    line += QLatin1Char(' ') + command.executable;
+    for (const ArgSpec &arg : command.arguments) {
+        line += QLatin1Char(' ') + arg.name;
+    }
+
+    entry.offset = m_text.size();
+    entry.length = line.size();
+    for (int i = 0; i < line.size(); ++i) {
+        QChar c = line.at(i);
+        QChar previous = i > 0 ? line.at(i - 1) : QChar(' ');
+        bool boundary = isSeparator(previous) ? !isSeparator(c)
+                                              : (previous.isLower() && c.isUpper()) || (previous.isLetter() && c.isDigit());
+        QChar lower = c.toLower();
+        m_text.append(lower);
+        m_boundary.append(char(boundary));
+        entry.mask |= characterBit(lower);
+    }
+    m_entries.append(entry);
+}
+
+void FuzzyIndex::setStats(const QHash<QString, RunHistory::CommandStats> &stats)
+{
+    QDateTime now = QDateTime::currentDateTime();
+    for (Entry &entry : m_entries) {
+        auto it = stats.constFind(entry.target);
+        if (it == stats.constEnd()) {
+            entry.boost = 0;
+            continue;
+        }
+        int boost = qMin(int(8 * std::log2(1.0 + it->runs)), MAX_FREQUENCY_BOOST);
+        qint64 age = it->lastRun.isValid() ? it->lastRun.secsTo(now) : -1;
+        if (age >= 0 && age < 3600) {
+            boost += 24;
+        } else if (age >= 0 && age < 24 * 3600) {
+            boost += 16;
+        } else if (age >= 0 && age < 7 * 24 * 3600) {
+            boost += 8;
+        }
+        entry.boost = boost;
+    }
+}
+
+// Best score of term as a subsequence of the entry's line, -1 when it is not one.
+// Each try takes the earliest letters from its start on.
+int FuzzyIndex::matchTerm(const Entry &entry, const QString &term) const
+{
+    const QChar *text = m_text.constData() + entry.offset;
+    const char *boundary = m_boundary.constData() + entry.offset;
+    const QChar *letters = term.constData();
+    int termLength = term.size();
+
+    int best = -1;
+    int starts = 0;
+    for (int start = 0; start < entry.length && starts < MAX_STARTS; ++start) {
+        if (text[start] != letters[0]) {
+            continue;
+        }
+        ++starts;
+
+        int score = 0;
+        int previous = -1;
+        int matched = 0;
+        bool inName = true;
+        for (int pos = start; pos < entry.length && matched < termLength; ++pos) {
+            if (text[pos] != letters[matched]) {
+                continue;
+            }
+            score += MATCH_SCORE;
+            if (previous >= 0 && pos == previous + 1) {
+                score += CONSECUTIVE_BONUS;
+            } else if (previous >= 0) {
+                score -= qMin(pos - previous - 1, MAX_GAP_PENALTY);
+            }
+            if (boundary[pos]) {
+                score += BOUNDARY_BONUS;
+            }
+            if (pos < entry.nameBegin || pos >= entry.nameEnd) {
+                inName = false;
+            }
+            previous = pos;
+            ++matched;
+        }
+        if (matched < termLength) {
+            // A later start has even fewer letters left to match in
+            break;
+        }
+        if (inName) {
+            score += NAME_BONUS;
+        }
+        best = qMax(best, score);
+    }
+    return best;
+}
+
+QVector<FuzzyIndex::Match> FuzzyIndex::search(const QString &query, int limit, QVector<int> *matched,
+                                              const QVector<int> *within) const
+{
+    const QStringList terms = lowered(query).split(' ', Qt::SkipEmptyParts);
+    quint64 mask = 0;
+    for (const QString &term : terms) {
+        for (QChar c : term) {
+            mask |= characterBit(c);
+        }
+    }
+
+    QVector<Match> matches;
+    if (matched) {
+        matched->clear();
+    }
+    int count = within ? within->size() : m_entries.size();
+    for (int k = 0; k < count; ++k) {
+        int index = within ? within->at(k) : k;
+        const Entry &entry = m_entries.at(index);
+        if ((entry.mask & mask) != mask) {
+            continue;
+        }
+        int score = entry.boost;
+        bool found = true;
+        for (const QString &term : terms) {
+            int termScore = matchTerm(entry, term);
+            if (termScore < 0) {
+                found = false;
+                break;
+            }
+            score += termScore;
+        }
+        if (!found) {
+            continue;
+        }
+        if (matched) {
+            matched->append(index);
+        }
+        matches.append({ index, score });
+    }
+
+    // Only the rows that are shown get sorted; ties go to the shorter line
+    int top = qMin(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + top, matches.end(), [this](const Match &a, const Match &b) {
+        if (a.score != b.score) {
+            return a.score > b.score;
+        }
+        int lengthA = m_entries.at(a.entry).length;
+        int lengthB = m_entries.at(b.entry).length;
+        if (lengthA != lengthB) {
+            return lengthA < lengthB;
+        }
+        return a.entry < b.entry;
+    });
+    matches.resize(top);
+    return matches;
+}
@@ -0,0 +1,60 @@
+#ifndef FUZZYINDEX_H
+#define FUZZYINDEX_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include "CommandCatalog.h"
+#include "RunHistory.h"
+
+// Every command of a catalog as one searchable line: "topic/name executable
+// argument names". Built with the catalog at load, so a search only walks
+// flat lowercase text, skipping most entries on a character mask first.
+class FuzzyIndex
+{
+public:
+    struct Match {
+        int entry;
+        int score;
+    };
+
+    void build(const CommandCatalog &catalog);
+    // A command appended to the catalog after build()
+    void add(const CommandSpec &command) { addEntry(command); }
+    // Frequent and recent commands rank higher, and lead the empty query
+    void setStats(const QHash<QString, RunHistory::CommandStats> &stats);
+
+    int size() const { return m_entries.size(); }
+    QString target(int entry) const { return m_entries.at(entry).target; }
+    QString executable(int entry) const { return m_entries.at(entry).executable; }
+
+    // Entries matching every space-separated term of query in order of its
+    // letters, best first, at most limit of them. matched gets every matching
+    // entry: a query that extends this one only needs to look at those, given
+    // as within.
+    QVector<Match> search(const QString &query, int limit, QVector<int> *matched = nullptr,
+                          const QVector<int> *within = nullptr) const;
+
+private:
+    struct Entry {
+        QString target;
+        QString executable;
+        int offset = 0;             // of its line in m_text
+        int length = 0;
+        int nameBegin = 0;          // the command name within the line
+        int nameEnd = 0;
+        quint64 mask = 0;           // characters of the line, see characterBit()
+        int boost = 0;
+    };
+
+    void addEntry(const CommandSpec &command);
+
+    int matchTerm(const Entry &entry, const QString &term) const;
+
+    QVector<Entry> m_entries;
+    QString m_text;                 // lowercase
+    QByteArray m_boundary;          // 1 where a word starts in m_text
+};
+
+#endif // FUZZYINDEX_H
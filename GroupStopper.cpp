@@ -0,0 +1,188 @@
+#include "GroupStopper.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QThread>
+#include <QTimer>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace {
+
+const int DEFAULT_WAIT_MS = 3000;
+
+const struct {
+    const char *name;
+    int signal;
+} SIGNALS[] = {
+    { "INT", SIGINT },
+    { "TERM", SIGTERM },
+    { "KILL", SIGKILL },
+    { "HUP", SIGHUP },
+    { "QUIT", SIGQUIT }
+};
+
+}
+
+GroupStopper::GroupStopper(QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &GroupStopper::nextStep);
+}
+
+bool GroupStopper::parseSteps(const QString &text, QList<Step> *steps, QString *errorMessage)
+{
+    steps->clear();
+    const QStringList parts = text.split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        QString name = part.section(':', 0, 0).toUpper();
+        if (name.startsWith("SIG")) {
+            name = name.mid(3);
+        }
+        Step step;
+        step.signal = 0;
+        for (const auto &known : SIGNALS) {
+            if (name == known.name) {
+                step.signal = known.signal;
+            }
+        }
+        bool waitOk = true;
+        double seconds = part.contains(':') ? part.section(':', 1).toDouble(&waitOk) : -1;
+        if (step.signal == 0 || !waitOk || (part.contains(':') && seconds < 0)) {
+            *errorMessage = QCoreApplication::translate("GroupStopper", "Invalid stop step \"%1\", expected e.g. INT:2 TERM:5 KILL")
+                                .arg(part);
+            return false;
+        }
+        step.waitMs = seconds >= 0 ? qRound(seconds * 1000) : DEFAULT_WAIT_MS;
+        steps->append(step);
+    }
+    if (steps->isEmpty()) {
+        *errorMessage = QCoreApplication::translate("GroupStopper", "The stop sequence is empty");
+        return false;
+    }
+    return true;
+}
+
+void GroupStopper::start(pid_t group, const QList<Step> &steps)
+{
+    stop();
+    if (group <= 0) {
+        return;
+    }
+    m_group = group;
+    m_steps = steps;
+    m_step = 0;
+    nextStep();
+}
+
+void GroupStopper::stop()
+{
+    m_timer->stop();
+    m_group = -1;
+}
+
+void GroupStopper::hurry()
+{
+    if (isActive()) {
+        m_timer->stop();
+        nextStep();
+    }
+}
+
+void GroupStopper::nextStep()
+{
+    if (m_group <= 0) {
+        return;
+    }
+    if (m_step >= m_steps.size() || (m_step > 0 && !isAlive(m_group))) {
+        stop();
+        return;
+    }
+    const Step &step = m_steps.at(m_step++);
+    signalGroup(m_group, step.signal);
+    emit signalSent(step.signal);
+    m_timer->start(step.waitMs);
+}
+
+bool GroupStopper::isAlive(pid_t group)
+{
+    return group > 0 && (::kill(-group, 0) == 0 || errno == EPERM);
+}
+
+QList<pid_t> GroupStopper::liveMembers(pid_t group)
+{
+    QList<pid_t> members;
+    if (group <= 0) {
+        return members;
+    }
+    const QStringList entries = QDir("/proc").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        bool isPid;
+        pid_t pid = entry.toInt(&isPid);
+        if (!isPid) {
+            continue;
+        }
+        QFile file(QString("/proc/%1/stat").arg(pid));
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        // "pid (comm) state ppid pgrp ...", where comm may hold spaces and parentheses
+        QByteArray stat = file.readAll();
+        QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+        if (fields.size() < 3 || fields[2].toInt() != group) {
+            continue;
+        }
+        if (fields[0] != "Z" && fields[0] != "X") {
+            members.append(pid);
+        }
+    }
+    return members;
+}
+
+void GroupStopper::findLiveMembers(pid_t group, QObject *context,
+                                   const std::function<void(const QList<pid_t> &)> &done)
+{
+    QSharedPointer<QList<pid_t>> members(new QList<pid_t>);
+    QThread *thread = QThread::create([group, members]() {
+        *members = liveMembers(group);
+    });
+    // Dropped with context when it is gone by then
+    connect(thread, &QThread::finished, context, [members, done]() {
+        done(*members);
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start();
+}
+
+bool GroupStopper::killLeftovers(pid_t group)
+{
+    if (!isAlive(group)) {
+        return false;
+    }
+    signalGroup(group, SIGKILL);
+    return true;
+}
+
+void GroupStopper::signalGroup(pid_t group, int signal)
+{
+    if (group > 0) {
+        ::kill(-group, signal);
+    }
+}
+
+QString GroupStopper::signalName(int signal)
+{
+    for (const auto &known : SIGNALS) {
+        if (known.signal == signal) {
+            return QString("SIG") + known.name;
+        }
+    }
+    return QString("signal %1").arg(signal);
+}
@@ -0,0 +1,65 @@
+#ifndef GROUPSTOPPER_H
+#define GROUPSTOPPER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <functional>
+
+#include <sys/types.h>
+
+class QTimer;
+
+// Stops a process group step by step: each signal of the sequence goes to the
+// whole group, and the next one follows only if something is still alive
+// after the wait. Runs are group leaders, so the group id is the run's pid.
+class GroupStopper : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Step {
+        int signal;
+        int waitMs;
+    };
+
+    explicit GroupStopper(QObject *parent = nullptr);
+
+    // "INT:2 TERM:5 KILL": signal names with the seconds to wait after each
+    static bool parseSteps(const QString &text, QList<Step> *steps, QString *errorMessage);
+    static QString defaultStepsText() { return "INT:2 TERM:5 KILL"; }
+
+    void start(pid_t group, const QList<Step> &steps);
+    void stop();
+    // Sends the next signal now instead of waiting for the current step
+    void hurry();
+    bool isActive() const { return m_group > 0; }
+
+    // Whether anything of the group is left, zombies included; a kill(), no /proc scan
+    static bool isAlive(pid_t group);
+    // Processes of the group that have not exited (zombies count as exited).
+    // Reads every /proc/<pid>/stat: not for the GUI thread.
+    static QList<pid_t> liveMembers(pid_t group);
+    // liveMembers() on a worker thread; done gets them on context's thread
+    static void findLiveMembers(pid_t group, QObject *context,
+                                const std::function<void(const QList<pid_t> &)> &done);
+    // SIGKILL to what is left, without waiting for it to go away; false when nothing was
+    static bool killLeftovers(pid_t group);
+    // To every process of the group
+    static void signalGroup(pid_t group, int signal);
+
+    static QString signalName(int signal);
+
+signals:
+    void signalSent(int signal);
+
+private:
+    void nextStep();
+
+    QTimer *m_timer;
+    QList<Step> m_steps;
+    int m_step = 0;
+    pid_t m_group = -1;
+};
+
+#endif // GROUPSTOPPER_H
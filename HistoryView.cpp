@@ -0,0 +1,266 @@
+#include "HistoryView.h"
+#include "ResourceMonitor.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLocale>
+#include <QPainter>
+#include <QSplitter>
+
+#include <algorithm>
+
+// Rows of the runs table
+static const int LOADED_RUNS = 5000;
+// Percentiles cover the latest runs only, so an old slow period fades out
+static const int STATS_RUNS = 200;
+static const int TREND_RUNS = 30;
+static const QSize TREND_SIZE(120, 22);
+
+enum CommandColumn { CommandNameColumn, RunsColumn, FailedColumn, P50Column, P95Column, TrendColumn, LastRunColumn };
+enum RunColumn { StartedColumn, DurationColumn, ExitColumn, CpuColumn, RssColumn, OutputColumn, DirectoryColumn, CommandLineColumn };
+
+// Nearest rank on sorted durations
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int rank = qMax(1, (percent * sorted.size() + 99) / 100);
+    return sorted.at(rank - 1);
+}
+
+HistoryView::HistoryView(RunHistory *history, QWidget *parent)
+    : QWidget(parent)
+    , m_history(history)
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *controlsLayout = new QHBoxLayout();
+    m_lblSummary = new QLabel(this);
+    controlsLayout->addWidget(m_lblSummary);
+    controlsLayout->addStretch();
+    m_btnRerun = new QPushButton(QIcon(":/icons/Player Play.png"), tr("Re-run"), this);
+    m_btnRerun->setToolTip(tr("Run the selected command line again, in the same working directory"));
+    m_btnRerun->setEnabled(false);
+    m_btnRefresh = new QPushButton(QIcon(":/icons/Refresh.png"), tr("Refresh"), this);
+    controlsLayout->addWidget(m_btnRerun);
+    controlsLayout->addWidget(m_btnRefresh);
+    mainLayout->addLayout(controlsLayout);
+
+    QSplitter *splitter = new QSplitter(Qt::Vertical, this);
+    m_commandsTable = new QTableWidget(0, 7, splitter);
+    m_commandsTable->setHorizontalHeaderLabels(QStringList() << tr("Command") << tr("Runs") << tr("Failed")
+                                                             << tr("p50") << tr("p95") << tr("Trend") << tr("Last run"));
+    m_commandsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_commandsTable->horizontalHeader()->setSectionResizeMode(CommandNameColumn, QHeaderView::Stretch);
+    m_commandsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_commandsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_commandsTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_commandsTable->setIconSize(TREND_SIZE);
+    m_commandsTable->verticalHeader()->setDefaultSectionSize(TREND_SIZE.height() + 6);
+    m_commandsTable->verticalHeader()->setVisible(false);
+
+    m_runsTable = new QTableWidget(0, 8, splitter);
+    m_runsTable->setHorizontalHeaderLabels(QStringList() << tr("Started") << tr("Duration") << tr("Exit")
+                                                         << tr("CPU user/sys") << tr("Max RSS") << tr("Output")
+                                                         << tr("Directory") << tr("Command line"));
+    m_runsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_runsTable->horizontalHeader()->setStretchLastSection(true);
+    m_runsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_runsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_runsTable->setSelectionMode(QAbstractItemView::SingleSelection);
+    m_runsTable->verticalHeader()->setVisible(false);
+    mainLayout->addWidget(splitter);
+
+    connect(m_btnRefresh, &QPushButton::clicked, this, &HistoryView::refresh);
+    connect(m_btnRerun, &QPushButton::clicked, this, &HistoryView::onRerunClicked);
+    connect(m_commandsTable, &QTableWidget::itemSelectionChanged, this, &HistoryView::onCommandSelected);
+    connect(m_runsTable, &QTableWidget::itemSelectionChanged, this, &HistoryView::onRunSelected);
+    connect(m_runsTable, &QTableWidget::cellDoubleClicked, this, &HistoryView::onRerunClicked);
+    // Only read back while someone looks at it
+    connect(m_history, &RunHistory::recorded, this, [this]() {
+        m_stale = true;
+        if (isVisible()) {
+            refresh();
+        }
+    });
+
+    if (!m_history->isOpen()) {
+        m_lblSummary->setText(tr("History unavailable: %1").arg(m_history->errorString()));
+        m_lblSummary->setStyleSheet("color: red;");
+        m_btnRefresh->setEnabled(false);
+    }
+}
+
+void HistoryView::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    if (m_stale) {
+        refresh();
+    }
+}
+
+void HistoryView::refresh()
+{
+    m_stale = false;
+    if (!m_history->isOpen()) {
+        return;
+    }
+
+    // Counts cover every stored run, percentiles and the trend the latest runs of each command
+    const QHash<QString, RunHistory::CommandStats> stats = m_history->commandStats();
+    QStringList commands = stats.keys();
+    std::sort(commands.begin(), commands.end());
+
+    m_commandsTable->blockSignals(true);
+    m_commandsTable->setRowCount(0);
+    int selectedRow = -1;
+    int totalRuns = 0;
+    for (const QString &command : commands) {
+        const RunHistory::CommandStats &commandStats = stats[command];
+        totalRuns += commandStats.runs;
+        // Oldest first, for the trend
+        QVector<RunHistory::Entry> runs = m_history->recent(STATS_RUNS, command);
+        std::reverse(runs.begin(), runs.end());
+        QVector<qint64> durations;
+        for (const RunHistory::Entry &run : runs) {
+            durations.append(run.durationMs);
+        }
+        std::sort(durations.begin(), durations.end());
+
+        int row = m_commandsTable->rowCount();
+        m_commandsTable->insertRow(row);
+        m_commandsTable->setItem(row, CommandNameColumn, new QTableWidgetItem(command));
+        QTableWidgetItem *runsItem = new QTableWidgetItem();
+        runsItem->setData(Qt::DisplayRole, commandStats.runs);
+        m_commandsTable->setItem(row, RunsColumn, runsItem);
+        QTableWidgetItem *failedItem = new QTableWidgetItem();
+        failedItem->setData(Qt::DisplayRole, commandStats.failed);
+        if (commandStats.failed > 0) {
+            failedItem->setForeground(Qt::red);
+        }
+        m_commandsTable->setItem(row, FailedColumn, failedItem);
+        m_commandsTable->setItem(row, P50Column, new QTableWidgetItem(ResourceMonitor::formatMs(percentile(durations, 50), 2)));
+        m_commandsTable->setItem(row, P95Column, new QTableWidgetItem(ResourceMonitor::formatMs(percentile(durations, 95), 2)));
+        QTableWidgetItem *trendItem = new QTableWidgetItem();
+        trendItem->setData(Qt::DecorationRole, sparkline(runs.mid(qMax(0, runs.size() - TREND_RUNS))));
+        trendItem->setToolTip(tr("Duration of the last %n run(s), failures in red", nullptr, qMin(runs.size(), TREND_RUNS)));
+        m_commandsTable->setItem(row, TrendColumn, trendItem);
+        m_commandsTable->setItem(row, LastRunColumn,
+                                 new QTableWidgetItem(QLocale().toString(commandStats.lastRun, QLocale::ShortFormat)));
+        if (command == m_selectedCommand) {
+            selectedRow = row;
+        }
+    }
+    if (selectedRow >= 0) {
+        m_commandsTable->selectRow(selectedRow);
+    } else {
+        m_selectedCommand.clear();
+    }
+    m_commandsTable->blockSignals(false);
+
+    m_lblSummary->setText(tr("%n run(s) of %1 command(s)", nullptr, totalRuns).arg(commands.size()));
+    fillRuns();
+}
+
+void HistoryView::onCommandSelected()
+{
+    QList<QTableWidgetItem*> selected = m_commandsTable->selectedItems();
+    m_selectedCommand = selected.isEmpty() ? QString()
+                                           : m_commandsTable->item(selected.first()->row(), CommandNameColumn)->text();
+    fillRuns();
+}
+
+// The latest runs of the selected command, or of all of them, newest first
+void HistoryView::fillRuns()
+{
+    m_entries = m_history->recent(LOADED_RUNS, m_selectedCommand);
+    m_runsTable->blockSignals(true);
+    m_runsTable->setRowCount(0);
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const RunHistory::Entry &entry = m_entries.at(i);
+        int row = m_runsTable->rowCount();
+        m_runsTable->insertRow(row);
+        QTableWidgetItem *startedItem = new QTableWidgetItem(QLocale().toString(entry.started, QLocale::ShortFormat));
+        startedItem->setData(Qt::UserRole, i);
+        startedItem->setToolTip(entry.command);
+        m_runsTable->setItem(row, StartedColumn, startedItem);
+        m_runsTable->setItem(row, DurationColumn, new QTableWidgetItem(ResourceMonitor::formatMs(entry.durationMs, 2)));
+        QTableWidgetItem *exitItem = new QTableWidgetItem(QString::number(entry.exitCode));
+        exitItem->setForeground(entry.exitCode == 0 ? QColor(Qt::darkGreen) : QColor(Qt::red));
+        m_runsTable->setItem(row, ExitColumn, exitItem);
+        m_runsTable->setItem(row, CpuColumn, new QTableWidgetItem(
+            entry.userMs < 0 ? tr("n/a") : QString("%1 / %2").arg(ResourceMonitor::formatMs(entry.userMs, 2), ResourceMonitor::formatMs(entry.systemMs, 2))));
+        m_runsTable->setItem(row, RssColumn, new QTableWidgetItem(
+            entry.maxRssKb < 0 ? tr("n/a") : ResourceMonitor::formatBytes(entry.maxRssKb * 1024)));
+        m_runsTable->setItem(row, OutputColumn, new QTableWidgetItem(ResourceMonitor::formatBytes(entry.outputBytes)));
+        m_runsTable->setItem(row, DirectoryColumn, new QTableWidgetItem(entry.workingDirectory));
+        QTableWidgetItem *commandLineItem = new QTableWidgetItem(entry.commandLine);
+        commandLineItem->setToolTip(entry.argv.isEmpty() ? tr("Batched run: cannot be replayed as one command line")
+                                                         : entry.argv.join(' '));
+        m_runsTable->setItem(row, CommandLineColumn, commandLineItem);
+    }
+    m_runsTable->blockSignals(false);
+    onRunSelected();
+}
+
+void HistoryView::onRunSelected()
+{
+    QList<QTableWidgetItem*> selected = m_runsTable->selectedItems();
+    bool replayable = false;
+    if (!selected.isEmpty()) {
+        int index = m_runsTable->item(selected.first()->row(), StartedColumn)->data(Qt::UserRole).toInt();
+        replayable = !m_entries.at(index).argv.isEmpty();
+    }
+    m_btnRerun->setEnabled(replayable);
+}
+
+void HistoryView::onRerunClicked()
+{
+    QList<QTableWidgetItem*> selected = m_runsTable->selectedItems();
+    if (selected.isEmpty()) {
+        return;
+    }
+    int index = m_runsTable->item(selected.first()->row(), StartedColumn)->data(Qt::UserRole).toInt();
+    const RunHistory::Entry &entry = m_entries.at(index);
+    if (!entry.argv.isEmpty()) {
+        emit rerunRequested(entry);
+    }
+}
+
+QPixmap HistoryView::sparkline(const QVector<RunHistory::Entry> &runs)
+{
+    QPixmap pixmap(TREND_SIZE);
+    pixmap.fill(Qt::transparent);
+    if (runs.isEmpty()) {
+        return pixmap;
+    }
+    qint64 longest = 1;
+    for (const RunHistory::Entry &run : runs) {
+        longest = qMax(longest, run.durationMs);
+    }
+
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::Antialiasing);
+    const qreal margin = 2;
+    qreal width = TREND_SIZE.width() - 2 * margin;
+    qreal height = TREND_SIZE.height() - 2 * margin;
+    qreal step = runs.size() > 1 ? width / (runs.size() - 1) : 0;
+    QPolygonF line;
+    for (int i = 0; i < runs.size(); ++i) {
+        line.append(QPointF(margin + i * step, margin + height * (1.0 - double(runs.at(i).durationMs) / longest)));
+    }
+    painter.setPen(QPen(QColor(70, 130, 200), 1.5));
+    painter.drawPolyline(line);
+    painter.setPen(Qt::NoPen);
+    for (int i = 0; i < runs.size(); ++i) {
+        if (runs.at(i).exitCode != 0) {
+            painter.setBrush(Qt::red);
+            painter.drawEllipse(line.at(i), 2, 2);
+        }
+    }
+    painter.setBrush(QColor(70, 130, 200));
+    painter.drawEllipse(line.last(), 2, 2);
+    return pixmap;
+}
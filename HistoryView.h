@@ -0,0 +1,50 @@
+#ifndef HISTORYVIEW_H
+#define HISTORYVIEW_H
+
+#include <QWidget>
+#include <QPushButton>
+#include <QLabel>
+#include <QTableWidget>
+#include <QVector>
+#include "RunHistory.h"
+
+// The History tab: per-command duration percentiles with a trend of the
+// last runs, and the runs themselves, any of which can be started again
+// with the same command line and working directory
+class HistoryView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryView(RunHistory *history, QWidget *parent = nullptr);
+
+public slots:
+    void refresh();
+
+signals:
+    void rerunRequested(const RunHistory::Entry &entry);
+
+protected:
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void onCommandSelected();
+    void onRunSelected();
+    void onRerunClicked();
+
+private:
+    void fillRuns();
+    static QPixmap sparkline(const QVector<RunHistory::Entry> &runs);
+
+    RunHistory *m_history;
+    QTableWidget *m_commandsTable;
+    QTableWidget *m_runsTable;
+    QPushButton *m_btnRefresh;
+    QPushButton *m_btnRerun;
+    QLabel *m_lblSummary;
+    QVector<RunHistory::Entry> m_entries;    // newest first
+    QString m_selectedCommand;
+    bool m_stale = true;
+};
+
+#endif // HISTORYVIEW_H
@@ -0,0 +1,248 @@
+#include "InstanceServer.h"
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QJsonArray>
+
+#include <unistd.h>
+
+static const int MAX_KEPT_RUNS = 16;
+static const int MAX_KEPT_OUTPUT = 4 * 1024 * 1024;
+static const int MAX_REQUEST_SIZE = 1024 * 1024;
+
+// Bytes at the end of data that begin a UTF-8 character not complete yet
+static int incompleteTail(const QByteArray &data)
+{
+    for (int back = 1; back <= qMin(3, data.size()); ++back) {
+        uchar byte = uchar(data.at(data.size() - back));
+        if ((byte & 0xC0) == 0x80) {
+            continue;
+        }
+        int length = byte >= 0xF0 ? 4 : byte >= 0xE0 ? 3 : byte >= 0xC0 ? 2 : 1;
+        return length > back ? back : 0;
+    }
+    return 0;
+}
+
+InstanceServer::InstanceServer(QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &InstanceServer::onNewConnection);
+}
+
+QString InstanceServer::socketName()
+{
+    return QString("quish-%1").arg(getuid());
+}
+
+bool InstanceServer::listen(QString *errorMessage)
+{
+    if (m_server->listen(socketName())) {
+        return true;
+    }
+    // A socket file left by an instance that crashed: nobody answers on it
+    if (m_server->serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalSocket probe;
+        probe.connectToServer(socketName());
+        if (!probe.waitForConnected(200)) {
+            QLocalServer::removeServer(socketName());
+            if (m_server->listen(socketName())) {
+                return true;
+            }
+        }
+    }
+    if (errorMessage) {
+        *errorMessage = m_server->errorString();
+    }
+    return false;
+}
+
+void InstanceServer::setRequestHandler(const RequestHandler &handler)
+{
+    m_handler = handler;
+}
+
+void InstanceServer::runStarted(int run, const QString &commandLine)
+{
+    RunRecord record;
+    record.commandLine = commandLine;
+    m_runs.insert(run, record);
+    while (m_runs.size() > MAX_KEPT_RUNS) {
+        m_runs.erase(m_runs.begin());
+    }
+}
+
+void InstanceServer::runOutput(int run, const QByteArray &data)
+{
+    auto it = m_runs.find(run);
+    if (it == m_runs.end()) {
+        return;
+    }
+    // Late followers get the beginning of the output; past the limit they only
+    // get it live. A smaller chunk after a dropped one must not leave a gap.
+    if (!it->truncated && it->output.size() + data.size() <= MAX_KEPT_OUTPUT) {
+        it->output.append(data);
+    } else {
+        it->truncated = true;
+    }
+
+    // A character split across two reads is sent whole with the second one
+    QByteArray text = it->pending + data;
+    int tail = incompleteTail(text);
+    it->pending = text.right(tail);
+    text.chop(tail);
+    if (text.isEmpty()) {
+        return;
+    }
+    QJsonObject event;
+    event["event"] = "output";
+    event["run"] = run;
+    event["data"] = QString::fromUtf8(text);
+    for (QLocalSocket *socket : it->followers) {
+        send(socket, event);
+    }
+}
+
+void InstanceServer::runFinished(int run, int exitCode)
+{
+    auto it = m_runs.find(run);
+    if (it == m_runs.end()) {
+        return;
+    }
+    it->finished = true;
+    it->exitCode = exitCode;
+
+    // A character the command never completed
+    if (!it->pending.isEmpty()) {
+        QJsonObject event;
+        event["event"] = "output";
+        event["run"] = run;
+        event["data"] = QString::fromUtf8(it->pending);
+        for (QLocalSocket *socket : it->followers) {
+            send(socket, event);
+        }
+        it->pending.clear();
+    }
+
+    QJsonObject event;
+    event["event"] = "finished";
+    event["run"] = run;
+    event["exitCode"] = exitCode;
+    for (QLocalSocket *socket : it->followers) {
+        send(socket, event);
+    }
+    it->followers.clear();
+}
+
+void InstanceServer::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            for (RunRecord &record : m_runs) {
+                record.followers.removeAll(socket);
+            }
+            socket->deleteLater();
+        });
+    }
+}
+
+void InstanceServer::onReadyRead(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError error;
+        QJsonDocument doc = QJsonDocument::fromJson(line, &error);
+        if (!doc.isObject()) {
+            QJsonObject response;
+            response["ok"] = false;
+            response["error"] = tr("Invalid request: %1").arg(error.errorString());
+            send(socket, response);
+            continue;
+        }
+        handleRequest(socket, doc.object());
+    }
+    if (socket->bytesAvailable() > MAX_REQUEST_SIZE) {
+        socket->abort();
+    }
+}
+
+void InstanceServer::handleRequest(QLocalSocket *socket, const QJsonObject &request)
+{
+    QString type = request["request"].toString();
+    QJsonObject response;
+
+    if (type == "stream") {
+        int run = request["run"].toInt(m_runs.isEmpty() ? -1 : m_runs.lastKey());
+        if (!m_runs.contains(run)) {
+            response["ok"] = false;
+            response["error"] = tr("Unknown run %1").arg(run);
+        } else {
+            response["ok"] = true;
+            response["run"] = run;
+        }
+    } else if (m_handler) {
+        response = m_handler(request);
+    } else {
+        response["ok"] = false;
+        response["error"] = tr("Not ready");
+    }
+
+    if (request.contains("id")) {
+        response["id"] = request["id"];
+    }
+    send(socket, response);
+
+    // "run" with "follow" streams the run it started, "stream" any kept run
+    bool ok = response["ok"].toBool();
+    if (ok && (type == "stream" || (type == "run" && request["follow"].toBool()))) {
+        follow(socket, response["run"].toInt());
+    }
+}
+
+void InstanceServer::follow(QLocalSocket *socket, int run)
+{
+    auto it = m_runs.find(run);
+    if (it == m_runs.end()) {
+        return;
+    }
+
+    // The end of a split character comes with the next live chunk
+    QByteArray output = it->output;
+    if (!it->finished) {
+        output.chop(incompleteTail(output));
+    }
+    if (!output.isEmpty()) {
+        QJsonObject event;
+        event["event"] = "output";
+        event["run"] = run;
+        event["data"] = QString::fromUtf8(output);
+        event["replayed"] = true;
+        if (it->truncated) {
+            event["truncated"] = true;
+        }
+        send(socket, event);
+    }
+
+    if (it->finished) {
+        QJsonObject event;
+        event["event"] = "finished";
+        event["run"] = run;
+        event["exitCode"] = it->exitCode;
+        send(socket, event);
+    } else if (!it->followers.contains(socket)) {
+        it->followers.append(socket);
+    }
+}
+
+void InstanceServer::send(QLocalSocket *socket, const QJsonObject &message)
+{
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
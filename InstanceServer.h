@@ -0,0 +1,59 @@
+#ifndef INSTANCESERVER_H
+#define INSTANCESERVER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMap>
+#include <QList>
+#include <functional>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Local socket of the running Quish. Clients send one JSON request per line
+// and get one JSON response per line, followed by "output"/"finished" events
+// for the runs they follow.
+class InstanceServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Answers everything but "stream", which the server handles itself
+    typedef std::function<QJsonObject(const QJsonObject &request)> RequestHandler;
+
+    explicit InstanceServer(QObject *parent = nullptr);
+
+    static QString socketName();
+
+    bool listen(QString *errorMessage = nullptr);
+    void setRequestHandler(const RequestHandler &handler);
+
+    // Fed by the main window for every run, whatever started it
+    void runStarted(int run, const QString &commandLine);
+    void runOutput(int run, const QByteArray &data);
+    void runFinished(int run, int exitCode);
+
+private:
+    struct RunRecord {
+        QString commandLine;
+        QByteArray output;
+        QByteArray pending;         // start of a UTF-8 character the next chunk completes
+        bool truncated = false;
+        bool finished = false;
+        int exitCode = 0;
+        QList<QLocalSocket*> followers;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *socket);
+    void handleRequest(QLocalSocket *socket, const QJsonObject &request);
+    void follow(QLocalSocket *socket, int run);
+    void send(QLocalSocket *socket, const QJsonObject &message);
+
+    QLocalServer *m_server;
+    RequestHandler m_handler;
+    QMap<int, RunRecord> m_runs;
+};
+
+#endif // INSTANCESERVER_H
@@ -0,0 +1,274 @@
+#include "IoEngine.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace {
+
+const int READ_BUFFER_SIZE = 256 * 1024;
+const int MAX_EVENTS = 256;
+// Per stream and wakeup, so one chatty child cannot starve the others
+const int READS_PER_WAKEUP = 4;
+// When closing, a grandchild may still be writing: take what is there and stop
+const int READS_ON_CLOSE = 64;
+// Not yet taken by the GUI; past this the children wait on their full pipes
+const qint64 MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+// The eventfd is 0; streams carry their id and fd so no lookup is needed per event
+quint64 eventKey(quint64 id, int fd)
+{
+    return (id << 32) | static_cast<quint32>(fd);
+}
+
+}
+
+IoEngine *IoEngine::instance()
+{
+    static IoEngine *engine = new IoEngine(QCoreApplication::instance());
+    return engine;
+}
+
+IoEngine::IoEngine(QObject *parent)
+    : QObject(parent)
+    , m_buffer(READ_BUFFER_SIZE, Qt::Uninitialized)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_epoll < 0 || m_wakeup < 0) {
+        qWarning() << "I/O engine unavailable:" << strerror(errno);
+        return;
+    }
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = 0;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+
+    m_thread = QThread::create([this]() { loop(); });
+    m_thread->setObjectName("quish-io");
+    m_thread->start();
+}
+
+IoEngine::~IoEngine()
+{
+    if (m_thread) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_quit = true;
+        }
+        m_delivered.wakeAll();
+        wake();
+        m_thread->wait();
+        delete m_thread;
+    }
+    for (int fd : m_fds) {
+        ::close(fd);
+    }
+    if (m_wakeup >= 0) {
+        ::close(m_wakeup);
+    }
+    if (m_epoll >= 0) {
+        ::close(m_epoll);
+    }
+}
+
+quint64 IoEngine::add(int fd, DataHandler onData, ClosedHandler onClosed)
+{
+    quint64 id = m_nextId++;
+    m_handlers.insert(id, Handlers { onData, onClosed });
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = eventKey(id, fd);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_fds.insert(id, fd);
+    }
+    if (!m_thread || epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+        // Still reported as closed, from the event loop like any other stream
+        QMutexLocker locker(&m_mutex);
+        m_fds.remove(id);
+        ::close(fd);
+        locker.unlock();
+        queue(id, nullptr, 0, true);
+    }
+    return id;
+}
+
+void IoEngine::close(quint64 id)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_fds.contains(id)) {
+            return;
+        }
+        m_closeRequests.append(id);
+    }
+    wake();
+}
+
+void IoEngine::remove(quint64 id)
+{
+    m_handlers.remove(id);
+    close(id);
+}
+
+void IoEngine::wake()
+{
+    uint64_t one = 1;
+    while (::write(m_wakeup, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+// Engine thread: owns the descriptors once they are added, until they are closed
+void IoEngine::loop()
+{
+    struct epoll_event events[MAX_EVENTS];
+    for (;;) {
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pendingBytes > MAX_PENDING_BYTES && !m_quit) {
+                m_delivered.wait(&m_mutex, 100);
+            }
+        }
+        int count = epoll_wait(m_epoll, events, MAX_EVENTS, -1);
+        if (count < 0 && errno != EINTR) {
+            qWarning() << "I/O engine stopped:" << strerror(errno);
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            quint64 key = events[i].data.u64;
+            if (key == 0) {
+                uint64_t value;
+                while (::read(m_wakeup, &value, sizeof(value)) < 0 && errno == EINTR) {
+                }
+                continue;
+            }
+            drain(key >> 32, static_cast<int>(key & 0xffffffff), READS_PER_WAKEUP);
+        }
+
+        // Handled after the events, so none of them refers to a descriptor closed here
+        QVector<quint64> requests;
+        bool quit;
+        {
+            QMutexLocker locker(&m_mutex);
+            requests.swap(m_closeRequests);
+            quit = m_quit;
+        }
+        if (quit) {
+            return;
+        }
+        for (quint64 id : requests) {
+            int fd;
+            {
+                QMutexLocker locker(&m_mutex);
+                fd = m_fds.value(id, -1);
+            }
+            if (fd >= 0 && drain(id, fd, READS_ON_CLOSE)) {
+                finish(id, fd);
+            }
+        }
+    }
+}
+
+// False once the stream is finished: EOF or a read error
+bool IoEngine::drain(quint64 id, int fd, int maxReads)
+{
+    for (int reads = 0; reads < maxReads; ++reads) {
+        ssize_t count = ::read(fd, m_buffer.data(), m_buffer.size());
+        if (count > 0) {
+            queue(id, m_buffer.constData(), count, false);
+            // A short read emptied the pipe, no need for another call to see EAGAIN
+            if (count < m_buffer.size()) {
+                return true;
+            }
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0 && errno == EAGAIN) {
+            return true;
+        }
+        finish(id, fd);
+        return false;
+    }
+    return true;
+}
+
+void IoEngine::finish(quint64 id, int fd)
+{
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_fds.remove(id);
+        ::close(fd);
+    }
+    queue(id, nullptr, 0, true);
+}
+
+// Data of the same stream is appended to its pending delivery, so the GUI gets
+// one call per stream for everything read since it last looked
+void IoEngine::queue(quint64 id, const char *data, qint64 size, bool closed)
+{
+    QMutexLocker locker(&m_mutex);
+    int index = m_pendingIndex.value(id, -1);
+    if (index < 0) {
+        index = m_pending.size();
+        m_pending.append(Delivery { id, QByteArray(), false });
+        m_pendingIndex.insert(id, index);
+    }
+    Delivery &delivery = m_pending[index];
+    if (size > 0) {
+        delivery.data.append(data, size);
+        m_pendingBytes += size;
+    }
+    if (closed) {
+        delivery.closed = true;
+        m_pendingIndex.remove(id);
+    }
+    if (!m_deliveryQueued) {
+        m_deliveryQueued = true;
+        QMetaObject::invokeMethod(this, [this]() { deliver(); }, Qt::QueuedConnection);
+    }
+}
+
+void IoEngine::deliver()
+{
+    QVector<Delivery> deliveries;
+    {
+        QMutexLocker locker(&m_mutex);
+        deliveries.swap(m_pending);
+        m_pendingIndex.clear();
+        m_deliveryQueued = false;
+        m_pendingBytes = 0;
+    }
+    m_delivered.wakeAll();
+    for (const Delivery &delivery : deliveries) {
+        // Handlers may add or remove streams, hence the lookups and copies
+        if (!delivery.data.isEmpty() && m_handlers.contains(delivery.id)) {
+            DataHandler onData = m_handlers.value(delivery.id).onData;
+            if (onData) {
+                onData(delivery.data);
+            }
+        }
+        if (delivery.closed && m_handlers.contains(delivery.id)) {
+            ClosedHandler onClosed = m_handlers.take(delivery.id).onClosed;
+            if (onClosed) {
+                onClosed();
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <functional>
+
+class QThread;
+
+// One thread reads the output pipes of every pooled job through a single
+// epoll set, instead of a QProcess with its own notifiers and buffers per
+// child, all serviced by the GUI loop. Whatever arrived since the last
+// delivery is handed to the GUI thread in one batch per stream.
+class IoEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    using DataHandler = std::function<void(const QByteArray &data)>;
+    using ClosedHandler = std::function<void()>;
+
+    // Created on first use; must be the GUI thread, where the handlers run
+    static IoEngine *instance();
+    ~IoEngine();
+
+    // Takes the read end of a pipe; onClosed runs once, after the last data,
+    // when the writers are gone or close() was asked for
+    quint64 add(int fd, DataHandler onData, ClosedHandler onClosed);
+    // Reads what is already in the pipe, then closes it, even if a
+    // grandchild still holds the write end
+    void close(quint64 id);
+    // Closes it without any further handler call
+    void remove(quint64 id);
+
+    int streamCount() const { return m_handlers.size(); }
+
+private:
+    struct Handlers {
+        DataHandler onData;
+        ClosedHandler onClosed;
+    };
+    struct Delivery {
+        quint64 id;
+        QByteArray data;
+        bool closed;
+    };
+
+    explicit IoEngine(QObject *parent = nullptr);
+    void loop();
+    void wake();
+    bool drain(quint64 id, int fd, int maxReads);
+    void finish(quint64 id, int fd);
+    void queue(quint64 id, const char *data, qint64 size, bool closed);
+    void deliver();
+
+    int m_epoll = -1;
+    int m_wakeup = -1;
+    QThread *m_thread = nullptr;
+    QByteArray m_buffer;                    // the engine thread's, shared by all streams
+    bool m_quit = false;                    // under m_mutex
+
+    // GUI thread only
+    QHash<quint64, Handlers> m_handlers;
+    quint64 m_nextId = 1;
+
+    QMutex m_mutex;
+    QHash<quint64, int> m_fds;              // open streams, by id
+    QVector<quint64> m_closeRequests;
+    QVector<Delivery> m_pending;
+    QHash<quint64, int> m_pendingIndex;     // last open delivery of a stream in m_pending
+    qint64 m_pendingBytes = 0;
+    QWaitCondition m_delivered;
+    bool m_deliveryQueued = false;
+};
+
+#endif // IOENGINE_H
@@ -0,0 +1,544 @@
+#include "Launcher.h"
+
+#include <QSocketNotifier>
+#include <QRegularExpression>
+#include <QProcess>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <map>
+#include <vector>
+
+namespace {
+
+enum MessageType : quint32 {
+    LaunchRequest = 1,
+    SignalRequest = 2,
+    StartedReply = 3,
+    ExitedReply = 4
+};
+
+struct MessageHeader {
+    quint32 type;
+    quint32 id;
+};
+
+// Followed by the working directory and the arguments, each NUL-terminated
+struct LaunchMessage {
+    MessageHeader header;
+    quint32 argumentCount;
+};
+
+struct SignalMessage {
+    MessageHeader header;
+    qint32 signal;
+};
+
+// Carries the read end of the output pipe as SCM_RIGHTS ancillary data
+struct StartedMessage {
+    MessageHeader header;
+    qint32 pid;
+    qint32 error;
+};
+
+struct ExitedMessage {
+    MessageHeader header;
+    qint32 status;
+    struct rusage usage;
+};
+
+const size_t MAX_REQUEST_SIZE = 512 * 1024;
+
+bool sendWithFd(int socket, const void *data, size_t size, int fd)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<void*>(data);
+    iov.iov_len = size;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (fd >= 0) {
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(size);
+}
+
+ssize_t receiveWithFd(int socket, void *data, size_t size, int *fd)
+{
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = size;
+
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+    do {
+        received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    } while (received < 0 && errno == EINTR);
+
+    *fd = -1;
+    if (received > 0) {
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+            }
+        }
+    }
+    return received;
+}
+
+void startChild(int socket, const std::vector<char> &request, const sigset_t &originalMask,
+                std::map<pid_t, quint32> &running)
+{
+    LaunchMessage launch;
+    memcpy(&launch, request.data(), sizeof(launch));
+
+    StartedMessage reply;
+    reply.header.type = StartedReply;
+    reply.header.id = launch.header.id;
+    reply.pid = -1;
+    reply.error = 0;
+
+    // Split the payload into the working directory and argv
+    std::vector<char *> strings;
+    char *cursor = const_cast<char *>(request.data()) + sizeof(launch);
+    char *end = const_cast<char *>(request.data()) + request.size();
+    while (cursor < end && strings.size() < launch.argumentCount + 1) {
+        char *terminator = static_cast<char *>(memchr(cursor, '\0', end - cursor));
+        if (!terminator) {
+            break;
+        }
+        strings.push_back(cursor);
+        cursor = terminator + 1;
+    }
+    if (strings.size() != launch.argumentCount + 1 || launch.argumentCount == 0) {
+        reply.error = EINVAL;
+        sendWithFd(socket, &reply, sizeof(reply), -1);
+        return;
+    }
+    const char *workingDirectory = strings[0];
+    std::vector<char *> argv(strings.begin() + 1, strings.end());
+    argv.push_back(nullptr);
+
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        reply.error = errno;
+        sendWithFd(socket, &reply, sizeof(reply), -1);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Its own process group, so Quish can stop everything it starts
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, &originalMask, nullptr);
+        signal(SIGPIPE, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        int devNull = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (devNull >= 0) {
+            dup2(devNull, STDIN_FILENO);
+        }
+        dup2(pipeFds[1], STDOUT_FILENO);
+        dup2(pipeFds[1], STDERR_FILENO);
+        if (workingDirectory[0] != '\0' && chdir(workingDirectory) != 0) {
+            dprintf(STDERR_FILENO, "%s: %s\n", workingDirectory, strerror(errno));
+            _exit(127);
+        }
+        execvp(argv[0], argv.data());
+        dprintf(STDERR_FILENO, "%s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+
+    close(pipeFds[1]);
+    if (pid > 0) {
+        // Also from this side: signals may be sent before the child gets to it
+        setpgid(pid, pid);
+    }
+    if (pid < 0) {
+        reply.error = errno;
+        close(pipeFds[0]);
+        sendWithFd(socket, &reply, sizeof(reply), -1);
+        return;
+    }
+
+    running[pid] = launch.header.id;
+    reply.pid = pid;
+    sendWithFd(socket, &reply, sizeof(reply), pipeFds[0]);
+    close(pipeFds[0]);
+}
+
+void reapChildren(int socket, std::map<pid_t, quint32> &running)
+{
+    for (;;) {
+        int status = 0;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+        if (pid <= 0) {
+            break;
+        }
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        ExitedMessage reply;
+        reply.header.type = ExitedReply;
+        reply.header.id = it->second;
+        reply.status = status;
+        reply.usage = usage;
+        running.erase(it);
+        sendWithFd(socket, &reply, sizeof(reply), -1);
+    }
+}
+
+[[noreturn]] void serve(int socket)
+{
+    prctl(PR_SET_NAME, "quish-launcher", 0, 0, 0);
+
+    sigset_t childMask, originalMask;
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childMask, &originalMask);
+    int signalFd = signalfd(-1, &childMask, SFD_CLOEXEC | SFD_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, SIG_IGN);
+
+    std::map<pid_t, quint32> running;
+    std::vector<char> buffer(MAX_REQUEST_SIZE);
+
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd = socket;
+        fds[0].events = POLLIN;
+        fds[1].fd = signalFd;
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {
+            }
+            reapChildren(socket, running);
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t size = recv(socket, buffer.data(), buffer.size(), 0);
+            if (size <= 0) {
+                if (size < 0 && errno == EINTR) {
+                    continue;
+                }
+                break; // Quish is gone
+            }
+
+            MessageHeader header;
+            if (static_cast<size_t>(size) < sizeof(header)) {
+                continue;
+            }
+            memcpy(&header, buffer.data(), sizeof(header));
+            if (header.type == LaunchRequest && static_cast<size_t>(size) >= sizeof(LaunchMessage)) {
+                startChild(socket, std::vector<char>(buffer.begin(), buffer.begin() + size), originalMask, running);
+            } else if (header.type == SignalRequest && static_cast<size_t>(size) >= sizeof(SignalMessage)) {
+                SignalMessage request;
+                memcpy(&request, buffer.data(), sizeof(request));
+                for (const auto &child : running) {
+                    if (child.second == request.header.id) {
+                        ::kill(-child.first, request.signal);
+                    }
+                }
+            }
+        }
+    }
+
+    for (const auto &child : running) {
+        ::kill(-child.first, SIGTERM);
+    }
+    _exit(0);
+}
+
+} // namespace
+
+int Launcher::s_socket = -1;
+
+void Launcher::preFork()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) {
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        serve(fds[1]);
+    }
+
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        return;
+    }
+    s_socket = fds[0];
+}
+
+Launcher *Launcher::instance()
+{
+    static Launcher *launcher = new Launcher(s_socket);
+    return launcher;
+}
+
+Launcher::Launcher(int socket, QObject *parent)
+    : QObject(parent)
+    , m_socket(socket)
+{
+    if (m_socket >= 0) {
+        m_notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        connect(m_notifier, QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated),
+                this, &Launcher::readReplies);
+#else
+        connect(m_notifier, &QSocketNotifier::activated, this, &Launcher::readReplies);
+#endif
+    }
+}
+
+QStringList Launcher::argumentsFor(const QString &commandLine)
+{
+    static const QRegularExpression shellSyntaxRe("[|&;<>()$`\\\\'*?\\[\\]#~=%{}\\n]");
+    if (!commandLine.contains(shellSyntaxRe)) {
+        QStringList arguments = QProcess::splitCommand(commandLine);
+        if (!arguments.isEmpty()) {
+            return arguments;
+        }
+    }
+    return QStringList() << "/bin/sh" << "-c" << commandLine;
+}
+
+LaunchedRun *Launcher::launch(const QStringList &arguments, const QString &workingDirectory, QObject *parent)
+{
+    if (m_socket < 0 || arguments.isEmpty()) {
+        return nullptr;
+    }
+
+    LaunchMessage header;
+    header.header.type = LaunchRequest;
+    header.header.id = m_nextId++;
+    header.argumentCount = arguments.size();
+
+    QByteArray request(reinterpret_cast<const char *>(&header), sizeof(header));
+    request.append(workingDirectory.toLocal8Bit());
+    request.append('\0');
+    for (const QString &argument : arguments) {
+        request.append(argument.toLocal8Bit());
+        request.append('\0');
+    }
+    if (static_cast<size_t>(request.size()) > MAX_REQUEST_SIZE || !sendWithFd(m_socket, request.constData(), request.size(), -1)) {
+        if (errno == EPIPE || errno == ECONNRESET) {
+            disconnectLauncher();
+        }
+        return nullptr;
+    }
+
+    LaunchedRun *run = new LaunchedRun(header.header.id, parent);
+    m_runs.insert(header.header.id, run);
+    return run;
+}
+
+bool Launcher::sendSignal(quint32 id, int signal)
+{
+    if (m_socket < 0) {
+        return false;
+    }
+    SignalMessage request;
+    request.header.type = SignalRequest;
+    request.header.id = id;
+    request.signal = signal;
+    return sendWithFd(m_socket, &request, sizeof(request), -1);
+}
+
+void Launcher::readReplies()
+{
+    for (;;) {
+        union {
+            StartedMessage started;
+            ExitedMessage exited;
+            MessageHeader header;
+        } reply;
+        int fd = -1;
+        ssize_t size = receiveWithFd(m_socket, &reply, sizeof(reply), &fd);
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (size <= 0) {
+            disconnectLauncher();
+            return;
+        }
+
+        LaunchedRun *run = m_runs.value(reply.header.id);
+        if (reply.header.type == StartedReply && static_cast<size_t>(size) >= sizeof(StartedMessage)) {
+            if (!run) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                continue;
+            }
+            if (reply.started.pid < 0) {
+                m_runs.remove(reply.header.id);
+                emit run->failed(QString::fromLocal8Bit(strerror(reply.started.error)));
+            } else {
+                run->onStarted(reply.started.pid, fd);
+            }
+        } else if (reply.header.type == ExitedReply && static_cast<size_t>(size) >= sizeof(ExitedMessage)) {
+            m_runs.remove(reply.header.id);
+            if (run) {
+                run->onExited(reply.exited.status, reply.exited.usage);
+            }
+        } else if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+void Launcher::disconnectLauncher()
+{
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+    }
+    if (m_socket >= 0) {
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    const QList<LaunchedRun*> runs = m_runs.values();
+    m_runs.clear();
+    for (LaunchedRun *run : runs) {
+        emit run->failed(tr("The launcher process exited."));
+    }
+}
+
+LaunchedRun::LaunchedRun(quint32 id, QObject *parent)
+    : QObject(parent)
+    , m_id(id)
+{
+    memset(&m_usage, 0, sizeof(m_usage));
+}
+
+LaunchedRun::~LaunchedRun()
+{
+    Launcher::instance()->m_runs.remove(m_id);
+    if (m_outputFd >= 0) {
+        ::close(m_outputFd);
+    }
+}
+
+void LaunchedRun::terminate()
+{
+    Launcher::instance()->sendSignal(m_id, SIGTERM);
+}
+
+void LaunchedRun::kill()
+{
+    Launcher::instance()->sendSignal(m_id, SIGKILL);
+}
+
+void LaunchedRun::onStarted(pid_t pid, int outputFd)
+{
+    m_pid = pid;
+    m_outputFd = outputFd;
+    if (m_outputFd >= 0) {
+        fcntl(m_outputFd, F_SETFL, fcntl(m_outputFd, F_GETFL) | O_NONBLOCK);
+        m_notifier = new QSocketNotifier(m_outputFd, QSocketNotifier::Read, this);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+        connect(m_notifier, QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated),
+                this, &LaunchedRun::readOutput);
+#else
+        connect(m_notifier, &QSocketNotifier::activated, this, &LaunchedRun::readOutput);
+#endif
+    }
+    emit started();
+}
+
+void LaunchedRun::onExited(int status, const struct rusage &usage)
+{
+    m_exited = true;
+    m_usage = usage;
+    readOutput();
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+    }
+    if (m_outputFd >= 0) {
+        ::close(m_outputFd);
+        m_outputFd = -1;
+    }
+
+    int termSignal = WIFSIGNALED(status) ? WTERMSIG(status) : 0;
+    int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + termSignal;
+    emit finished(exitCode, termSignal);
+}
+
+void LaunchedRun::readOutput()
+{
+    if (m_outputFd < 0) {
+        return;
+    }
+
+    char buffer[65536];
+    QByteArray data;
+    for (;;) {
+        ssize_t count = ::read(m_outputFd, buffer, sizeof(buffer));
+        if (count > 0) {
+            data.append(buffer, count);
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0 && m_notifier) {
+            m_notifier->setEnabled(false);
+        }
+        break;
+    }
+    if (!data.isEmpty()) {
+        emit output(data);
+    }
+}
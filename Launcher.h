@@ -0,0 +1,85 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QMap>
+#include <QStringList>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+class QSocketNotifier;
+class LaunchedRun;
+
+// Small helper process forked from main() before QApplication exists. It
+// forks/execs the commands from its small address space, hands the output
+// pipe back over a Unix socket (SCM_RIGHTS) and reports the wait4() status.
+class Launcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Must be called from main() while the process is still single-threaded
+    static void preFork();
+    static Launcher *instance();
+
+    bool isAvailable() const { return m_socket >= 0; }
+    LaunchedRun *launch(const QStringList &arguments, const QString &workingDirectory, QObject *parent = nullptr);
+    bool sendSignal(quint32 id, int signal);
+
+    // Argument vector to exec for a shell command line, skipping /bin/sh when
+    // the line has nothing only a shell could interpret
+    static QStringList argumentsFor(const QString &commandLine);
+
+private:
+    explicit Launcher(int socket, QObject *parent = nullptr);
+    void readReplies();
+    void disconnectLauncher();
+
+    static int s_socket;
+    int m_socket;
+    quint32 m_nextId = 1;
+    QSocketNotifier *m_notifier = nullptr;
+    QMap<quint32, LaunchedRun*> m_runs;
+
+    friend class LaunchedRun;
+};
+
+class LaunchedRun : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~LaunchedRun();
+
+    pid_t pid() const { return m_pid; }
+    const struct rusage &resourceUsage() const { return m_usage; }
+    void terminate();
+    void kill();
+
+signals:
+    void started();
+    void output(const QByteArray &data);
+    // termSignal is the signal that killed the command, 0 when it exited;
+    // exitCode is then 128 + the signal, as a shell would report it
+    void finished(int exitCode, int termSignal);
+    void failed(const QString &errorMessage);
+
+private:
+    LaunchedRun(quint32 id, QObject *parent);
+    void onStarted(pid_t pid, int outputFd);
+    void onExited(int status, const struct rusage &usage);
+    void readOutput();
+
+    quint32 m_id;
+    pid_t m_pid = -1;
+    int m_outputFd = -1;
+    bool m_exited = false;
+    QSocketNotifier *m_notifier = nullptr;
+    struct rusage m_usage;
+
+    friend class Launcher;
+};
+
+#endif // LAUNCHER_H
@@ -1,6 +1,29 @@
 #include "MainWindow.h"
 #include "ui_MainWindow.h"
 #include "SaveCommandDialog.h"
+#include "SweepDialog.h"
+#include "BenchmarkDialog.h"
+#include "ProcessPool.h"
+#include "QuishProcess.h"
+#include "Launcher.h"
+#include "ResourceMonitor.h"
+#include "CpuCounters.h"
+#include "ResultCache.h"
+#include "CommandLine.h"
+#include "InstanceServer.h"
+#include "WatchController.h"
+#include "WorkflowDialog.h"
+#include "PipelineDialog.h"
+#include "Scheduling.h"
+#include "GroupStopper.h"
+#include "StdinFeeder.h"
+#include "RunHistory.h"
+#include "HistoryView.h"
+#include "ConfigCache.h"
+#include "ConfigFragments.h"
+#include "CommandPalette.h"
+#include "ConfigJournal.h"
+#include "ArgumentForm.h"
 
 #include <QFileDialog>
 #include <QJsonDocument>
@@ -29,21 +52,38 @@
 #include <QClipboard>
 #include <QIntValidator>
 #include <QTimer>
+#include <QTime>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QLocale>
+#include <QSharedPointer>
+#include <QSignalBlocker>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
 #include "settings.h"
 #include "JsonHighlighter.h"
 
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , m_trayIcon(nullptr)
     , m_sudoCheckBox(nullptr)
+    , m_cpuCountersCheckBox(nullptr)
+    , m_bypassCacheCheckBox(nullptr)
     , m_clearOutputCheckBox(nullptr)
     , m_workingDirectoryLabel(nullptr)
     , m_workingDirectoryLineEdit(nullptr)
+    , m_schedulingLineEdit(nullptr)
+    , m_miscLineEdit(nullptr)
     , m_themeComboBox(nullptr)
     , m_lblFileSize(nullptr)
     , m_lblExitCode(nullptr)
     , m_lblElapsedTime(nullptr)
+    , m_lblResources(nullptr)
 {
     ui->setupUi(this);
 
@@ -55,6 +95,12 @@ MainWindow::MainWindow(QWidget *parent)
     m_txtHelp->setReadOnly(true);
     helpLayout->addWidget(m_txtHelp);
 
+    // Before the saved tab is restored, so it may be the History tab
+    m_runHistory = new RunHistory(this);
+    HistoryView *historyView = new HistoryView(m_runHistory);
+    ui->tabWidget->addTab(historyView, QIcon(":/icons/Document Spreadsheet.png"), tr("History"));
+    connect(historyView, &HistoryView::rerunRequested, this, &MainWindow::rerunFromHistory);
+
     QFont monospaceFont("Monospace");
     monospaceFont.setStyleHint(QFont::Monospace);
     ui->txtOutput->setFont(monospaceFont);
@@ -69,11 +115,18 @@ MainWindow::MainWindow(QWidget *parent)
     m_lblExitCode->setStyleSheet("border: 1px solid gray; padding: 1px;");
     m_lblElapsedTime = new QLabel(tr("Elapsed: N/A"), this);
     m_lblElapsedTime->setStyleSheet("border: 1px solid gray; padding: 1px;");
+    m_lblResources = new QLabel(tr("CPU: N/A"), this);
+    m_lblResources->setStyleSheet("border: 1px solid gray; padding: 1px;");
+    m_resourceMonitor = new ResourceMonitor(this);
+    connect(m_resourceMonitor, &ResourceMonitor::sampled, this, [this](const ResourceSample &sample) {
+        m_lblResources->setText(ResourceMonitor::formatSample(sample));
+    });
     m_lblCommandStatusIcon = new QLabel(this);
     m_lblCommandStatusIcon->setPixmap(QPixmap(":/icons/led_gray.png").scaledToHeight(16, Qt::SmoothTransformation));
     m_lblCommandStatusIcon->setStyleSheet("background-color: transparent;");
 
     if (ui->statusbar) {
+        ui->statusbar->addPermanentWidget(m_lblResources);
         ui->statusbar->addPermanentWidget(m_lblExitCode);
         ui->statusbar->addPermanentWidget(m_lblElapsedTime);
         ui->statusbar->addPermanentWidget(m_lblCommandStatusIcon);
@@ -120,6 +173,22 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_saveAction, &QAction::triggered, this, &MainWindow::on_btnSaveFile_clicked);
     this->addAction(m_saveAction);
 
+    m_paletteAction = new QAction(this);
+    m_paletteAction->setShortcut(QKeySequence("Ctrl+P"));
+    connect(m_paletteAction, &QAction::triggered, this, [this]() {
+        if (!m_commandPalette) {
+            m_commandPalette = new CommandPalette(&m_fuzzyIndex, m_runHistory, this);
+            connect(m_commandPalette, &CommandPalette::commandSelected, this, [this](const QString &target) {
+                QString errorMessage;
+                if (!selectCommand(target, &errorMessage)) {
+                    setStatusBarMessage(errorMessage);
+                }
+            });
+        }
+        m_commandPalette->open();
+    });
+    this->addAction(m_paletteAction);
+
     m_helpAction = new QAction(this);
     m_helpAction->setShortcut(QKeySequence(Qt::Key_F1));
     connect(m_helpAction, &QAction::triggered, this, [this]() {
@@ -140,11 +209,70 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainWindow::on_tabWidget_currentChanged);
 
     m_process = nullptr;
+    m_batchPool = nullptr;
+    m_launchedRun = nullptr;
     m_btnBreak = findChild<QPushButton*>(tr("btnBreak"));
     if (m_btnBreak) {
         m_btnBreak->setEnabled(false);
     }
 
+    m_btnSweep = new QPushButton(QIcon(":/icons/Stats.png"), QString(), this);
+    m_btnSweep->setToolTip(tr("Parameter Sweep"));
+    ui->horizontalLayout->insertWidget(2, m_btnSweep);
+    connect(m_btnSweep, &QPushButton::clicked, this, &MainWindow::runSweep);
+
+    m_btnBenchmark = new QPushButton(QIcon(":/icons/Clock.png"), QString(), this);
+    m_btnBenchmark->setToolTip(tr("Benchmark"));
+    ui->horizontalLayout->insertWidget(3, m_btnBenchmark);
+    connect(m_btnBenchmark, &QPushButton::clicked, this, &MainWindow::runBenchmark);
+
+    m_btnWatch = new QPushButton(QIcon(":/icons/Refresh.png"), QString(), this);
+    m_btnWatch->setToolTip(tr("Watch: re-run on file changes or at an interval"));
+    m_btnWatch->setCheckable(true);
+    ui->horizontalLayout->insertWidget(4, m_btnWatch);
+    connect(m_btnWatch, &QPushButton::toggled, this, &MainWindow::toggleWatch);
+
+    m_btnWorkflows = new QPushButton(QIcon(":/icons/Document Graph.png"), QString(), this);
+    m_btnWorkflows->setToolTip(tr("Workflows"));
+    ui->horizontalLayout->insertWidget(5, m_btnWorkflows);
+    connect(m_btnWorkflows, &QPushButton::clicked, this, &MainWindow::runWorkflows);
+
+    m_btnPipelines = new QPushButton(QIcon(":/icons/Link.png"), QString(), this);
+    m_btnPipelines->setToolTip(tr("Pipelines"));
+    ui->horizontalLayout->insertWidget(6, m_btnPipelines);
+    connect(m_btnPipelines, &QPushButton::clicked, this, &MainWindow::runPipelines);
+    m_watchController = new WatchController(this);
+    connect(m_watchController, &WatchController::changed, this, [this](const QString &reason) {
+        // A newer trigger makes the running iteration pointless
+        if (m_process || m_batchPool || m_launchedRun) {
+            m_watchPendingReason = reason;
+            on_btnBreak_clicked();
+        } else {
+            runWatchIteration(reason);
+        }
+    });
+    m_groupStopper = new GroupStopper(this);
+    connect(m_groupStopper, &GroupStopper::signalSent, this, [this](int signal) {
+        setStatusBarMessage(tr("Sent %1 to the process group; press Break again to escalate now.")
+                                .arg(GroupStopper::signalName(signal)));
+    });
+    m_runTimeout = new QTimer(this);
+    m_runTimeout->setSingleShot(true);
+    connect(m_runTimeout, &QTimer::timeout, this, [this]() {
+        QString reason = tr("timed out after %1 s").arg(m_currentCommand.timeout);
+        // A cut-short output is not the command's result
+        m_cacheKey.clear();
+        m_cacheOutput.clear();
+        appendDiagnostic(QString("\n%1, stopping it\n").arg(reason));
+        stopRun(reason);
+    });
+
+    connect(m_watchController, &WatchController::tick, this, [this]() {
+        if (!m_process && !m_batchPool && !m_launchedRun) {
+            runWatchIteration(tr("interval"));
+        }
+    });
+
     // Settings Tab setup
     QWidget *settingsContainerWidget = new QWidget(ui->tabSettings);
     QFormLayout *settingsFormLayout = new QFormLayout(settingsContainerWidget);
@@ -192,10 +320,33 @@ MainWindow::MainWindow(QWidget *parent)
         quishDir.mkpath(".");
     }
 
-    // Load default config file from .Quish folder
+    // Another tool or a git pull rewriting the config is picked up without a reopen
+    m_configWatcher = new QFileSystemWatcher(this);
+    m_configReloadTimer = new QTimer(this);
+    m_configReloadTimer->setSingleShot(true);
+    m_configReloadTimer->setInterval(300);
+    connect(m_configWatcher, &QFileSystemWatcher::fileChanged, m_configReloadTimer, QOverload<>::of(&QTimer::start));
+    connect(m_configWatcher, &QFileSystemWatcher::directoryChanged, m_configReloadTimer, QOverload<>::of(&QTimer::start));
+    connect(m_configReloadTimer, &QTimer::timeout, this, [this]() {
+        watchConfigFile(m_currentConfigFilePath);
+        if (m_configLoading || m_currentConfigFilePath.isEmpty()
+            || ConfigFragments::stamp(QStringList(m_currentConfigFilePath) + ConfigFragments::files()) == m_configStamp) {
+            return;
+        }
+        loadConfigFileInBackground(m_currentConfigFilePath, true);
+    });
+
+    // Preset saves and imports land in the journal first, the file catches up
+    m_configJournal = new ConfigJournal(this);
+    connect(m_configJournal, &ConfigJournal::compactionFailed, this, [this](const QString &errorMessage) {
+        setStatusBarMessage(tr("Saved presets stay in the journal: %1").arg(errorMessage));
+    });
+
+    // Load default config file from .Quish folder, with the conf.d fragments;
+    // the window shows while they parse
     QString defaultConfigPath = homePath + "/.Quish/config.json";
-    if (QFile::exists(defaultConfigPath)) {
-        loadConfigFile(defaultConfigPath);
+    if (QFile::exists(defaultConfigPath) || !ConfigFragments::files().isEmpty() || ConfigJournal::exists(defaultConfigPath)) {
+        loadConfigFileInBackground(defaultConfigPath);
     }
 
     // Set version label
@@ -204,9 +355,87 @@ MainWindow::MainWindow(QWidget *parent)
 
     checkForNewVersion();
 
+    // Later invocations and scripts talk to this instance instead of starting their own
+    m_instanceServer = new InstanceServer(this);
+    m_instanceServer->setRequestHandler([this](const QJsonObject &request) {
+        return handleInstanceRequest(request);
+    });
+    QString serverError;
+    if (!m_instanceServer->listen(&serverError)) {
+        qWarning() << "Could not listen on" << InstanceServer::socketName() << ":" << serverError;
+    }
+
     setStatusBarMessage(tr("Application started."));
 }
 
+QJsonObject MainWindow::handleInstanceRequest(const QJsonObject &request)
+{
+    QString type = request["request"].toString();
+    QJsonObject response;
+    response["ok"] = true;
+
+    if (type == "ping") {
+        response["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+        response["version"] = QString(APP_VERSION_STRING);
+    } else if (type == "list") {
+        QJsonObject topics;
+        for (const QString &topic : m_catalog.topics()) {
+            QJsonArray names;
+            for (const CommandSpec &command : m_catalog.commands(topic)) {
+                names.append(command.name);
+            }
+            topics[topic] = names;
+        }
+        response["topics"] = topics;
+    } else if (type == "select" || type == "run") {
+        QString target = request["command"].toString();
+        QString errorMessage;
+        if (!target.isEmpty() && !selectCommand(target, &errorMessage)) {
+            response["ok"] = false;
+            response["error"] = errorMessage;
+        } else if (type == "run") {
+            if (m_process || m_batchPool || m_launchedRun) {
+                response["ok"] = false;
+                response["error"] = tr("A command is already running (run %1).").arg(m_runId);
+                return response;
+            }
+            int previousRun = m_runId;
+            on_btnRun_clicked();
+            if (m_runId == previousRun) {
+                response["ok"] = false;
+                response["error"] = tr("The command could not be started.");
+            } else {
+                response["run"] = m_runId;
+            }
+        }
+    } else if (type == "status") {
+        response["topic"] = ui->cmbTopics->currentText();
+        response["command"] = ui->cmbCommands->currentText();
+        response["commandLine"] = lblCommand ? lblCommand->text() : QString();
+        response["running"] = m_process || m_batchPool || m_launchedRun;
+        response["run"] = m_runId;
+    } else if (type == "raise") {
+        restoreActionTriggered();
+    } else {
+        response["ok"] = false;
+        response["error"] = tr("Unknown request \"%1\"").arg(type);
+    }
+    return response;
+}
+
+bool MainWindow::selectCommand(const QString &target, QString *errorMessage)
+{
+    const CommandSpec *command = m_catalog.find(target);
+    if (command) {
+        const QVector<CommandSpec> &commands = m_catalog.commands(command->topic);
+        ui->cmbTopics->setCurrentText(command->topic);
+        ui->cmbCommands->setCurrentIndex(int(command - commands.constData()));
+        return true;
+    }
+    *errorMessage = tr("No command \"%1\" (expected \"<topic>/<command>\")").arg(target);
+    return false;
+}
+
 void MainWindow::createTrayIcon()
 {
     if (m_trayIcon) return;
@@ -318,61 +547,392 @@ void MainWindow::handleThemeChange(int index)
 
 MainWindow::~MainWindow()
 {
+    // Its result is posted to this window
+    if (m_configLoader) {
+        m_configLoader->wait();
+    }
+    if (m_outputSpool >= 0) {
+        ::close(m_outputSpool);
+    }
     delete ui;
 }
 
-bool MainWindow::loadConfigFile(const QString &filePath)
+// Runs on the loader thread: nothing here may touch the window
+void MainWindow::readConfig(LoadedConfig *config)
 {
-    if (filePath.isEmpty()) {
-        return false;
-    }
+    // Taken first: a file changing while it is read makes the next check reload it
+    QStringList fragments = ConfigFragments::files();
+    config->stamp = ConfigFragments::stamp(QStringList(config->filePath) + fragments);
+    config->fileStamp = ConfigFragments::stamp(QStringList(config->filePath));
+
+    QFile file(config->filePath);
+    if (!file.exists() && (!fragments.isEmpty() || ConfigJournal::exists(config->filePath))) {
+        // Fragments or saved presets only: the file is created by the first save
+        config->root.insert("topics", QJsonObject());
+    } else {
+        if (!file.open(QIODevice::ReadOnly)) {
+            config->errorMessage = tr("Could not open file: %1").arg(config->filePath);
+            return;
+        }
 
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::critical(this, tr("Error"), tr("Could not open file: %1").arg(filePath));
-        return false;
+        // The editor needs the text anyway; the tree comes from the compiled cache
+        // unless the file changed since it was last parsed
+        config->data = file.readAll();
+        if (!ConfigCache::load(config->filePath, &config->root, &config->errorMessage, config->data)) {
+            return;
+        }
+        if (!config->root.value("topics").isObject()) {
+            config->errorMessage = tr("Invalid configuration format: 'topics' object not found in %1.").arg(config->filePath);
+            return;
+        }
     }
 
-    QByteArray data = file.readAll();
-    QJsonDocument doc(QJsonDocument::fromJson(data));
-    if (doc.isNull() || !doc.isObject()) {
-        QMessageBox::critical(this, tr("Error"), tr("Invalid JSON file: %1").arg(filePath));
-        return false;
-    }
+    ConfigJournal::replay(config->filePath, &config->root, &config->warnings, &config->journalRecordId);
+    config->fragments = ConfigFragments::load(&config->warnings);
+    ConfigFragments::apply(&config->root, config->fragments);
+    config->catalog.compile(config->root.value("topics").toObject());
+    config->fuzzyIndex.build(config->catalog);
+    config->ok = true;
+}
 
-    m_rootConfig = doc.object();
-    if (!m_rootConfig.contains("topics") || !m_rootConfig["topics"].isObject()) {
-        QMessageBox::critical(this, tr("Error"), tr("Invalid configuration format: 'topics' object not found in %1.").arg(filePath));
+bool MainWindow::applyConfig(const LoadedConfig &config)
+{
+    ui->cmbTopics->setEnabled(true);
+    ui->cmbCommands->setEnabled(true);
+    if (!config.ok) {
+        if (m_catalog.topics().isEmpty()) {
+            QSignalBlocker blocker(ui->cmbTopics);
+            ui->cmbTopics->clear();
+        }
+        QMessageBox::critical(this, tr("Error"), config.errorMessage);
         return false;
     }
 
+    m_rootConfig = config.root;
+    m_fragmentConfig = config.fragments;
     ui->cmbTopics->clear();
     ui->cmbCommands->clear();
 
-    QJsonObject topics = m_rootConfig["topics"].toObject();
-    ui->cmbTopics->addItems(topics.keys());
+    m_catalog = config.catalog;
+    setFuzzyIndex(config.fuzzyIndex);
+    ui->cmbTopics->addItems(m_catalog.topics());
 
     if (ui->cmbTopics->count() > 0) {
         ui->cmbTopics->setCurrentIndex(0);
         on_cmbTopics_currentIndexChanged(0);
     }
 
-    ui->txtEditFile->setPlainText(QString(data));
-    m_currentConfigFilePath = filePath;
-    ui->lblEditFile->setText(filePath);
+    // Highlighting and folding go over the whole document: only once the Edit tab is shown
+    m_editorData = config.data;
+    m_editorStamp = config.fileStamp;
+    m_editorLoaded = false;
+    m_currentConfigFilePath = config.filePath;
+    m_configJournal->setConfigFile(config.filePath, config.journalRecordId);
+    m_configStamp = config.stamp;
+    watchConfigFile(config.filePath);
+    ui->lblEditFile->setText(config.filePath);
+    if (ui->tabWidget->currentIndex() == 2) {
+        ensureEditorLoaded();
+        scrollToCurrentCommandInEditor();
+    }
+    updateFileSizeLabel();
+
+    QString message = tr("Configuration loaded from %1").arg(config.filePath);
+    if (!config.warnings.isEmpty()) {
+        message += tr("; skipped: %1").arg(config.warnings.join("; "));
+    }
+    setStatusBarMessage(message);
+    return true;
+}
+
+void MainWindow::setFuzzyIndex(const FuzzyIndex &index)
+{
+    m_fuzzyIndex = index;
+    if (m_commandPalette && m_commandPalette->isVisible()) {
+        m_commandPalette->refresh();
+    }
+}
+
+// Edits the entries in place, so the current one keeps its index when it stays
+static void syncComboItems(QComboBox *combo, const QStringList &items)
+{
+    for (int i = 0; i < items.size(); ++i) {
+        if (i < combo->count() && combo->itemText(i) == items.at(i)) {
+            continue;
+        }
+        int found = -1;
+        for (int j = i + 1; j < combo->count(); ++j) {
+            if (combo->itemText(j) == items.at(i)) {
+                found = j;
+                break;
+            }
+        }
+        if (found > 0) {
+            for (int j = found - 1; j >= i; --j) {
+                combo->removeItem(j);
+            }
+        } else {
+            combo->insertItem(i, items.at(i));
+        }
+    }
+    while (combo->count() > items.size()) {
+        combo->removeItem(combo->count() - 1);
+    }
+}
+
+// A new version of the loaded file, applied without starting the form over
+bool MainWindow::updateConfig(const LoadedConfig &config)
+{
+    // Also on failure, so a broken file is not parsed again until it changes
+    m_configStamp = config.stamp;
+    if (!config.ok) {
+        return false;
+    }
+    if (config.filePath != m_currentConfigFilePath) {
+        return applyConfig(config);
+    }
+
+    int changedCommands = 0;
+    QStringList allTopics = m_catalog.topics() + config.catalog.topics();
+    allTopics.removeDuplicates();
+    for (const QString &topic : allTopics) {
+        const QVector<CommandSpec> &before = m_catalog.commands(topic);
+        const QVector<CommandSpec> &after = config.catalog.commands(topic);
+        for (int i = 0; i < qMax(before.size(), after.size()); ++i) {
+            if (i >= before.size() || i >= after.size() || before.at(i).config != after.at(i).config) {
+                ++changedCommands;
+            }
+        }
+    }
+    m_rootConfig = config.root;
+    m_fragmentConfig = config.fragments;
+    m_catalog = config.catalog;
+    setFuzzyIndex(config.fuzzyIndex);
+    m_configJournal->setConfigFile(config.filePath, config.journalRecordId);
+    syncCommandCombos();
+
+    // The editor follows the file unless it holds edits of its own
+    QString message = tr("Configuration reloaded from %1 (%2 commands changed)").arg(config.filePath).arg(changedCommands);
+    if (!config.warnings.isEmpty()) {
+        message += tr("; skipped: %1").arg(config.warnings.join("; "));
+    }
+    if (!m_editorLoaded) {
+        m_editorData = config.data;
+        m_editorStamp = config.fileStamp;
+    } else if (ui->txtEditFile->document()->isModified()) {
+        message += tr("; the editor keeps its unsaved changes");
+    } else {
+        if (ui->txtEditFile->toPlainText() != QString::fromUtf8(config.data)) {
+            m_editorData = config.data;
+            m_editorLoaded = false;
+            if (ui->tabWidget->currentIndex() == 2) {
+                ensureEditorLoaded();
+                scrollToCurrentCommandInEditor();
+            }
+        }
+        m_editorStamp = config.fileStamp;
+    }
     updateFileSizeLabel();
+    setStatusBarMessage(message);
+    return true;
+}
+
+// After the catalog changed: only the combo entries that differ are touched,
+// and the form is only rebuilt when its own command changed
+void MainWindow::syncCommandCombos()
+{
+    QString topic = ui->cmbTopics->currentText();
+    {
+        QSignalBlocker blocker(ui->cmbTopics);
+        syncComboItems(ui->cmbTopics, m_catalog.topics());
+    }
+    int topicIndex = ui->cmbTopics->findText(topic);
+    if (topicIndex < 0) {
+        // The current topic is gone: start over from the first one
+        if (ui->cmbTopics->count() > 0) {
+            {
+                QSignalBlocker blocker(ui->cmbTopics);
+                ui->cmbTopics->setCurrentIndex(0);
+            }
+            on_cmbTopics_currentIndexChanged(0);
+        } else {
+            {
+                QSignalBlocker blocker(ui->cmbCommands);
+                ui->cmbCommands->clear();
+            }
+            clearForm();
+        }
+    } else {
+        {
+            QSignalBlocker blocker(ui->cmbTopics);
+            ui->cmbTopics->setCurrentIndex(topicIndex);
+        }
+        const QVector<CommandSpec> &commands = m_catalog.commands(topic);
+        QStringList names;
+        for (const CommandSpec &command : commands) {
+            names.append(command.name);
+        }
+        QString name = ui->cmbCommands->currentText();
+        {
+            QSignalBlocker blocker(ui->cmbCommands);
+            syncComboItems(ui->cmbCommands, names);
+        }
+        int index = names.indexOf(name);
+        if (index < 0) {
+            if (!names.isEmpty()) {
+                {
+                    QSignalBlocker blocker(ui->cmbCommands);
+                    ui->cmbCommands->setCurrentIndex(0);
+                }
+                on_cmbCommands_currentIndexChanged(0);
+            } else {
+                clearForm();
+            }
+        } else {
+            {
+                QSignalBlocker blocker(ui->cmbCommands);
+                ui->cmbCommands->setCurrentIndex(index);
+            }
+            if (commands.at(index).config == m_currentCommand.config) {
+                // Same command: the form, and what was typed into it, stay
+                m_currentCommand = commands.at(index);
+            } else {
+                on_cmbCommands_currentIndexChanged(index);
+            }
+        }
+    }
+}
+
+// Editors and git replace the file rather than write it: a replaced file drops
+// out of the watch, and its folder is watched until the file is back
+void MainWindow::watchConfigFile(const QString &filePath)
+{
+    QStringList wanted;
+    if (!filePath.isEmpty()) {
+        wanted.append(QFile::exists(filePath) ? filePath : QFileInfo(filePath).absolutePath());
+    }
+    // Folders for fragments being added or removed, files for their edits
+    for (const QString &directory : ConfigFragments::directories()) {
+        if (QFileInfo(directory).isDir()) {
+            wanted.append(directory);
+        }
+    }
+    wanted += ConfigFragments::files();
+    const QStringList watched = m_configWatcher->files() + m_configWatcher->directories();
+    for (const QString &path : watched) {
+        if (!wanted.contains(path)) {
+            m_configWatcher->removePath(path);
+        }
+    }
+    for (const QString &path : wanted) {
+        if (!watched.contains(path)) {
+            m_configWatcher->addPath(path);
+        }
+    }
+}
+
+bool MainWindow::loadConfigFile(const QString &filePath)
+{
+    if (filePath.isEmpty()) {
+        return false;
+    }
+    // Whatever a background load still has to say is out of date now
+    if (m_configLoader) {
+        m_configLoader->wait();
+    }
+    ++m_configLoad;
+    m_configLoading = false;
+
+    LoadedConfig config;
+    config.filePath = filePath;
+    readConfig(&config);
+    return applyConfig(config);
+}
 
-    setStatusBarMessage(tr("Configuration loaded from %1").arg(filePath));
+// Re-reads the current file after Quish wrote it, keeping the selection
+bool MainWindow::reloadConfigFile()
+{
+    if (m_configLoading) {
+        return loadConfigFile(m_currentConfigFilePath);
+    }
+    if (m_configLoader) {
+        m_configLoader->wait();
+    }
+    ++m_configLoad;
+
+    LoadedConfig config;
+    config.filePath = m_currentConfigFilePath;
+    readConfig(&config);
+    if (!updateConfig(config)) {
+        QMessageBox::critical(this, tr("Error"), config.errorMessage);
+        return false;
+    }
     return true;
 }
 
+void MainWindow::loadConfigFileInBackground(const QString &filePath, bool incremental)
+{
+    if (m_configLoader) {
+        m_configLoader->wait();
+    }
+    int load = ++m_configLoad;
+
+    // The current commands stay usable until the new ones are ready
+    if (!incremental) {
+        m_configLoading = true;
+        if (ui->cmbTopics->count() == 0) {
+            QSignalBlocker blocker(ui->cmbTopics);
+            ui->cmbTopics->addItem(tr("Loading..."));
+        }
+        ui->cmbTopics->setEnabled(false);
+        ui->cmbCommands->setEnabled(false);
+        setStatusBarMessage(tr("Loading configuration from %1...").arg(filePath));
+    }
+
+    QSharedPointer<LoadedConfig> config(new LoadedConfig);
+    config->filePath = filePath;
+    int appends = m_configJournal->appendCount();
+    QThread *thread = QThread::create([this, config, load, incremental, appends]() {
+        readConfig(config.data());
+        QMetaObject::invokeMethod(this, [this, config, load, incremental, appends]() {
+            if (load != m_configLoad) {
+                return;
+            }
+            // A preset saved while the files were read may be missing from them
+            if (appends != m_configJournal->appendCount()) {
+                loadConfigFileInBackground(config->filePath, incremental);
+                return;
+            }
+            if (!incremental) {
+                m_configLoading = false;
+                applyConfig(*config);
+            } else if (config->filePath == m_currentConfigFilePath && !updateConfig(*config)) {
+                setStatusBarMessage(tr("%1 changed but could not be reloaded: %2").arg(config->filePath, config->errorMessage));
+            }
+        }, Qt::QueuedConnection);
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_configLoader = thread;
+    thread->start();
+}
+
+void MainWindow::ensureEditorLoaded()
+{
+    if (m_editorLoaded) {
+        return;
+    }
+    m_editorLoaded = true;
+    ui->txtEditFile->setPlainText(QString::fromUtf8(m_editorData));
+    m_editorData.clear();
+}
+
 void MainWindow::on_actionOpen_triggered()
 {
     qDebug() << "on_actionOpen_triggered called.";
     QString filePath = QFileDialog::getOpenFileName(this, tr("Open Configuration"), "", tr("JSON Files (*.json)"));
     qDebug() << "Selected file path:" << filePath;
     if (!filePath.isEmpty()) {
-        loadConfigFile(filePath);
+        loadConfigFileInBackground(filePath);
     }
 }
 
@@ -403,6 +963,18 @@ void MainWindow::on_btnSaveFile_clicked()
         QMessageBox::warning(this, tr("Warning"), tr("No configuration file loaded to save."));
         return;
     }
+    ensureEditorLoaded();
+    // Or the compaction would put back the file it read
+    m_configJournal->waitForCompaction();
+    // The editor keeps unsaved edits over a reload: the file may have moved on
+    // since, with saved presets folded into it or another tool's changes
+    if (ConfigFragments::stamp(QStringList(m_currentConfigFilePath)) != m_editorStamp
+        && QMessageBox::warning(this, tr("Warning"),
+                                tr("%1 changed on disk since the editor loaded it, for example when saved presets "
+                                   "were written into it. Saving overwrites those changes.").arg(m_currentConfigFilePath),
+                                QMessageBox::Save | QMessageBox::Cancel, QMessageBox::Cancel) != QMessageBox::Save) {
+        return;
+    }
 
     QFile file(m_currentConfigFilePath);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
@@ -414,35 +986,37 @@ void MainWindow::on_btnSaveFile_clicked()
     QTextStream out(&file);
     out << contentToSave;
     file.close();
+    m_editorStamp = ConfigFragments::stamp(QStringList(m_currentConfigFilePath));
 
+    ui->txtEditFile->document()->setModified(false);
     setStatusBarMessage(tr("Configuration saved to %1").arg(m_currentConfigFilePath));
-    loadConfigFile(m_currentConfigFilePath);
-    updateFileSizeLabel();
+    reloadConfigFile();
 }
 
 void MainWindow::on_cmbCommands_currentIndexChanged(int index)
 {
+    if (m_btnWatch && m_btnWatch->isChecked()) {
+        m_btnWatch->setChecked(false);
+    }
     if (index < 0) {
         clearForm();
         return;
     }
-    QString selectedTopic = ui->cmbTopics->currentText();
-    QJsonArray commands = m_rootConfig["topics"].toObject()[selectedTopic].toArray();
-
+    const QVector<CommandSpec> &commands = m_catalog.commands(ui->cmbTopics->currentText());
     if (index >= commands.size()) {
         return;
     }
 
-    m_currentConfig = commands[index].toObject();
-    buildUi(m_currentConfig);
+    m_currentCommand = commands.at(index);
+    buildUi(m_currentCommand);
     updateCommandLineLabel();
     if (ui->tabWidget->currentIndex() == 2) { // Check if Edit tab is active
         scrollToCurrentCommandInEditor();
     }
 
     m_txtHelp->clear();
-    if (m_currentConfig.contains("man")) {
-        QString manCommand = "man " + m_currentConfig["man"].toString();
+    if (!m_currentCommand.man.isEmpty()) {
+        QString manCommand = "man " + m_currentCommand.man;
         QProcess *process = new QProcess(this);
         process->setProcessChannelMode(QProcess::MergedChannels);
         connect(process, &QProcess::readyReadStandardOutput, this, [this, process]() {
@@ -477,12 +1051,8 @@ void MainWindow::on_cmbTopics_currentIndexChanged(int index)
     }
     ui->cmbCommands->clear();
 
-    QString selectedTopic = ui->cmbTopics->currentText();
-    QJsonObject topics = m_rootConfig["topics"].toObject();
-    QJsonArray commands = topics[selectedTopic].toArray();
-
-    for (const QJsonValue &value : commands) {
-        ui->cmbCommands->addItem(value.toObject()["name"].toString());
+    for (const CommandSpec &command : m_catalog.commands(ui->cmbTopics->currentText())) {
+        ui->cmbCommands->addItem(command.name);
     }
 
     if (ui->cmbCommands->count() > 0) {
@@ -494,7 +1064,7 @@ void MainWindow::on_cmbTopics_currentIndexChanged(int index)
     updateCommandLineLabel();
 }
 
-void MainWindow::buildUi(const QJsonObject &config)
+void MainWindow::buildUi(const CommandSpec &command)
 {
     clearForm();
     m_exclusiveGroupWidgets.clear();
@@ -503,11 +1073,10 @@ void MainWindow::buildUi(const QJsonObject &config)
     }
     m_buttonGroups.clear();
 
-    if (!config.contains("arguments") || !config["arguments"].isArray()) {
+    if (!command.config.value("arguments").isArray()) {
         return;
     }
 
-    QJsonArray arguments = config["arguments"].toArray();
     QFormLayout *layout = qobject_cast<QFormLayout*>(ui->scrollAreaWidgetContents->layout());
     if (!layout) {
         layout = new QFormLayout(ui->scrollAreaWidgetContents);
@@ -517,22 +1086,36 @@ void MainWindow::buildUi(const QJsonObject &config)
     // Add "Run as Sudo" checkbox
     m_sudoCheckBox = new QCheckBox(tr("Run as Sudo"), ui->scrollAreaWidgetContents);
     m_sudoCheckBox->setObjectName("m_sudoCheckBox");
-    m_sudoCheckBox->setChecked(config.value("sudo").toBool(false));
+    m_sudoCheckBox->setChecked(command.sudo);
     layout->addRow(m_sudoCheckBox);
     connect(m_sudoCheckBox, &QCheckBox::toggled, this, &MainWindow::updateCommandLineLabel);
 
+    // Add "Collect CPU counters" checkbox
+    m_cpuCountersCheckBox = new QCheckBox(tr("Collect CPU counters"), ui->scrollAreaWidgetContents);
+    m_cpuCountersCheckBox->setObjectName("m_cpuCountersCheckBox");
+    m_cpuCountersCheckBox->setToolTip(tr("Cycles, instructions, cache and branch misses of the whole run (perf_event_open)"));
+    m_cpuCountersCheckBox->setChecked(command.cpuCounters);
+    layout->addRow(m_cpuCountersCheckBox);
+
+    if (command.cacheable) {
+        m_bypassCacheCheckBox = new QCheckBox(tr("Bypass result cache"), ui->scrollAreaWidgetContents);
+        m_bypassCacheCheckBox->setObjectName("m_bypassCacheCheckBox");
+        m_bypassCacheCheckBox->setToolTip(tr("Run the command even if a cached result exists, and refresh it"));
+        layout->addRow(m_bypassCacheCheckBox);
+    }
+
     // Add "Clear Output Before Run" checkbox
     m_clearOutputCheckBox = new QCheckBox(tr("Clear Output Before Run"), ui->scrollAreaWidgetContents);
     m_clearOutputCheckBox->setObjectName("m_clearOutputCheckBox");
-    m_clearOutputCheckBox->setChecked(config.value("clear_output").toBool(false));
+    m_clearOutputCheckBox->setChecked(command.clearOutput);
     layout->addRow(m_clearOutputCheckBox);
     connect(m_clearOutputCheckBox, &QCheckBox::toggled, this, &MainWindow::updateCommandLineLabel);
 
     m_workingDirectoryLabel = new QLabel(tr("Folder"), ui->scrollAreaWidgetContents);
     m_workingDirectoryLineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
     m_workingDirectoryLineEdit->setObjectName("m_workingDirectoryLineEdit");
-    if (config.contains("working_directory")) {
-        m_workingDirectoryLineEdit->setText(config.value("working_directory").toString());
+    if (command.hasWorkingDirectory) {
+        m_workingDirectoryLineEdit->setText(CommandLine::expandHome(command.workingDirectory));
     } else {
         m_workingDirectoryLineEdit->setText(QDir::homePath());
     }
@@ -557,158 +1140,38 @@ void MainWindow::buildUi(const QJsonObject &config)
         }
     });
 
+    m_schedulingLineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
+    m_schedulingLineEdit->setObjectName("m_schedulingLineEdit");
+    m_schedulingLineEdit->setText(Scheduling::toText(command.config.value("scheduling").toObject()));
+    m_schedulingLineEdit->setPlaceholderText(tr("e.g. cpus=0-3 nice=10 ionice=idle rlimit_as=4G cgroup=build cpu_max=50%"));
+    m_schedulingLineEdit->setToolTip(tr("Applied to the command before it starts: cpus, nice, ionice, rlimit_as, "
+                                        "rlimit_nofile, rlimit_cpu, and cgroup with cpu_max and memory_max"));
+    layout->addRow(tr("Scheduling"), m_schedulingLineEdit);
+
     QFrame *line = new QFrame();
     line->setFrameShape(QFrame::HLine);
     line->setFrameShadow(QFrame::Sunken);
     layout->addRow(line);
 
-    for (const QJsonValue &value : arguments) {
-        QJsonObject arg = value.toObject();
-        QString name = arg["name"].toString();
-        QString type = arg["type"].toString();
-        QString exclusiveGroup = arg["exclusive_group"].toString();
-        bool mandatory = arg["mandatory"].toBool();
-
-        QString styleSheet = mandatory ? "color: red;" : "";
-
-        if (type == "boolean" && !exclusiveGroup.isEmpty()) {
-            QRadioButton *radioButton = new QRadioButton(name, ui->scrollAreaWidgetContents);
-            radioButton->setStyleSheet(styleSheet);
-            layout->addRow(radioButton);
-            radioButton->setProperty("argType", type);
-            radioButton->setProperty("argFlag", arg["flag"].toString());
-            radioButton->setProperty("exclusiveGroup", exclusiveGroup);
-            radioButton->setProperty("argName", name);
-            radioButton->setProperty("mandatory", mandatory);
-
-            if (!m_buttonGroups.contains(exclusiveGroup)) {
-                m_buttonGroups.insert(exclusiveGroup, new QButtonGroup(this));
-            }
-            m_buttonGroups[exclusiveGroup]->addButton(radioButton);
-            m_exclusiveGroupWidgets[exclusiveGroup].append(radioButton);
-            connect(radioButton, &QRadioButton::toggled, this, &MainWindow::updateCommandLineLabel);
-            if (arg.contains("default")) {
-                radioButton->setChecked(arg["default"].toBool());
-            }
-        } else if (type == "file" || type == "folder" || type == "newfile" || type == "newfolder") {
-            QLabel *label = new QLabel(name, ui->scrollAreaWidgetContents);
-            label->setStyleSheet(styleSheet);
-            QWidget *widget = new QWidget(ui->scrollAreaWidgetContents);
-            QHBoxLayout *hLayout = new QHBoxLayout(widget);
-            QLineEdit *lineEdit = new QLineEdit(this);
-            lineEdit->setInputMethodHints(Qt::ImhNone);
-            if (arg.contains("default")) {
-                lineEdit->setText(arg["default"].toString());
-            }
-            lineEdit->setStyleSheet(styleSheet);
-            connect(lineEdit, &QLineEdit::textChanged, this, &MainWindow::updateCommandLineLabel);
-            QPushButton *button = new QPushButton("...", ui->scrollAreaWidgetContents);
-            hLayout->addWidget(lineEdit);
-            hLayout->addWidget(button);
-            hLayout->setContentsMargins(0, 0, 0, 0);
-            widget->setLayout(hLayout);
-            layout->addRow(label, widget);
-
-            if (type == "file") {
-                connect(button, &QPushButton::clicked, this, [this, lineEdit]() {
-                    QString path = QFileDialog::getOpenFileName(this, "Select File");
-                    if (!path.isEmpty()) {
-                        lineEdit->setText(path);
-                    }
-                });
-            } else if (type == "newfile") {
-                connect(button, &QPushButton::clicked, this, [this, lineEdit]() {
-                    QString path = QFileDialog::getSaveFileName(this, "Select File");
-                    if (!path.isEmpty()) {
-                        lineEdit->setText(path);
-                    }
-                });
-            } else if (type == "newfolder") {
-                connect(button, &QPushButton::clicked, this, [this, lineEdit]() {
-                    QString path = QFileDialog::getExistingDirectory(this, "Select Folder");
-                    if (!path.isEmpty()) {
-                        lineEdit->setText(path);
-                    }
-                });
-            } else { // folder
-                connect(button, &QPushButton::clicked, this, [this, lineEdit]() {
-                    QString path = QFileDialog::getExistingDirectory(this, "Select Folder");
-                    if (!path.isEmpty()) {
-                        lineEdit->setText(path);
-                    }
-                });
-            }
-            widget->setProperty("argType", type);
-            widget->setProperty("argFlag", arg["flag"].toString());
-            widget->setProperty("argName", name);
-            widget->setProperty("mandatory", mandatory);
-        } else if (type == "files") {
-            QLabel *label = new QLabel(name, ui->scrollAreaWidgetContents);
-            label->setStyleSheet(styleSheet);
-            QListWidget *listWidget = new QListWidget(ui->scrollAreaWidgetContents);
-            listWidget->setStyleSheet(styleSheet);
-            QPushButton *button = new QPushButton("...", ui->scrollAreaWidgetContents);
-            connect(button, &QPushButton::clicked, this, [this, listWidget]() {
-                QStringList files = QFileDialog::getOpenFileNames(this, "Select Files");
-                if (!files.isEmpty()) {
-                    listWidget->addItems(files);
-                    updateCommandLineLabel(); // Update after adding files
-                }
+    m_argumentWidgets.fill(nullptr, command.arguments.size());
+    for (int i = 0; i < command.arguments.size(); ++i) {
+        const ArgSpec &arg = command.arguments.at(i);
+        QWidget *field = ArgumentForm::addRow(layout, ui->scrollAreaWidgetContents, arg, &m_buttonGroups,
+                                              [this]() { updateCommandLineLabel(); });
+        if (arg.type == ArgSpec::Boolean && !arg.exclusiveGroup.isEmpty()) {
+            m_exclusiveGroupWidgets[arg.exclusiveGroup].append(field);
+        } else if (arg.type == ArgSpec::Files) {
+            field->setProperty("batch", arg.batch);
+            field->setProperty("batchWorkers", arg.batchWorkers);
+            QCheckBox *batchCheckBox = new QCheckBox(tr("Split into parallel batches"), ui->scrollAreaWidgetContents);
+            batchCheckBox->setChecked(arg.batch);
+            batchCheckBox->setProperty("formOption", true);
+            connect(batchCheckBox, &QCheckBox::toggled, field, [field](bool checked) {
+                field->setProperty("batch", checked);
             });
-            connect(listWidget, &QListWidget::itemChanged, this, &MainWindow::updateCommandLineLabel);
-            layout->addRow(label, listWidget);
-            layout->addRow(button);
-            listWidget->setProperty("argType", type);
-            listWidget->setProperty("argFlag", arg["flag"].toString());
-            listWidget->setProperty("argName", name);
-            listWidget->setProperty("mandatory", mandatory);
-            if (arg.contains("default")) {
-                QJsonArray defaultFiles = arg["default"].toArray();
-                for (const QJsonValue &fileVal : defaultFiles) {
-                    listWidget->addItem(fileVal.toString());
-                }
-            }
-        } else if (type == "string" || type == "raw_string") {
-            QLabel *label = new QLabel(name, ui->scrollAreaWidgetContents);
-            label->setStyleSheet(styleSheet);
-            QLineEdit *lineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
-            lineEdit->setInputMethodHints(Qt::ImhNone);
-            if (arg.contains("default")) {
-                lineEdit->setText(arg["default"].toString());
-            }
-            lineEdit->setStyleSheet(styleSheet);
-            layout->addRow(label, lineEdit);
-            connect(lineEdit, &QLineEdit::textChanged, this, &MainWindow::updateCommandLineLabel);
-            lineEdit->setProperty("argType", type);
-            lineEdit->setProperty("argFlag", arg["flag"].toString());
-            lineEdit->setProperty("argName", name);
-            lineEdit->setProperty("mandatory", mandatory);
-        } else if (type == "integer") {
-            QLabel *label = new QLabel(name, ui->scrollAreaWidgetContents);
-            label->setStyleSheet(styleSheet);
-            QLineEdit *lineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
-            lineEdit->setInputMethodHints(Qt::ImhNone);
-            if (arg.contains("default")) {
-                lineEdit->setText(QString::number(arg["default"].toInt()));
-            }
-            layout->addRow(label, lineEdit);
-            connect(lineEdit, &QLineEdit::textChanged, this, &MainWindow::updateCommandLineLabel);
-            lineEdit->setProperty("argType", type);
-            lineEdit->setProperty("argFlag", arg["flag"].toString());
-            lineEdit->setProperty("argName", name);
-            lineEdit->setProperty("mandatory", mandatory);
-        } else if (type == "boolean") { // Handle boolean without exclusive group
-            QCheckBox *checkBox = new QCheckBox(name, ui->scrollAreaWidgetContents);
-            if (arg.contains("default")) {
-                checkBox->setChecked(arg["default"].toBool());
-            }
-            checkBox->setStyleSheet(styleSheet);
-            layout->addRow(checkBox);
-            connect(checkBox, &QCheckBox::toggled, this, &MainWindow::updateCommandLineLabel);
-            checkBox->setProperty("argType", type);
-            checkBox->setProperty("argFlag", arg["flag"].toString());
-            checkBox->setProperty("argName", name);
+            layout->addRow(batchCheckBox);
         }
+        m_argumentWidgets[i] = field;
     }
 
     QFrame *line2 = new QFrame();
@@ -717,12 +1180,12 @@ void MainWindow::buildUi(const QJsonObject &config)
     layout->addRow(line2);
 
     QLabel *miscLabel = new QLabel(tr("Misc"), ui->scrollAreaWidgetContents);
-    QLineEdit *miscLineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
-    miscLineEdit->setObjectName("miscLineEdit");
-    miscLineEdit->setInputMethodHints(Qt::ImhNone);
-    layout->addRow(miscLabel, miscLineEdit);
-    connect(miscLineEdit, &QLineEdit::textChanged, this, &MainWindow::updateCommandLineLabel);
-    miscLineEdit->setProperty("argType", "raw_string");
+    m_miscLineEdit = new QLineEdit(ui->scrollAreaWidgetContents);
+    m_miscLineEdit->setObjectName("miscLineEdit");
+    m_miscLineEdit->setInputMethodHints(Qt::ImhNone);
+    layout->addRow(miscLabel, m_miscLineEdit);
+    connect(m_miscLineEdit, &QLineEdit::textChanged, this, &MainWindow::updateCommandLineLabel);
+    m_miscLineEdit->setProperty("argType", "raw_string");
 }
 
 void MainWindow::applyTheme(const QString &themeName)
@@ -738,117 +1201,862 @@ void MainWindow::applyTheme(const QString &themeName)
 }
 
 void MainWindow::on_btnRun_clicked()
-
 {
+    // A run from the history replays its recorded command line instead of the form
+    QString replayCommandLine = m_replayCommandLine;
+    m_replayCommandLine.clear();
+    if (m_process || m_batchPool || m_launchedRun) {
+        setStatusBarMessage(tr("A command is already running."));
+        return;
+    }
 
-    QString commandLineForDisplay = buildCommandLine();
+    QString commandLineForDisplay = replayCommandLine.isEmpty() ? buildCommandLine() : replayCommandLine;
     if (commandLineForDisplay.isEmpty()) {
         return;
     }
 
-    setStatusBarMessage(tr("Executing command: %1").arg(commandLineForDisplay));
-
-    if (lblCommand) {
-        lblCommand->setText(commandLineForDisplay);
+    // Cacheable commands replay the stored result of the same argv and inputs
+    m_cacheKey.clear();
+    m_cacheOutput.clear();
+    if (m_currentCommand.cacheable && !m_currentCommand.stdinFromPreviousOutput) {
+        QString key = ResultCache::key(commandLineForDisplay, m_workingDirectoryLineEdit->text(), inputFiles());
+        ResultCache::Entry entry;
+        if (!(m_bypassCacheCheckBox && m_bypassCacheCheckBox->isChecked()) && ResultCache::lookup(key, &entry)) {
+            prepareRun(commandLineForDisplay);
+            m_recordRun = false;
+            appendOutput(entry.output);
+            finishRun(entry.exitCode, tr("cached result from %1").arg(QLocale().toString(entry.created, QLocale::ShortFormat)));
+            if (m_lblExitCode) {
+                m_lblExitCode->setText(tr("Exit Code: %1 (cached)").arg(entry.exitCode));
+            }
+            setStatusBarMessage(tr("Replayed the cached result; check \"Bypass result cache\" to run the command again."));
+            return;
+        }
+        m_cacheKey = key;
     }
 
-    QString commandLineForExecution = "stdbuf -o L " + commandLineForDisplay;
-
-
-
-    if (m_clearOutputCheckBox && m_clearOutputCheckBox->isChecked()) {
-
-        ui->txtOutput->clear();
-
+    // Checked before anything runs: a typo must not silently drop the envelope
+    QSharedPointer<const Scheduling::Prepared> preparedScheduling;
+    QStringList schedulingWarnings;
+    if (!prepareScheduling(&preparedScheduling, &schedulingWarnings)) {
+        return;
     }
 
-
-
-    ui->tabWidget->setCurrentIndex(0);
-
-    if (m_lblExitCode) {
-        m_lblExitCode->setText(tr("Exit Code: N/A"));
-    }
-    if (m_lblElapsedTime) {
-        m_lblElapsedTime->setText(tr("Elapsed: N/A"));
+    QListWidget *batchedList = batchedFilesWidget();
+    if (batchedList && batchedList->count() > 0 && replayCommandLine.isEmpty()) {
+        runBatched(batchedList, preparedScheduling, schedulingWarnings);
+        return;
     }
 
-    m_timer.restart();
-
-    if (m_btnBreak) {
-
-        m_btnBreak->setEnabled(true);
+    // Opened before the run for the same reason: a missing input is an error, not an empty stdin
+    if (m_currentCommand.hasStdin) {
+        m_stdinFeeder = new StdinFeeder(this);
+        QString error;
+        bool opened;
+        if (m_currentCommand.stdinFromPreviousOutput) {
+            opened = m_stdinFeeder->open(m_outputSpool, &error);
+        } else {
+            QString name = m_currentCommand.stdinArgument;
+            QString path = argumentValue(m_currentCommand.indexOf(name));
+            error = tr("No file given for stdin (argument \"%1\")").arg(name);
+            opened = !path.isEmpty()
+                     && m_stdinFeeder->open(QDir(m_workingDirectoryLineEdit->text()).absoluteFilePath(path), &error);
+        }
+        if (!opened) {
+            delete m_stdinFeeder;
+            m_stdinFeeder = nullptr;
+            QMessageBox::warning(this, tr("Stdin"), error);
+            return;
+        }
+        // Straight to the label: four updates a second do not belong in the log
+        connect(m_stdinFeeder, &StdinFeeder::progress, this, [this](qint64 fed, qint64 total) {
+            if (!m_statusLabel) {
+                return;
+            }
+            if (total > 0) {
+                m_statusLabel->setText(tr("Feeding stdin: %1 of %2 (%3%)")
+                                           .arg(ResourceMonitor::formatBytes(fed), ResourceMonitor::formatBytes(total))
+                                           .arg(fed * 100 / total));
+            } else {
+                m_statusLabel->setText(tr("Feeding stdin: %1").arg(ResourceMonitor::formatBytes(fed)));
+            }
+        });
+    }
 
+    prepareRun(commandLineForDisplay);
+    for (const QString &warning : schedulingWarnings) {
+        appendDiagnostic(tr("Scheduling: %1\n").arg(warning));
     }
 
-    setCommandRunningStatus(true);
+    // Counters are attached between fork and exec, which only QuishProcess can do
+    bool collectCpuCounters = m_cpuCountersCheckBox && m_cpuCountersCheckBox->isChecked();
+    bool excludeKernel = false;
+    if (collectCpuCounters) {
+        QString reason;
+        if (!CpuCounters::isAvailable(&reason, &excludeKernel)) {
+            appendDiagnostic(tr("CPU counters not collected: %1\n").arg(reason));
+            collectCpuCounters = false;
+        }
+    }
 
-    m_process = new QProcess(this);
+    if (!collectCpuCounters && !preparedScheduling && !m_stdinFeeder && !m_currentCommand.pty
+        && m_appSettings.get("useLauncher").toBool()
+        && runWithLauncher(commandLineForDisplay)) {
+        return;
+    }
 
+    m_process = new QuishProcess(this);
     m_process->setProcessChannelMode(QProcess::MergedChannels);
 
-        connect(m_process, &QProcess::readyReadStandardOutput, this, [this]() {
-
-            ui->txtOutput->insertPlainText(m_process->readAll());
-
-            ui->txtOutput->verticalScrollBar()->setValue(ui->txtOutput->verticalScrollBar()->maximum());
-
-        });
+    // On a pseudo-terminal the tools line-buffer on their own, no stdbuf needed
+    QString commandLineForExecution = "stdbuf -o L " + commandLineForDisplay;
+    if (m_currentCommand.pty) {
+        QFontMetrics fm(ui->txtOutput->font());
+        int columns = ui->txtOutput->viewport()->width() / qMax(1, fm.horizontalAdvance('M'));
+        int rows = ui->txtOutput->viewport()->height() / qMax(1, fm.height());
+        QString error;
+        if (m_process->enablePty(columns, rows, &error)) {
+            commandLineForExecution = commandLineForDisplay;
+            connect(m_process, &QuishProcess::ptyOutput, this, &MainWindow::appendOutput);
+        } else {
+            setStatusBarMessage(error);
+        }
+    }
 
+    m_process->setCollectResourceUsage(true);
+    if (preparedScheduling) {
+        m_process->setScheduling(*preparedScheduling);
+    }
+    if (collectCpuCounters) {
+        m_process->setCollectCpuCounters(excludeKernel);
+    }
+    if (m_stdinFeeder) {
+        m_process->setStdinDescriptor(m_stdinFeeder->childFd());
+    }
+    connect(m_process, &QProcess::started, this, [this]() {
+        m_resourceMonitor->start(m_process->processId());
+        runStarted(m_process->processId());
+        if (m_stdinFeeder) {
+            m_stdinFeeder->releaseChildFd();
+            m_stdinFeeder->start();
+        }
+    });
+    connect(m_process, &QProcess::readyReadStandardOutput, this, [this]() {
+        appendOutput(m_process->readAll());
+    });
     connect(m_process,
-
             QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-
             this,
-
             [this](int exitCode, QProcess::ExitStatus exitStatus) {
+                appendOutput(m_process->readAllStandardOutput());
+                QString usage;
+                if (m_process->hasResourceUsage()) {
+                    usage = ResourceMonitor::formatUsage(m_process->resourceUsage());
+                    RunHistory::setUsage(&m_historyEntry, m_process->resourceUsage());
+                }
+                if (m_process->hasCpuCounters()) {
+                    usage += "; " + CpuCounters::format(m_process->cpuCounters());
+                }
+                if (exitStatus == QProcess::CrashExit) {
+                    // The reaper re-raises the command's signal, so exitCode is that signal too;
+                    // reported like the launcher does, as the shell's 128 + signal
+                    int termSignal = m_process->terminationSignal() ? m_process->terminationSignal() : exitCode;
+                    m_cacheKey.clear();
+                    usage = tr("killed by %1").arg(GroupStopper::signalName(termSignal))
+                            + (usage.isEmpty() ? QString() : "; " + usage);
+                    exitCode = 128 + termSignal;
+                }
+                m_process->deleteLater();
+                m_process = nullptr;
+                finishRun(exitCode, usage);
+            });
 
-                Q_UNUSED(exitStatus);
-
-                ui->txtOutput->append(m_process->readAllStandardOutput());
-
-                QString color = (exitCode == 0) ? "green" : "red";
+    m_process->setWorkingDirectory(m_workingDirectoryLineEdit->text());
+    m_process->start("/bin/sh", QStringList() << "-c" << commandLineForExecution);
+}
 
-                ui->txtOutput->append(
+bool MainWindow::runWithLauncher(const QString &commandLine)
+{
+    Launcher *launcher = Launcher::instance();
+    if (!launcher->isAvailable()) {
+        return false;
+    }
 
-                    QString("<span style=\"color:%1;\">\nProcess finished " "with exit code " "%2</span><br><br>")
+    QStringList arguments = Launcher::argumentsFor("stdbuf -o L " + commandLine);
+    m_launchedRun = launcher->launch(arguments, m_workingDirectoryLineEdit->text(), this);
+    if (!m_launchedRun) {
+        return false;
+    }
+
+    connect(m_launchedRun, &LaunchedRun::started, this, [this]() {
+        m_resourceMonitor->start(m_launchedRun->pid());
+        runStarted(m_launchedRun->pid());
+    });
+    connect(m_launchedRun, &LaunchedRun::output, this, &MainWindow::appendOutput);
+    connect(m_launchedRun, &LaunchedRun::finished, this, [this](int exitCode, int termSignal) {
+        QString usage = ResourceMonitor::formatUsage(m_launchedRun->resourceUsage());
+        if (termSignal != 0) {
+            // A crash or an OOM kill is no result to serve again
+            m_cacheKey.clear();
+            usage = tr("killed by %1").arg(GroupStopper::signalName(termSignal)) + "; " + usage;
+        }
+        RunHistory::setUsage(&m_historyEntry, m_launchedRun->resourceUsage());
+        m_launchedRun->deleteLater();
+        m_launchedRun = nullptr;
+        finishRun(exitCode, usage);
+    });
+    connect(m_launchedRun, &LaunchedRun::failed, this, [this](const QString &errorMessage) {
+        appendDiagnostic(errorMessage + "\n");
+        m_launchedRun->deleteLater();
+        m_launchedRun = nullptr;
+        finishRun(-1);
+    });
+    return true;
+}
 
-                        .arg(color)
+void MainWindow::prepareRun(const QString &commandLine)
+{
+    m_runId++;
+    if (m_instanceServer) {
+        m_instanceServer->runStarted(m_runId, commandLine);
+    }
+    setStatusBarMessage(tr("Executing command: %1").arg(commandLine));
 
-                        .arg(exitCode));
+    if (lblCommand) {
+        lblCommand->setText(commandLine);
+    }
 
-                setStatusBarMessage(
+    if (m_clearOutputCheckBox && m_clearOutputCheckBox->isChecked()) {
+        ui->txtOutput->clear();
+    }
 
-                    QString("Finished with exit code %1 in %2 ms").arg(exitCode).arg(m_timer.elapsed()));
+    ui->tabWidget->setCurrentIndex(0);
 
-                if (m_lblExitCode) {
-                    m_lblExitCode->setText(QString("Exit Code: %1").arg(exitCode));
-                }
-                if (m_lblElapsedTime) {
-                    m_lblElapsedTime->setText(QString("Elapsed: %1 ms").arg(m_timer.elapsed()));
-                }
+    if (m_lblExitCode) {
+        m_lblExitCode->setText(tr("Exit Code: N/A"));
+    }
+    if (m_lblElapsedTime) {
+        m_lblElapsedTime->setText(tr("Elapsed: N/A"));
+    }
+    if (m_lblResources) {
+        m_lblResources->setText(tr("CPU: N/A"));
+    }
 
-                if (m_btnBreak) {
+    // Each run's output is also kept in memory outside the heap, for a
+    // following command that takes it as stdin
+    if (m_outputSpool >= 0) {
+        ::close(m_outputSpool);
+    }
+    m_outputSpool = memfd_create("quish-output", MFD_CLOEXEC);
 
-                    m_btnBreak->setEnabled(false);
+    // Completed and recorded by finishRun
+    m_historyEntry = RunHistory::Entry();
+    m_historyEntry.command = ui->cmbTopics->currentText() + "/" + ui->cmbCommands->currentText();
+    m_historyEntry.commandLine = commandLine;
+    m_historyEntry.argv = Launcher::argumentsFor(commandLine);
+    m_historyEntry.workingDirectory = m_workingDirectoryLineEdit ? m_workingDirectoryLineEdit->text() : QString();
+    m_historyEntry.started = QDateTime::currentDateTime();
+    m_recordRun = true;
 
-                }
+    m_timer.restart();
 
-                m_process->deleteLater();
+    if (m_btnBreak) {
+        m_btnBreak->setEnabled(true);
+    }
 
-                m_process = nullptr;
+    setCommandRunningStatus(true);
+}
+
+void MainWindow::appendOutput(const QByteArray &data)
+{
+    ui->txtOutput->moveCursor(QTextCursor::End);
+    ui->txtOutput->insertPlainText(data);
+    ui->txtOutput->verticalScrollBar()->setValue(ui->txtOutput->verticalScrollBar()->maximum());
+    if (!m_cacheKey.isEmpty()) {
+        m_cacheOutput.append(data);
+    }
+    if (m_instanceServer) {
+        m_instanceServer->runOutput(m_runId, data);
+    }
+    if (m_watchRunActive) {
+        m_watchOutput.append(data);
+    }
+    m_historyEntry.outputBytes += data.size();
+    for (qint64 written = 0; m_outputSpool >= 0 && written < data.size();) {
+        ssize_t count = ::write(m_outputSpool, data.constData() + written, data.size() - written);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+        written += qMax<ssize_t>(count, 0);
+    }
+}
+
+// Quish's own notes about a run: shown with its output, but not part of it, so
+// they stay out of the cache, the next run's stdin, the watch diff and the byte count
+void MainWindow::appendDiagnostic(const QString &text)
+{
+    ui->txtOutput->moveCursor(QTextCursor::End);
+    ui->txtOutput->insertPlainText(text);
+    ui->txtOutput->verticalScrollBar()->setValue(ui->txtOutput->verticalScrollBar()->maximum());
+}
+
+// The run leads its own process group: remember it for Break and the timeout
+void MainWindow::runStarted(qint64 pid)
+{
+    m_runGroup = pid;
+    if (m_currentCommand.timeout > 0) {
+        m_runTimeout->start(qRound(m_currentCommand.timeout * 1000));
+    }
+}
 
-                setCommandRunningStatus(false);
+void MainWindow::stopRun(const QString &reason)
+{
+    if (m_runGroup <= 0) {
+        return;
+    }
+    if (m_groupStopper->isActive()) {
+        m_groupStopper->hurry();
+        return;
+    }
+    m_stopReason = reason;
+    QList<GroupStopper::Step> steps;
+    QString error;
+    QString sequence = m_currentCommand.config.contains("stop_sequence") ? m_currentCommand.stopSequence
+                                                                         : m_appSettings.get("stopSequence").toString();
+    if (!GroupStopper::parseSteps(sequence, &steps, &error)) {
+        appendDiagnostic(QString("%1\n").arg(error));
+        GroupStopper::parseSteps(GroupStopper::defaultStepsText(), &steps, &error);
+    }
+    m_groupStopper->start(m_runGroup, steps);
+}
 
+// Whether anything the run started outlived it; a stopped run gets no survivors
+QString MainWindow::reapRunGroup()
+{
+    m_runTimeout->stop();
+    m_groupStopper->stop();
+    if (m_runGroup <= 0) {
+        return QString();
+    }
+
+    // The group is only probed here; its members are listed off the GUI thread
+    QString report;
+    pid_t group = m_runGroup;
+    if (!m_stopReason.isEmpty()) {
+        if (!GroupStopper::killLeftovers(group)) {
+            report = tr("process tree fully reaped");
+        } else {
+            report = tr("killed the leftover processes");
+            // Checked once SIGKILL had time to land
+            QTimer::singleShot(500, this, [this, group]() {
+                GroupStopper::findLiveMembers(group, this, [this](const QList<pid_t> &surviving) {
+                    if (!surviving.isEmpty()) {
+                        setStatusBarMessage(tr("%n process(es) of the stopped run survived SIGKILL", nullptr, surviving.size()));
+                    } else {
+                        setStatusBarMessage(tr("Process tree of the stopped run fully reaped."));
+                    }
+                });
             });
+        }
+        report = m_stopReason + "; " + report;
+    } else if (!GroupStopper::isAlive(group)) {
+        report = tr("process tree fully reaped");
+    } else {
+        report = tr("processes still running in its group");
+        GroupStopper::findLiveMembers(group, this, [this](const QList<pid_t> &members) {
+            QStringList pids;
+            for (pid_t pid : members) {
+                pids.append(QString::number(pid));
+            }
+            if (!pids.isEmpty()) {
+                setStatusBarMessage(tr("%n process(es) of the last run still running in its group: %1", nullptr,
+                                       pids.size()).arg(pids.join(", ")));
+            }
+        });
+    }
+    m_runGroup = -1;
+    m_stopReason.clear();
+    return report;
+}
+
+void MainWindow::finishRun(int exitCode, const QString &runDetails)
+{
+    m_resourceMonitor->stop();
+    QStringList reports;
+    if (!runDetails.isEmpty()) {
+        reports.append(runDetails);
+    }
+    // Whatever the command did not read by now, it never will
+    if (m_stdinFeeder) {
+        m_stdinFeeder->cancel();
+        reports.append(m_stdinFeeder->summary());
+        m_stdinFeeder->deleteLater();
+        m_stdinFeeder = nullptr;
+    }
+    QString groupReport = reapRunGroup();
+    if (!groupReport.isEmpty()) {
+        reports.append(groupReport);
+    }
+    QString details = reports.join("; ");
 
+    if (!m_cacheKey.isEmpty() && exitCode >= 0) {
+        ResultCache::store(m_cacheKey, m_cacheOutput, exitCode);
+    }
+    m_cacheKey.clear();
+    m_cacheOutput.clear();
+    if (m_recordRun) {
+        m_historyEntry.durationMs = m_timer.elapsed();
+        m_historyEntry.exitCode = exitCode;
+        m_runHistory->record(m_historyEntry);
+        m_recordRun = false;
+    }
+    if (m_instanceServer) {
+        m_instanceServer->runFinished(m_runId, exitCode);
+    }
+    // An iteration cut short by a newer trigger is not worth comparing
+    bool watchIteration = m_watchRunActive;
+    m_watchRunActive = false;
+    if (watchIteration && m_watchPendingReason.isEmpty()) {
+        showWatchDiff();
+    }
 
+    QString color = (exitCode == 0) ? "green" : "red";
+    QString marker = QString("\nProcess finished with exit code %1").arg(exitCode);
+    if (!details.isEmpty()) {
+        marker += " (" + details.toHtmlEscaped() + ")";
+    }
+    ui->txtOutput->append(QString("<span style=\"color:%1;\">%2</span><br><br>").arg(color).arg(marker));
 
-    m_process->setWorkingDirectory(m_workingDirectoryLineEdit->text());
-    m_process->start("/bin/sh", QStringList() << "-c" << commandLineForExecution);
+    setStatusBarMessage(
+        QString("Finished with exit code %1 in %2 ms").arg(exitCode).arg(m_timer.elapsed()));
+
+    if (m_lblExitCode) {
+        m_lblExitCode->setText(QString("Exit Code: %1").arg(exitCode));
+    }
+    if (m_lblElapsedTime) {
+        m_lblElapsedTime->setText(QString("Elapsed: %1 ms").arg(m_timer.elapsed()));
+    }
+
+    if (m_btnBreak) {
+        m_btnBreak->setEnabled(false);
+    }
+
+    setCommandRunningStatus(false);
+
+    if (m_watchController->isActive() && !m_watchPendingReason.isEmpty()) {
+        QString reason = m_watchPendingReason;
+        QTimer::singleShot(0, this, [this, reason]() { runWatchIteration(reason); });
+    }
+}
+
+QStringList MainWindow::watchedPaths() const
+{
+    QStringList paths;
+    for (int i = 0; i < m_currentCommand.arguments.size(); ++i) {
+        if (m_currentCommand.arguments.at(i).type == ArgSpec::Folder) {
+            QString path = argumentValue(i);
+            if (!path.isEmpty()) {
+                paths.append(path);
+            }
+        }
+    }
+    return paths + inputFiles();
+}
+
+QStringList MainWindow::inputFiles() const
+{
+    QStringList files;
+    for (int i = 0; i < m_currentCommand.arguments.size(); ++i) {
+        ArgSpec::Type type = m_currentCommand.arguments.at(i).type;
+        if (type == ArgSpec::File) {
+            QString path = argumentValue(i);
+            if (!path.isEmpty()) {
+                files.append(path);
+            }
+        } else if (type == ArgSpec::Files) {
+            QListWidget *listWidget = qobject_cast<QListWidget*>(argumentWidget(i));
+            for (int j = 0; listWidget && j < listWidget->count(); ++j) {
+                files.append(listWidget->item(j)->text());
+            }
+        }
+    }
+    return files;
+}
+
+QListWidget *MainWindow::batchedFilesWidget() const
+{
+    const QList<QListWidget*> listWidgets = ui->scrollAreaWidgetContents->findChildren<QListWidget*>();
+    for (QListWidget *listWidget : listWidgets) {
+        if (listWidget->property("argType").toString() == "files" && listWidget->property("batch").toBool()) {
+            return listWidget;
+        }
+    }
+    return nullptr;
+}
+
+// The scheduling of the form, null when it is empty; false after telling why it is invalid
+bool MainWindow::prepareScheduling(QSharedPointer<const Scheduling::Prepared> *prepared, QStringList *warnings)
+{
+    prepared->reset();
+    if (!m_schedulingLineEdit || m_schedulingLineEdit->text().trimmed().isEmpty()) {
+        return true;
+    }
+    QJsonObject scheduling;
+    QSharedPointer<Scheduling::Prepared> result(new Scheduling::Prepared);
+    QString error;
+    if (!Scheduling::fromText(m_schedulingLineEdit->text(), &scheduling, &error)
+        || !Scheduling::prepare(scheduling, result.data(), warnings, &error)) {
+        QMessageBox::warning(this, tr("Scheduling"), error);
+        return false;
+    }
+    if (!scheduling.isEmpty()) {
+        *prepared = result;
+    }
+    return true;
+}
+
+void MainWindow::runBatched(QListWidget *listWidget, const QSharedPointer<const Scheduling::Prepared> &scheduling,
+                           const QStringList &schedulingWarnings)
+{
+    QString argName = listWidget->property("argName").toString();
+    QStringList files;
+    for (int i = 0; i < listWidget->count(); ++i) {
+        files.append(listWidget->item(i)->text());
+    }
+
+    // Size the batches against what is left of the kernel limit once the rest
+    // of the command line is in place
+    QMap<QString, QStringList> fileOverrides;
+    fileOverrides.insert(argName, QStringList());
+    QString baseCommandLine = buildCommandLine(QMap<QString, QString>(), fileOverrides);
+    qint64 budget = ProcessPool::commandLineLimit() - baseCommandLine.toLocal8Bit().size();
+    QList<QStringList> batches = ProcessPool::splitIntoBatches(CommandLine::shellQuote(files), budget);
+    if (batches.isEmpty()) {
+        QMessageBox::critical(this, tr("Error"), tr("The command line is too long to fit even one file per batch."));
+        return;
+    }
+
+    m_batchPool = new ProcessPool(this);
+    int workers = listWidget->property("batchWorkers").toInt();
+    if (workers > 0) {
+        m_batchPool->setMaxConcurrent(workers);
+    }
+
+    int offset = 0;
+    for (const QStringList &batch : batches) {
+        fileOverrides.insert(argName, files.mid(offset, batch.size()));
+        offset += batch.size();
+        m_batchPool->addJob(buildCommandLine(QMap<QString, QString>(), fileOverrides), m_workingDirectoryLineEdit->text(),
+                            scheduling);
+    }
+
+    prepareRun(tr("%1 [%2 files in %3 batches, %4 workers]")
+                   .arg(baseCommandLine).arg(files.size()).arg(batches.size()).arg(m_batchPool->maxConcurrent()));
+    for (const QString &warning : schedulingWarnings) {
+        appendDiagnostic(tr("Scheduling: %1\n").arg(warning));
+    }
+    // Many command lines: kept in the history for its numbers, not for a re-run
+    m_historyEntry.argv.clear();
+
+    // Outputs are merged in batch order: the oldest unfinished batch streams
+    // live, later ones are flushed as soon as everything before them is done
+    m_nextBatchToFlush = 0;
+    connect(m_batchPool, &ProcessPool::jobOutput, this, [this](int id, const QByteArray &data) {
+        if (id == m_nextBatchToFlush) {
+            appendOutput(data);
+        }
+    });
+    connect(m_batchPool, &ProcessPool::jobFinished, this, [this]() {
+        while (m_nextBatchToFlush < m_batchPool->jobCount() && m_batchPool->job(m_nextBatchToFlush).finished) {
+            m_nextBatchToFlush++;
+            if (m_nextBatchToFlush < m_batchPool->jobCount()) {
+                appendOutput(m_batchPool->job(m_nextBatchToFlush).output);
+            }
+        }
+    });
+    connect(m_batchPool, &ProcessPool::allFinished, this, [this]() {
+        int exitCode = 0;
+        int failed = 0;
+        int skipped = 0;
+        for (int i = 0; i < m_batchPool->jobCount(); ++i) {
+            const ProcessPool::Job &job = m_batchPool->job(i);
+            if (!job.started) {
+                skipped++;
+            } else if (job.exitCode != 0) {
+                failed++;
+                if (exitCode == 0) {
+                    exitCode = job.exitCode;
+                }
+            }
+        }
+        if (skipped > 0 && exitCode == 0) {
+            exitCode = -1;
+        }
+        QString details = tr("%1 batches, %2 failed").arg(m_batchPool->jobCount()).arg(failed);
+        if (skipped > 0) {
+            details += tr(", %1 not run").arg(skipped);
+        }
+        m_batchPool->deleteLater();
+        m_batchPool = nullptr;
+        finishRun(exitCode, details);
+    });
+
+    m_batchPool->start();
+}
+
+void MainWindow::rerunFromHistory(const RunHistory::Entry &entry)
+{
+    if (m_process || m_batchPool || m_launchedRun) {
+        setStatusBarMessage(tr("A command is already running."));
+        return;
+    }
+    QString errorMessage;
+    if (!selectCommand(entry.command, &errorMessage)) {
+        QMessageBox::warning(this, tr("History"), errorMessage);
+        return;
+    }
+    // After the selection, which resets the form to the command's defaults
+    if (m_workingDirectoryLineEdit) {
+        m_workingDirectoryLineEdit->setText(entry.workingDirectory);
+    }
+    m_replayCommandLine = entry.commandLine;
+    on_btnRun_clicked();
+}
+
+void MainWindow::runSweep()
+{
+    if (m_currentCommand.isNull()) {
+        QMessageBox::warning(this, tr("Warning"), tr("No configuration loaded"));
+        return;
+    }
+
+    QList<QPair<QString, QString>> arguments;
+    QMap<QString, QString> sweepSpecs;
+    for (int i = 0; i < m_currentCommand.arguments.size(); ++i) {
+        const ArgSpec &arg = m_currentCommand.arguments.at(i);
+        if (!arg.isText()) {
+            continue;
+        }
+        arguments.append(qMakePair(arg.name, argumentValue(i)));
+        if (!arg.sweep.isEmpty()) {
+            sweepSpecs.insert(arg.name, arg.sweep);
+        }
+    }
+
+    if (arguments.isEmpty()) {
+        QMessageBox::information(this, tr("Parameter Sweep"), tr("This command has no argument that can be swept."));
+        return;
+    }
+
+    QSharedPointer<const Scheduling::Prepared> scheduling;
+    QStringList schedulingWarnings;
+    if (!prepareScheduling(&scheduling, &schedulingWarnings)) {
+        return;
+    }
+
+    SweepDialog dialog(this);
+    dialog.setWindowTitle(tr("Parameter Sweep - %1").arg(m_currentCommand.name));
+    dialog.setArguments(arguments, sweepSpecs);
+    dialog.setWorkingDirectory(m_workingDirectoryLineEdit ? m_workingDirectoryLineEdit->text() : QDir::homePath());
+    dialog.setCommandLineBuilder([this](const QMap<QString, QString> &overrides) {
+        return buildCommandLine(overrides);
+    });
+    dialog.setScheduling(scheduling);
+    if (schedulingWarnings.isEmpty()) {
+        setStatusBarMessage(tr("Parameter sweep opened for %1").arg(m_currentCommand.name));
+    } else {
+        setStatusBarMessage(tr("Scheduling: %1").arg(schedulingWarnings.join("; ")));
+    }
+    dialog.exec();
+}
+
+void MainWindow::toggleWatch(bool checked)
+{
+    if (!checked) {
+        m_watchController->stop();
+        m_watchPendingReason.clear();
+        setStatusBarMessage(tr("Watch stopped."));
+        return;
+    }
+    if (m_currentCommand.isNull()) {
+        QMessageBox::warning(this, tr("Warning"), tr("No configuration loaded"));
+        m_btnWatch->setChecked(false);
+        return;
+    }
+
+    // Argument paths are always watched; globs, interval and debounce come from
+    // the command's "watch" object and can be changed here
+    QJsonObject watchConfig = m_currentCommand.config["watch"].toObject();
+    QStringList globs;
+    for (const QJsonValue &glob : watchConfig["globs"].toArray()) {
+        globs.append(glob.toString());
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Watch - %1").arg(m_currentCommand.name));
+    QFormLayout *form = new QFormLayout(&dialog);
+    QStringList paths = watchedPaths();
+    QLabel *pathsLabel = new QLabel(paths.isEmpty() ? tr("none") : paths.join("\n"), &dialog);
+    form->addRow(tr("Argument paths:"), pathsLabel);
+    QLineEdit *globsLineEdit = new QLineEdit(globs.join(", "), &dialog);
+    globsLineEdit->setPlaceholderText(tr("e.g. src/*.cpp, tests/*.py"));
+    form->addRow(tr("Extra globs:"), globsLineEdit);
+    QSpinBox *intervalSpinBox = new QSpinBox(&dialog);
+    intervalSpinBox->setRange(0, 86400);
+    intervalSpinBox->setSuffix(tr(" s"));
+    intervalSpinBox->setSpecialValueText(tr("Off"));
+    intervalSpinBox->setValue(watchConfig["interval"].toInt(0));
+    form->addRow(tr("Also run every:"), intervalSpinBox);
+    QSpinBox *debounceSpinBox = new QSpinBox(&dialog);
+    debounceSpinBox->setRange(0, 60000);
+    debounceSpinBox->setSuffix(tr(" ms"));
+    debounceSpinBox->setValue(watchConfig["debounce"].toInt(300));
+    form->addRow(tr("Debounce:"), debounceSpinBox);
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttonBox, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttonBox, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttonBox);
+    if (dialog.exec() != QDialog::Accepted) {
+        m_btnWatch->setChecked(false);
+        return;
+    }
+
+    globs.clear();
+    for (const QString &glob : globsLineEdit->text().split(',', Qt::SkipEmptyParts)) {
+        if (!glob.trimmed().isEmpty()) {
+            globs.append(glob.trimmed());
+        }
+    }
+    if (paths.isEmpty() && globs.isEmpty() && intervalSpinBox->value() == 0) {
+        QMessageBox::information(this, tr("Watch"), tr("Nothing to watch: give a glob or an interval."));
+        m_btnWatch->setChecked(false);
+        return;
+    }
+
+    m_watchController->start(paths, globs, m_workingDirectoryLineEdit->text(),
+                             intervalSpinBox->value() * 1000, debounceSpinBox->value());
+    m_watchIteration = 0;
+    m_watchPreviousLines.clear();
+    setStatusBarMessage(tr("Watching %1 paths").arg(m_watchController->watchedCount()));
+    if (!m_process && !m_batchPool && !m_launchedRun) {
+        runWatchIteration(tr("watch started"));
+    }
+}
+
+void MainWindow::runWatchIteration(const QString &reason)
+{
+    m_watchPendingReason.clear();
+    m_watchIteration++;
+    m_watchReason = reason;
+    m_watchOutput.clear();
+    m_watchRunActive = true;
+    ui->txtOutput->clear();
+    int previousRun = m_runId;
+    on_btnRun_clicked();
+    if (m_runId == previousRun) {
+        m_watchRunActive = false;
+    }
+}
+
+// Replaces the output of an iteration by what changed since the previous one
+void MainWindow::showWatchDiff()
+{
+    QStringList lines = QString::fromLocal8Bit(m_watchOutput).split('\n');
+    if (!lines.isEmpty() && lines.last().isEmpty()) {
+        lines.removeLast();
+    }
+
+    QString header = tr("Iteration %1 at %2 (%3)")
+                         .arg(m_watchIteration)
+                         .arg(QTime::currentTime().toString("HH:mm:ss"))
+                         .arg(m_watchReason);
+    if (m_watchIteration == 1) {
+        m_watchPreviousLines = lines;
+        ui->txtOutput->append(QString("<b>%1</b>").arg(header.toHtmlEscaped()));
+        return;
+    }
+
+    QStringList diff = WatchController::diffLines(m_watchPreviousLines, lines);
+    ui->txtOutput->clear();
+    ui->txtOutput->append(QString("<b>%1</b>").arg(header.toHtmlEscaped()));
+    if (diff.isEmpty()) {
+        ui->txtOutput->append(tr("No change since the previous iteration (%n line(s)).", nullptr, lines.size()));
+    } else {
+        QStringList html;
+        for (const QString &line : diff) {
+            QString escaped = line.toHtmlEscaped();
+            if (line.startsWith('+')) {
+                html.append(QString("<span style=\"color:green;\">%1</span>").arg(escaped));
+            } else if (line.startsWith('-')) {
+                html.append(QString("<span style=\"color:red;\">%1</span>").arg(escaped));
+            } else {
+                html.append(escaped);
+            }
+        }
+        ui->txtOutput->append("<pre>" + html.join("<br>") + "</pre>");
+    }
+    m_watchPreviousLines = lines;
+}
+
+void MainWindow::runBenchmark()
+{
+    if (m_currentCommand.isNull()) {
+        QMessageBox::warning(this, tr("Warning"), tr("No configuration loaded"));
+        return;
+    }
+
+    QString commandLine = buildCommandLine();
+    if (commandLine.isEmpty()) {
+        return;
+    }
+
+    BenchmarkDialog dialog(this);
+    dialog.setCommand(ui->cmbTopics->currentText() + "/" + m_currentCommand.name, commandLine,
+                      m_workingDirectoryLineEdit ? m_workingDirectoryLineEdit->text() : QDir::homePath());
+    setStatusBarMessage(tr("Benchmark opened for %1").arg(m_currentCommand.name));
+    dialog.exec();
 }
 
+void MainWindow::runWorkflows()
+{
+    QJsonObject workflows = m_rootConfig["workflows"].toObject();
+    if (workflows.isEmpty()) {
+        QMessageBox::information(this, tr("Workflows"),
+                                 tr("The configuration has no \"workflows\" section. See the README for how to declare one."));
+        return;
+    }
+
+    WorkflowDialog dialog(this);
+    dialog.setWorkflows(workflows, m_rootConfig["topics"].toObject());
+    // Start from a workflow of the current topic when there is one
+    for (auto it = workflows.begin(); it != workflows.end(); ++it) {
+        if (it.value().toObject()["topic"].toString() == ui->cmbTopics->currentText()) {
+            dialog.selectWorkflow(it.key());
+            break;
+        }
+    }
+    dialog.exec();
+}
 
+void MainWindow::runPipelines()
+{
+    QJsonObject pipelines = m_rootConfig["pipelines"].toObject();
+    if (pipelines.isEmpty()) {
+        QMessageBox::information(this, tr("Pipelines"),
+                                 tr("The configuration has no \"pipelines\" section. See the README for how to declare one."));
+        return;
+    }
+
+    PipelineDialog dialog(this);
+    dialog.setPipelines(pipelines, m_rootConfig["topics"].toObject());
+    for (auto it = pipelines.begin(); it != pipelines.end(); ++it) {
+        if (it.value().toObject()["topic"].toString() == ui->cmbTopics->currentText()) {
+            dialog.selectPipeline(it.key());
+            break;
+        }
+    }
+    dialog.exec();
+}
 
 void MainWindow::updateCommandLineLabel()
 
@@ -866,8 +2074,8 @@ void MainWindow::updateCommandLineLabel()
 
 void MainWindow::scrollToCurrentCommandInEditor()
 {
-    if (!m_currentConfig.isEmpty()) {
-        QString commandName = m_currentConfig["name"].toString();
+    if (!m_currentCommand.isNull()) {
+        QString commandName = m_currentCommand.name;
         if (commandName.isEmpty()) {
             return;
         }
@@ -963,6 +2171,7 @@ void MainWindow::on_tabWidget_currentChanged(int index)
     setStatusBarMessage(tr("Switched to tab: %1").arg(ui->tabWidget->tabText(index)));
     // Assuming 'Edit' tab is at index 2 (Output is 0, Help is 1)
     if (index == 2) {
+        ensureEditorLoaded();
         scrollToCurrentCommandInEditor();
         updateFileSizeLabel(); // Update file size when switching to Edit tab
     }
@@ -970,293 +2179,159 @@ void MainWindow::on_tabWidget_currentChanged(int index)
 
 
 
-QString MainWindow::buildCommandLine()
-
+QWidget *MainWindow::argumentWidget(int index) const
 {
+    return m_argumentWidgets.value(index);
+}
 
-    if (m_currentConfig.isEmpty()) {
+QString MainWindow::argumentValue(int index) const
+{
+    QWidget *fieldWidget = argumentWidget(index);
+    QString paramValue;
+    if (!fieldWidget) {
+        return paramValue;
+    }
+    if (QLineEdit *lineEdit = qobject_cast<QLineEdit*>(fieldWidget)) {
+        paramValue = lineEdit->text();
+    } else if (QListWidget *listWidget = qobject_cast<QListWidget*>(fieldWidget)) {
+        QStringList files;
+        for (int j = 0; j < listWidget->count(); ++j) {
+            files.append(listWidget->item(j)->text());
+        }
+        paramValue = CommandLine::shellQuote(files).join(' ');
+    } else if (QLineEdit *lineEdit = fieldWidget->findChild<QLineEdit*>()) {
+        paramValue = lineEdit->text();
+    }
+    return paramValue;
+}
 
+QString MainWindow::buildCommandLine(const QMap<QString, QString> &overrides, const QMap<QString, QStringList> &fileOverrides)
+{
+    if (m_currentCommand.isNull()) {
         QMessageBox::warning(this, tr("Warning"), tr("No configuration loaded"));
-
         return "";
-
-    }
-
-
-
-                QString executable = m_currentConfig["executable"].toString();
-
-
-
-                if (executable.isEmpty()) {
-
-
-
-                    QMessageBox::critical(this, tr("Error"), tr("No executable specified in configuration"));
-
-
-
-                    return "";
-
-
-
-                }
-
-
-
-            
-
-
-
-                QString commandLine = executable;
-
-
-
-    if (m_sudoCheckBox && m_sudoCheckBox->isChecked()) {
-
-        commandLine = "sudo " + commandLine;
-
     }
 
+    // Read the form into plain values, the spec applies the same rules as --run
+    CommandLine::Values values;
+    values.sudo = m_sudoCheckBox && m_sudoCheckBox->isChecked();
 
-
-    QFormLayout *formLayout = qobject_cast<QFormLayout*>(ui->scrollAreaWidgetContents->layout());
-
-    QJsonArray configArgs = m_currentConfig["arguments"].toArray();
-
-
-
-    for (const QJsonValue &value : configArgs) {
-
-        QJsonObject arg = value.toObject();
-
-        QString name = arg["name"].toString();
-
-        QString type = arg["type"].toString();
-
-        QString flag = arg["flag"].toString();
-
-        QString exclusiveGroup = arg["exclusive_group"].toString();
-
-
-
-        if (type == "boolean") {
-
-            if (!exclusiveGroup.isEmpty()) {
-
-                if (m_buttonGroups.contains(exclusiveGroup)) {
-
-                    QAbstractButton *checkedButton = m_buttonGroups[exclusiveGroup]->checkedButton();
-
-                    if (checkedButton && checkedButton->property("argFlag").toString() == flag) {
-
-                        commandLine += " " + flag;
-
-                    }
-
-                }
-
-            } else { // Non-exclusive boolean (checkbox)
-
-                QList<QCheckBox*> checkBoxes = ui->scrollAreaWidgetContents->findChildren<QCheckBox*>();
-
-                for (QCheckBox *checkBox : checkBoxes) {
-
-                    if (checkBox->property("argFlag").toString() == flag && checkBox->isChecked()) {
-
-                        commandLine += " " + flag;
-
-                        break;
-
-                    }
-
-                }
-
-            }
-
-        } else { // string, integer, file, folder
-
-            QWidget *fieldWidget = nullptr;
-
-            for (int i = 0; i < formLayout->rowCount(); ++i) {
-
-                QLayoutItem *fieldItem = formLayout->itemAt(i, QFormLayout::FieldRole);
-
-                if (fieldItem && fieldItem->widget()) {
-
-                    if (!flag.isEmpty() && fieldItem->widget()->property("argFlag").toString() == flag) {
-
-                        fieldWidget = fieldItem->widget();
-
-                        break;
-
-                    } else if (flag.isEmpty() && fieldItem->widget()->property("argName").toString() == name) {
-
-                        fieldWidget = fieldItem->widget();
-
-                        break;
-
-                    } else if (QWidget *container = qobject_cast<QWidget*>(fieldItem->widget())) {
-
-                        QLineEdit* lineEdit = container->findChild<QLineEdit*>();
-
-                        if (lineEdit) {
-
-                            if (!flag.isEmpty() && container->property("argFlag").toString() == flag) {
-
-                                fieldWidget = container;
-
-                                break;
-
-                            } else if (flag.isEmpty() && container->property("argName").toString() == name) {
-
-                                fieldWidget = container;
-
-                                break;
-
-                            }
-
-                        }
-
-                    }
-
-                }
-
+    for (int i = 0; i < m_currentCommand.arguments.size(); ++i) {
+        const ArgSpec &arg = m_currentCommand.arguments.at(i);
+        if (arg.type == ArgSpec::Boolean) {
+            // A radio button of an exclusive group or a plain checkbox
+            if (QAbstractButton *button = qobject_cast<QAbstractButton*>(argumentWidget(i))) {
+                values.booleans.insert(arg.name, button->isChecked());
             }
-
-
-
-            if (fieldWidget) {
-
-                QString paramValue;
-
-                if (QLineEdit *lineEdit = qobject_cast<QLineEdit*>(fieldWidget)) {
-
-                    paramValue = lineEdit->text();
-
-                } else if (QWidget *container = qobject_cast<QWidget*>(fieldWidget)) {
-
-                    QLineEdit* lineEdit = container->findChild<QLineEdit*>();
-
-                    if(lineEdit) {
-
-                        paramValue = lineEdit->text();
-
-                    }
-
-                } else if (QListWidget *listWidget = qobject_cast<QListWidget*>(fieldWidget)) {
-
-                    for (int j = 0; j < listWidget->count(); ++j) {
-
-                        paramValue += " " + listWidget->item(j)->text();
-
-                    }
-
-                }
-
-
-
-                if (!paramValue.isEmpty()) {
-
-                    if (!flag.isEmpty()) {
-
-                        commandLine += " " + flag;
-
-                    }
-
-                    if (type == "raw_string") {
-
-                        commandLine += " " + paramValue;
-
-                    } else {
-
-                        if (paramValue.contains(' ')) {
-
-                            commandLine += " \"" + paramValue + "\"";
-
-                        } else {
-
-                            commandLine += " " + paramValue;
-
-                        }
-
-                    }
-
+        } else if (arg.type == ArgSpec::Files) {
+            if (fileOverrides.contains(arg.name)) {
+                values.files.insert(arg.name, fileOverrides.value(arg.name));
+            } else if (QListWidget *listWidget = qobject_cast<QListWidget*>(argumentWidget(i))) {
+                QStringList files;
+                for (int j = 0; j < listWidget->count(); ++j) {
+                    files.append(listWidget->item(j)->text());
                 }
-
-            }
-
-        }
-
-        }
-
-    
-
-        QLineEdit *miscLineEdit = ui->scrollAreaWidgetContents->findChild<QLineEdit*>("miscLineEdit");
-
-        if (miscLineEdit) {
-
-            QString miscValue = miscLineEdit->text();
-
-            if (!miscValue.isEmpty()) {
-
-                commandLine += " " + miscValue;
-
+                values.files.insert(arg.name, files);
             }
-
+        } else { // string, integer, file, folder
+            values.strings.insert(arg.name, overrides.contains(arg.name) ? overrides.value(arg.name) : argumentValue(i));
         }
+    }
 
-    
-
-        return commandLine;
+    if (m_miscLineEdit) {
+        values.misc = m_miscLineEdit->text();
+    }
 
+    QString errorMessage;
+    QString commandLine = m_currentCommand.build(values, &errorMessage);
+    if (commandLine.isEmpty()) {
+        QMessageBox::critical(this, tr("Error"), errorMessage);
     }
+    return commandLine;
+}
 
 void MainWindow::on_btnBreak_clicked()
 {
-    if (m_process && m_process->state() == QProcess::Running) {
-        m_process->terminate();
-        setStatusBarMessage(tr("Process terminated."));
+    // An interrupted run is not the command's result
+    m_cacheKey.clear();
+    m_cacheOutput.clear();
+    if (m_batchPool) {
+        m_batchPool->cancel();
+        setStatusBarMessage(tr("Batches cancelled."));
+    }
+    if (m_launchedRun || (m_process && m_process->state() == QProcess::Running)) {
+        stopRun(tr("stopped"));
+    }
+}
+
+// A preset just written to the journal: added to what is loaded, without
+// reading the config again
+void MainWindow::addPreset(const QString &topic, const QJsonObject &command)
+{
+    ConfigJournal::applyPreset(&m_rootConfig, topic, command);
+    CommandSpec spec = CommandSpec::compile(command, topic);
+    int index = m_catalog.append(spec);
+    m_fuzzyIndex.add(spec);
+
+    QStringList names;
+    for (const CommandSpec &other : m_catalog.commands(topic)) {
+        names.append(other.name);
+    }
+    {
+        QSignalBlocker topicsBlocker(ui->cmbTopics);
+        QSignalBlocker commandsBlocker(ui->cmbCommands);
+        syncComboItems(ui->cmbTopics, m_catalog.topics());
+        ui->cmbTopics->setCurrentText(topic);
+        syncComboItems(ui->cmbCommands, names);
+        ui->cmbCommands->setCurrentIndex(index);
+    }
+    on_cmbCommands_currentIndexChanged(index);
+}
+
+// What a reload would make of the import, without reading the file and the
+// fragments again: its keys replace the config's, the fragments fill in under them
+void MainWindow::applyImport(const QJsonObject &config)
+{
+    ConfigJournal::applyImport(&m_rootConfig, config);
+    ConfigFragments::apply(&m_rootConfig, m_fragmentConfig);
+    if (!config.contains("topics")) {
+        return;
     }
+    m_catalog.compile(m_rootConfig.value("topics").toObject());
+    FuzzyIndex index;
+    index.build(m_catalog);
+    setFuzzyIndex(index);
+    syncCommandCombos();
 }
 
 void MainWindow::on_btnSaveCommand_clicked()
 {
     SaveCommandDialog dialog(this);
     dialog.setWidgets(ui->scrollAreaWidgetContents);
-    dialog.setCommandName(m_currentConfig["name"].toString());
+    dialog.setCommandName(m_currentCommand.name);
 
     if (dialog.exec() == QDialog::Accepted) {
         QJsonObject newCommand = dialog.getNewCommand();
         // Add the executable from the current command to the new preset
-        newCommand["executable"] = m_currentConfig["executable"].toString();
+        newCommand["executable"] = m_currentCommand.executable;
+        if (m_currentCommand.config.contains("pty")) {
+            newCommand["pty"] = m_currentCommand.pty;
+        }
+        if (m_currentCommand.config.contains("cacheable")) {
+            newCommand["cacheable"] = m_currentCommand.cacheable;
+        }
+        if (m_currentCommand.hasStdin) {
+            newCommand["stdin"] = m_currentCommand.config["stdin"];
+        }
 
         QString selectedTopic = ui->cmbTopics->currentText();
-
-        QFile file(m_currentConfigFilePath);
-        if (!file.open(QIODevice::ReadWrite | QIODevice::Text)) {
-            QMessageBox::critical(this, "Error", "Could not open config file for writing.");
+        QString errorMessage;
+        if (!m_configJournal->appendPreset(selectedTopic, newCommand, &errorMessage)) {
+            QMessageBox::critical(this, tr("Error"), errorMessage);
             return;
         }
-
-        QJsonDocument jsonDoc = QJsonDocument::fromJson(file.readAll());
-        QJsonObject rootObj = jsonDoc.object();
-        QJsonObject topicsObj = rootObj["topics"].toObject();
-        QJsonArray commandsArray = topicsObj[selectedTopic].toArray();
-
-        // Append the new command to the array
-        commandsArray.append(newCommand);
-        topicsObj[selectedTopic] = commandsArray;
-        rootObj["topics"] = topicsObj;
-
-        file.resize(0); // Clear existing content
-        file.write(QJsonDocument(rootObj).toJson(QJsonDocument::Indented));
-        file.close();
-
-        loadConfigFile(m_currentConfigFilePath);
-        // After saving and reloading, select the newly added command
-        ui->cmbTopics->setCurrentText(selectedTopic);
-        ui->cmbCommands->setCurrentText(newCommand["name"].toString());
+        addPreset(selectedTopic, newCommand);
+        setStatusBarMessage(tr("Preset \"%1\" saved").arg(newCommand["name"].toString()));
     }
 }
 
@@ -1282,29 +2357,19 @@ void MainWindow::on_btnImportJSON_clicked()
 
     QJsonObject importObject = importDoc.object();
 
-    // Assuming m_rootConfig is the currently loaded config
-    for (auto it = importObject.begin(); it != importObject.end(); ++it) {
-        m_rootConfig[it.key()] = it.value();
-    }
-
     // Save the merged configuration back to the current config file
     if (m_currentConfigFilePath.isEmpty()) {
         QMessageBox::warning(this, tr("Warning"), tr("No main configuration file loaded. Cannot save merged configuration."));
         return;
     }
 
-    QFile configFile(m_currentConfigFilePath);
-    if (!configFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        QMessageBox::critical(this, tr("Error"), tr("Could not open configuration file for writing: %1").arg(m_currentConfigFilePath));
+    QString errorMessage;
+    if (!m_configJournal->appendImport(importObject, &errorMessage)) {
+        QMessageBox::critical(this, tr("Error"), errorMessage);
         return;
     }
 
-    QJsonDocument newConfigDoc(m_rootConfig);
-    configFile.write(newConfigDoc.toJson(QJsonDocument::Indented));
-    configFile.close();
-
-    // Reload the configuration to update the UI
-    loadConfigFile(m_currentConfigFilePath);
+    applyImport(importObject);
 
     setStatusBarMessage(tr("Successfully imported and merged from %1").arg(importFilePath));
 }
@@ -1351,12 +2416,20 @@ void MainWindow::clearForm()
             if (item->widget()) {
                 if (item->widget() == m_sudoCheckBox) {
                     m_sudoCheckBox = nullptr; // Set to nullptr if it's the sudo checkbox
+                } else if (item->widget() == m_cpuCountersCheckBox) {
+                    m_cpuCountersCheckBox = nullptr;
+                } else if (item->widget() == m_bypassCacheCheckBox) {
+                    m_bypassCacheCheckBox = nullptr;
                 } else if (item->widget() == m_clearOutputCheckBox) {
                     m_clearOutputCheckBox = nullptr; // Set to nullptr if it's the clear output checkbox
                 } else if (item->widget() == m_workingDirectoryLabel) {
                     m_workingDirectoryLabel = nullptr;
                 } else if (item->widget() == m_workingDirectoryLineEdit) {
                     m_workingDirectoryLineEdit = nullptr;
+                } else if (item->widget() == m_schedulingLineEdit) {
+                    m_schedulingLineEdit = nullptr;
+                } else if (item->widget() == m_miscLineEdit) {
+                    m_miscLineEdit = nullptr;
                 } else if (item->widget() == m_themeComboBox) {
                     m_themeComboBox = nullptr;
                 }
@@ -1365,6 +2438,7 @@ void MainWindow::clearForm()
             delete item;
         }
     }
+    m_argumentWidgets.clear();
     for (QButtonGroup* group : m_buttonGroups.values()) {
         delete group;
     }
@@ -26,6 +26,13 @@
 #include <QSettings>
 #include <QListWidget>
 #include <QNetworkReply>
+#include <QPointer>
+#include <QThread>
+#include <QSharedPointer>
+#include "RunHistory.h"
+#include "CommandCatalog.h"
+#include "FuzzyIndex.h"
+#include "Scheduling.h"
 
 QT_BEGIN_NAMESPACE
 #include "CodeEditor.h"
@@ -37,6 +44,18 @@ class MainWindow;
 class JsonHighlighter;
 QT_END_NAMESPACE
 
+class ProcessPool;
+class QuishProcess;
+class LaunchedRun;
+class ResourceMonitor;
+class InstanceServer;
+class WatchController;
+class QFileSystemWatcher;
+class GroupStopper;
+class StdinFeeder;
+class CommandPalette;
+class ConfigJournal;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -45,6 +64,7 @@ public:
     ~MainWindow();
     QLabel *m_lblExitCode;
     QLabel *m_lblElapsedTime;
+    QLabel *m_lblResources;
     QTimer *m_statusBarTimer;
     QLabel *m_lblCommandStatusIcon;
 
@@ -72,32 +92,131 @@ private slots:
     void on_tabWidget_currentChanged(int index);
     void clearStatusBarMessage();
     void on_btnImportJSON_clicked();
+    void runSweep();
+    void runBenchmark();
+    void toggleWatch(bool checked);
+    void runWorkflows();
+    void runPipelines();
+    void rerunFromHistory(const RunHistory::Entry &entry);
 private:
-    QString buildCommandLine();
+    QString buildCommandLine(const QMap<QString, QString> &overrides = QMap<QString, QString>(),
+                             const QMap<QString, QStringList> &fileOverrides = QMap<QString, QStringList>());
+    QWidget *argumentWidget(int index) const;
+    QString argumentValue(int index) const;
+    bool runWithLauncher(const QString &commandLine);
+    void prepareRun(const QString &commandLine);
+    void appendOutput(const QByteArray &data);
+    void appendDiagnostic(const QString &text);
+    void finishRun(int exitCode, const QString &runDetails = QString());
+    void runStarted(qint64 pid);
+    void stopRun(const QString &reason);
+    QString reapRunGroup();
+    QListWidget *batchedFilesWidget() const;
+    QStringList inputFiles() const;
+    QStringList watchedPaths() const;
+    void runWatchIteration(const QString &reason);
+    void showWatchDiff();
+    bool prepareScheduling(QSharedPointer<const Scheduling::Prepared> *prepared, QStringList *warnings);
+    void runBatched(QListWidget *listWidget, const QSharedPointer<const Scheduling::Prepared> &scheduling,
+                    const QStringList &schedulingWarnings);
     void createTrayIcon();
     void destroyTrayIcon();
+    // A config read and compiled off the GUI thread, applied on it
+    struct LoadedConfig {
+        QString filePath;
+        QByteArray data;
+        QJsonObject root;
+        CommandCatalog catalog;
+        FuzzyIndex fuzzyIndex;
+        QString errorMessage;
+        QStringList warnings;           // conf.d fragments that were skipped
+        QByteArray stamp;               // of the file and its fragments when they were read
+        QByteArray fileStamp;           // of the file alone, for the editor
+        qint64 journalRecordId = 0;     // the last preset or import record replayed
+        QJsonObject fragments;          // conf.d merged, for imports applied in memory
+        bool ok = false;
+    };
+    static void readConfig(LoadedConfig *config);
+    bool applyConfig(const LoadedConfig &config);
+    bool updateConfig(const LoadedConfig &config);
+    void setFuzzyIndex(const FuzzyIndex &index);
+    void addPreset(const QString &topic, const QJsonObject &command);
+    void applyImport(const QJsonObject &config);
+    void syncCommandCombos();
     bool loadConfigFile(const QString &filePath);
-    void buildUi(const QJsonObject &config);
+    bool reloadConfigFile();
+    void loadConfigFileInBackground(const QString &filePath, bool incremental = false);
+    void watchConfigFile(const QString &filePath);
+    void ensureEditorLoaded();
+    void buildUi(const CommandSpec &command);
     void clearForm();
     void applyTheme(const QString &themeName);
     void closeEvent(QCloseEvent *event) override;
     void setStatusBarMessage(const QString &message);
 
     void scrollToCurrentCommandInEditor();
+    QJsonObject handleInstanceRequest(const QJsonObject &request);
+    bool selectCommand(const QString &target, QString *errorMessage);
 
     Ui::MainWindow *ui;
     QJsonObject m_rootConfig;
-    QJsonObject m_currentConfig;
-    QProcess *m_process;
+    QJsonObject m_fragmentConfig;       // what the conf.d fragments add, see ConfigFragments::load()
+    QPointer<QThread> m_configLoader;
+    int m_configLoad = 0;               // bumped per load, a late background result is dropped
+    bool m_configLoading = false;       // a full load is on its way, reloads wait for it
+    QFileSystemWatcher *m_configWatcher = nullptr;
+    QTimer *m_configReloadTimer = nullptr;
+    ConfigJournal *m_configJournal = nullptr;
+    QByteArray m_configStamp;           // of the files as last loaded, to skip our own writes
+    QByteArray m_editorData;            // config text not yet in the editor
+    bool m_editorLoaded = true;
+    QByteArray m_editorStamp;           // of the file the editor text came from
+    CommandCatalog m_catalog;
+    CommandSpec m_currentCommand;
+    FuzzyIndex m_fuzzyIndex;
+    CommandPalette *m_commandPalette = nullptr;
+    QVector<QWidget*> m_argumentWidgets;    // by argument index, null for types without a widget
+    QuishProcess *m_process;
+    ProcessPool *m_batchPool;
+    LaunchedRun *m_launchedRun;
+    ResourceMonitor *m_resourceMonitor;
+    InstanceServer *m_instanceServer = nullptr;
+    int m_runId = 0;
+    qint64 m_runGroup = -1;
+    QString m_stopReason;
+    GroupStopper *m_groupStopper = nullptr;
+    QTimer *m_runTimeout = nullptr;
+    StdinFeeder *m_stdinFeeder = nullptr;
+    int m_outputSpool = -1;
+    RunHistory *m_runHistory = nullptr;
+    RunHistory::Entry m_historyEntry;
+    bool m_recordRun = false;
+    QString m_replayCommandLine;
+    int m_nextBatchToFlush = 0;
+    QString m_cacheKey;
+    QByteArray m_cacheOutput;
     QElapsedTimer m_timer;
     QLabel *m_statusLabel;
     QPushButton *m_btnBreak;
+    QPushButton *m_btnSweep;
+    QPushButton *m_btnBenchmark;
+    QPushButton *m_btnWatch = nullptr;
+    QPushButton *m_btnWorkflows;
+    QPushButton *m_btnPipelines;
+    WatchController *m_watchController = nullptr;
+    int m_watchIteration = 0;
+    bool m_watchRunActive = false;
+    QString m_watchReason;
+    QString m_watchPendingReason;
+    QByteArray m_watchOutput;
+    QStringList m_watchPreviousLines;
     QMap<QString, QButtonGroup*> m_buttonGroups;
     QMap<QString, QList<QWidget*>> m_exclusiveGroupWidgets;
     QString m_currentConfigFilePath;
     QAction *m_runAction;
     QAction *m_breakAction;
     QAction *m_saveAction;
+    QAction *m_paletteAction;
     QAction *m_helpAction;
     QAction *m_quitAction_2;
     JsonHighlighter *m_highlighter;
@@ -108,9 +227,13 @@ private:
     bool m_isQuitting = false;
     Settings m_appSettings;
     QCheckBox *m_sudoCheckBox;
+    QCheckBox *m_cpuCountersCheckBox;
+    QCheckBox *m_bypassCacheCheckBox;
     QCheckBox *m_clearOutputCheckBox;
     QLabel *m_workingDirectoryLabel;
     QLineEdit *m_workingDirectoryLineEdit;
+    QLineEdit *m_schedulingLineEdit;
+    QLineEdit *m_miscLineEdit;
     QComboBox *m_themeComboBox;
     QTextEdit *m_txtHelp;
     QLineEdit *lblCommand;
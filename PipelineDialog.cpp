@@ -0,0 +1,381 @@
+#include "PipelineDialog.h"
+#include "PipelineRunner.h"
+#include "CommandLine.h"
+#include "Scheduling.h"
+#include "ResourceMonitor.h"
+#include "ArgumentForm.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QScrollArea>
+#include <QHeaderView>
+#include <QButtonGroup>
+#include <QFontDatabase>
+#include <QJsonArray>
+#include <QDir>
+#include <QTimer>
+
+static const QColor BOTTLENECK_COLOR(255, 214, 160);
+
+enum StatsColumn {
+    StageColumn,
+    InColumn,
+    OutColumn,
+    ThroughputColumn,
+    BlockedColumn,
+    CpuColumn,
+    TimeColumn,
+    ExitColumn,
+    ColumnCount
+};
+
+PipelineDialog::PipelineDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_refreshTimer(new QTimer(this))
+    , m_runner(new PipelineRunner(this))
+{
+    setWindowTitle(tr("Pipelines"));
+    setMinimumSize(900, 650);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *controlsLayout = new QHBoxLayout();
+    controlsLayout->addWidget(new QLabel(tr("Pipeline:"), this));
+    m_pipelineComboBox = new QComboBox(this);
+    controlsLayout->addWidget(m_pipelineComboBox);
+    controlsLayout->addWidget(new QLabel(tr("Show output of:"), this));
+    m_tapComboBox = new QComboBox(this);
+    controlsLayout->addWidget(m_tapComboBox);
+    controlsLayout->addStretch();
+    m_lblProgress = new QLabel(this);
+    controlsLayout->addWidget(m_lblProgress);
+    m_btnStart = new QPushButton(QIcon(":/icons/Player Play.png"), tr("Start"), this);
+    m_btnStop = new QPushButton(QIcon(":/icons/Player Stop.png"), tr("Stop"), this);
+    m_btnStop->setEnabled(false);
+    controlsLayout->addWidget(m_btnStart);
+    controlsLayout->addWidget(m_btnStop);
+    mainLayout->addLayout(controlsLayout);
+
+    m_stageTabs = new QTabWidget(this);
+    mainLayout->addWidget(m_stageTabs, 2);
+
+    m_statsTable = new QTableWidget(0, ColumnCount, this);
+    m_statsTable->setHorizontalHeaderLabels({ tr("Stage"), tr("In"), tr("Out"), tr("Throughput"),
+                                              tr("Input backed up"), tr("CPU"), tr("Time"), tr("Exit") });
+    m_statsTable->horizontalHeader()->setSectionResizeMode(StageColumn, QHeaderView::Stretch);
+    m_statsTable->verticalHeader()->setVisible(false);
+    m_statsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_statsTable->setSelectionMode(QAbstractItemView::NoSelection);
+    mainLayout->addWidget(m_statsTable, 1);
+
+    m_lblBottleneck = new QLabel(this);
+    m_lblBottleneck->setWordWrap(true);
+    mainLayout->addWidget(m_lblBottleneck);
+
+    QTabWidget *outputTabs = new QTabWidget(this);
+    m_outputText = new QPlainTextEdit(this);
+    m_outputText->setReadOnly(true);
+    m_outputText->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    // The tap can carry far more than a view should hold; keep the tail
+    m_outputText->setMaximumBlockCount(10000);
+    outputTabs->addTab(m_outputText, tr("Output"));
+    m_errorsText = new QPlainTextEdit(this);
+    m_errorsText->setReadOnly(true);
+    m_errorsText->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    outputTabs->addTab(m_errorsText, tr("Errors"));
+    mainLayout->addWidget(outputTabs, 2);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+
+    m_refreshTimer->setInterval(200);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PipelineDialog::updateStats);
+
+    connect(m_pipelineComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &PipelineDialog::onPipelineChanged);
+    connect(m_btnStart, &QPushButton::clicked, this, &PipelineDialog::onStartClicked);
+    connect(m_btnStop, &QPushButton::clicked, this, &PipelineDialog::onStopClicked);
+    connect(m_runner, &PipelineRunner::stageChanged, this, &PipelineDialog::updateStats);
+    connect(m_runner, &PipelineRunner::finished, this, &PipelineDialog::onFinished);
+    connect(m_runner, &PipelineRunner::tapOutput, this, [this](const QByteArray &data) {
+        m_outputText->moveCursor(QTextCursor::End);
+        m_outputText->insertPlainText(QString::fromLocal8Bit(data));
+    });
+}
+
+void PipelineDialog::setPipelines(const QJsonObject &pipelines, const QJsonObject &topics)
+{
+    m_pipelines = pipelines;
+    m_topics = topics;
+    m_pipelineComboBox->blockSignals(true);
+    m_pipelineComboBox->clear();
+    m_pipelineComboBox->addItems(pipelines.keys());
+    m_pipelineComboBox->blockSignals(false);
+    onPipelineChanged(m_pipelineComboBox->currentIndex());
+}
+
+void PipelineDialog::selectPipeline(const QString &name)
+{
+    int index = m_pipelineComboBox->findText(name);
+    if (index >= 0) {
+        m_pipelineComboBox->setCurrentIndex(index);
+    }
+}
+
+void PipelineDialog::reject()
+{
+    m_refreshTimer->stop();
+    m_runner->disconnect(this);
+    m_runner->cancel();
+    QDialog::reject();
+}
+
+void PipelineDialog::onPipelineChanged(int index)
+{
+    clearForms();
+    m_outputText->clear();
+    m_errorsText->clear();
+    m_lblBottleneck->clear();
+    m_lblProgress->setStyleSheet(QString());
+    m_lblProgress->clear();
+    m_btnStart->setEnabled(false);
+    if (index < 0) {
+        return;
+    }
+
+    QJsonObject pipeline = m_pipelines[m_pipelineComboBox->itemText(index)].toObject();
+    const QJsonArray stages = pipeline["stages"].toArray();
+    if (stages.isEmpty()) {
+        m_lblProgress->setStyleSheet("color: red;");
+        m_lblProgress->setText(tr("The pipeline has no stages"));
+        return;
+    }
+
+    m_forms.resize(stages.size());
+    for (int i = 0; i < stages.size(); ++i) {
+        QString errorMessage;
+        QWidget *page = buildForm(&m_forms[i], stages[i].toObject(), pipeline, &errorMessage);
+        if (!page) {
+            clearForms();
+            m_lblProgress->setStyleSheet("color: red;");
+            m_lblProgress->setText(tr("Stage %1: %2").arg(i + 1).arg(errorMessage));
+            return;
+        }
+        QString title = QString("%1. %2").arg(i + 1).arg(m_forms[i].command["name"].toString());
+        m_stageTabs->addTab(page, title);
+        m_tapComboBox->addItem(title);
+    }
+    // The last stage is what a shell would print
+    int tap = pipeline["tap"].toInt(stages.size());
+    m_tapComboBox->setCurrentIndex(qBound(1, tap, stages.size()) - 1);
+
+    m_statsTable->setRowCount(stages.size());
+    for (int i = 0; i < stages.size(); ++i) {
+        for (int column = 0; column < ColumnCount; ++column) {
+            m_statsTable->setItem(i, column, new QTableWidgetItem());
+        }
+        m_statsTable->item(i, StageColumn)->setText(m_tapComboBox->itemText(i));
+    }
+    m_btnStart->setEnabled(true);
+}
+
+// Resolves the stage's command like workflow nodes do and lays out its arguments
+QWidget *PipelineDialog::buildForm(StageForm *form, const QJsonObject &stage, const QJsonObject &pipeline,
+                                   QString *errorMessage)
+{
+    form->name = stage["command"].toString();
+    QString topic = pipeline["topic"].toString();
+    if (!CommandLine::findCommand(m_topics, form->name, &form->command)
+        && (topic.isEmpty() || !CommandLine::findCommand(m_topics, topic + "/" + form->name, &form->command))) {
+        *errorMessage = tr("no command \"%1\"").arg(form->name);
+        return nullptr;
+    }
+    CommandLine::Values values = CommandLine::defaults(form->command);
+    if (!CommandLine::setValues(form->command, stage["set"].toObject(), &values, errorMessage)) {
+        return nullptr;
+    }
+
+    QScrollArea *scrollArea = new QScrollArea(this);
+    scrollArea->setWidgetResizable(true);
+    QWidget *page = new QWidget(scrollArea);
+    QFormLayout *layout = new QFormLayout(page);
+    QMap<QString, QButtonGroup*> buttonGroups;
+
+    form->spec = CommandSpec::compile(form->command);
+    for (const ArgSpec &arg : form->spec.arguments) {
+        QWidget *field = ArgumentForm::addRow(layout, page, arg, &buttonGroups, []() {});
+        ArgumentForm::setValue(field, arg, values);
+        form->fields.append(field);
+    }
+
+    form->misc = new QLineEdit(stage["misc"].toString(), page);
+    layout->addRow(tr("Misc"), form->misc);
+    QString workingDirectory = stage["working_directory"].toString(
+        form->command.value("working_directory").toString(pipeline["working_directory"].toString()));
+    form->workingDirectory = new QLineEdit(workingDirectory.isEmpty() ? QDir::homePath() : workingDirectory, page);
+    layout->addRow(tr("Working directory"), form->workingDirectory);
+
+    scrollArea->setWidget(page);
+    return scrollArea;
+}
+
+QString PipelineDialog::formCommandLine(const StageForm &form, QString *errorMessage) const
+{
+    CommandLine::Values values = CommandLine::defaults(form.command);
+    for (int i = 0; i < form.fields.size(); ++i) {
+        ArgumentForm::value(form.fields.at(i), form.spec.arguments.at(i), &values);
+    }
+    values.misc = form.misc->text();
+    return CommandLine::build(form.command, values, errorMessage);
+}
+
+void PipelineDialog::clearForms()
+{
+    m_forms.clear();
+    while (m_stageTabs->count() > 0) {
+        QWidget *page = m_stageTabs->widget(0);
+        m_stageTabs->removeTab(0);
+        delete page;
+    }
+    m_tapComboBox->clear();
+    m_statsTable->setRowCount(0);
+}
+
+void PipelineDialog::onStartClicked()
+{
+    m_runner->clear();
+    m_schedulingWarnings.clear();
+    for (int i = 0; i < m_forms.size(); ++i) {
+        QString errorMessage;
+        QString commandLine = formCommandLine(m_forms[i], &errorMessage);
+        QSharedPointer<Scheduling::Prepared> scheduling;
+        QJsonObject settings = m_forms[i].command.value("scheduling").toObject();
+        QStringList warnings;
+        if (!commandLine.isEmpty() && !settings.isEmpty()) {
+            scheduling.reset(new Scheduling::Prepared);
+            if (!Scheduling::prepare(settings, scheduling.data(), &warnings, &errorMessage)) {
+                commandLine.clear();
+            }
+        }
+        if (commandLine.isEmpty()) {
+            m_lblProgress->setStyleSheet("color: red;");
+            m_lblProgress->setText(tr("Stage %1: %2").arg(i + 1).arg(errorMessage));
+            return;
+        }
+        for (const QString &warning : warnings) {
+            m_schedulingWarnings.append(tr("Stage %1: %2").arg(i + 1).arg(warning));
+        }
+        m_runner->addStage(m_forms[i].name, commandLine, CommandLine::expandHome(m_forms[i].workingDirectory->text()), scheduling);
+    }
+    m_runner->setTap(m_tapComboBox->currentIndex());
+
+    m_outputText->clear();
+    m_errorsText->clear();
+    for (const QString &warning : m_schedulingWarnings) {
+        m_errorsText->appendPlainText(tr("Scheduling: %1").arg(warning));
+    }
+    m_lblProgress->setStyleSheet(QString());
+    QString errorMessage;
+    if (!m_runner->start(&errorMessage)) {
+        m_lblProgress->setStyleSheet("color: red;");
+        m_lblProgress->setText(errorMessage);
+        return;
+    }
+    m_pipelineComboBox->setEnabled(false);
+    m_tapComboBox->setEnabled(false);
+    m_stageTabs->setEnabled(false);
+    m_btnStart->setEnabled(false);
+    m_btnStop->setEnabled(true);
+    m_refreshTimer->start();
+    updateStats();
+}
+
+void PipelineDialog::onStopClicked()
+{
+    m_btnStop->setEnabled(false);
+    m_runner->cancel();
+}
+
+void PipelineDialog::onFinished(bool succeeded)
+{
+    m_refreshTimer->stop();
+    m_pipelineComboBox->setEnabled(true);
+    m_tapComboBox->setEnabled(true);
+    m_stageTabs->setEnabled(true);
+    m_btnStart->setEnabled(true);
+    m_btnStop->setEnabled(false);
+    updateStats();
+    if (!succeeded) {
+        m_lblProgress->setStyleSheet("color: red;");
+    }
+
+    // stderr is not part of the pipeline; it is shown per stage once the run is over
+    m_errorsText->clear();
+    for (const QString &warning : m_schedulingWarnings) {
+        m_errorsText->appendPlainText(tr("Scheduling: %1").arg(warning));
+    }
+    for (int i = 0; i < m_runner->stageCount(); ++i) {
+        const PipelineRunner::Stage &stage = m_runner->stage(i);
+        if (!stage.errors.isEmpty()) {
+            m_errorsText->appendPlainText(QString("== %1. %2 ==\n%3").arg(i + 1).arg(stage.name,
+                                                                          QString::fromLocal8Bit(stage.errors)));
+        }
+    }
+}
+
+void PipelineDialog::updateStats()
+{
+    const int count = qMin(m_runner->stageCount(), m_statsTable->rowCount());
+    const int slowest = m_runner->bottleneck();
+    int running = 0;
+    for (int i = 0; i < count; ++i) {
+        const PipelineRunner::Stage &stage = m_runner->stage(i);
+        qint64 timeMs = m_runner->stageTimeMs(i);
+        m_statsTable->item(i, InColumn)->setText(i > 0 ? ResourceMonitor::formatBytes(m_runner->bytesIn(i)) : QString());
+        m_statsTable->item(i, OutColumn)->setText(ResourceMonitor::formatBytes(m_runner->bytesOut(i)));
+        m_statsTable->item(i, ThroughputColumn)->setText(
+            timeMs > 0 ? tr("%1/s").arg(ResourceMonitor::formatBytes(m_runner->bytesOut(i) * 1000 / timeMs)) : QString());
+        m_statsTable->item(i, BlockedColumn)->setText(
+            i > 0 && timeMs > 0 ? QString("%1%").arg(qMin<qint64>(100, m_runner->inputBlockedMs(i) * 100 / timeMs)) : QString());
+        if (stage.hasUsage && stage.elapsedMs > 0) {
+            double cpuMs = (stage.usage.ru_utime.tv_sec + stage.usage.ru_stime.tv_sec) * 1000.0
+                           + (stage.usage.ru_utime.tv_usec + stage.usage.ru_stime.tv_usec) / 1000.0;
+            m_statsTable->item(i, CpuColumn)->setText(QString("%1%").arg(cpuMs * 100 / stage.elapsedMs, 0, 'f', 0));
+        } else {
+            m_statsTable->item(i, CpuColumn)->setText(QString());
+        }
+        m_statsTable->item(i, TimeColumn)->setText(stage.started || stage.finished ? ResourceMonitor::formatMs(timeMs) : QString());
+
+        QString exit;
+        if (stage.finished) {
+            exit = stage.exitCode >= 0 ? QString::number(stage.exitCode) : tr("killed");
+        } else if (stage.started) {
+            exit = tr("running");
+            running++;
+        }
+        m_statsTable->item(i, ExitColumn)->setText(exit);
+        m_statsTable->item(i, ExitColumn)->setForeground(stage.finished && stage.exitCode != 0 ? QColor(Qt::red) : QColor(Qt::black));
+
+        for (int column = 0; column < ColumnCount; ++column) {
+            m_statsTable->item(i, column)->setBackground(i == slowest && m_runner->elapsedMs() > 0 ? BOTTLENECK_COLOR : QColor(Qt::white));
+        }
+    }
+
+    if (m_runner->elapsedMs() <= 0 || count == 0) {
+        return;
+    }
+    QString progress = tr("%1 of %2 stages running - %3").arg(running).arg(count).arg(ResourceMonitor::formatMs(m_runner->elapsedMs()));
+    if (!m_runner->isRunning()) {
+        progress = tr("Finished in %1, exit code %2").arg(ResourceMonitor::formatMs(m_runner->elapsedMs())).arg(m_runner->stage(count - 1).exitCode);
+    }
+    m_lblProgress->setText(progress);
+
+    if (slowest == 0) {
+        m_lblBottleneck->setText(tr("Bottleneck: %1, the first stage; the ones after it keep up with what it produces")
+                                     .arg(m_statsTable->item(0, StageColumn)->text()));
+    } else {
+        m_lblBottleneck->setText(tr("Bottleneck: %1; its input was backed up %2 of the time, so the stages before it wait for it")
+                                     .arg(m_statsTable->item(slowest, StageColumn)->text(), m_statsTable->item(slowest, BlockedColumn)->text()));
+    }
+}
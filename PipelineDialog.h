@@ -0,0 +1,77 @@
+#ifndef PIPELINEDIALOG_H
+#define PIPELINEDIALOG_H
+
+#include <QDialog>
+#include <QJsonObject>
+#include <QMap>
+#include <QVector>
+#include <QComboBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPlainTextEdit>
+#include <QTabWidget>
+#include <QTableWidget>
+#include "CommandCatalog.h"
+
+class QTimer;
+class PipelineRunner;
+
+// Runs the pipelines of the config: a form per stage, the tapped stage's
+// output, and per-stage bytes, throughput and exit codes to find the one
+// that holds the chain up
+class PipelineDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit PipelineDialog(QWidget *parent = nullptr);
+
+    // pipelines is the "pipelines" object of the config, by name
+    void setPipelines(const QJsonObject &pipelines, const QJsonObject &topics);
+    void selectPipeline(const QString &name);
+
+public slots:
+    void reject() override;
+
+private slots:
+    void onPipelineChanged(int index);
+    void onStartClicked();
+    void onStopClicked();
+    void onFinished(bool succeeded);
+
+private:
+    // The generated form of one stage, the same widgets the main window uses
+    struct StageForm {
+        QString name;
+        QJsonObject command;
+        CommandSpec spec;
+        QVector<QWidget*> fields;           // by argument index
+        QLineEdit *misc = nullptr;
+        QLineEdit *workingDirectory = nullptr;
+    };
+
+    QWidget *buildForm(StageForm *form, const QJsonObject &stage, const QJsonObject &pipeline, QString *errorMessage);
+    QString formCommandLine(const StageForm &form, QString *errorMessage) const;
+    void clearForms();
+    void updateStats();
+
+    QComboBox *m_pipelineComboBox;
+    QComboBox *m_tapComboBox;
+    QPushButton *m_btnStart;
+    QPushButton *m_btnStop;
+    QLabel *m_lblProgress;
+    QTabWidget *m_stageTabs;
+    QTableWidget *m_statsTable;
+    QLabel *m_lblBottleneck;
+    QPlainTextEdit *m_outputText;
+    QPlainTextEdit *m_errorsText;
+    QTimer *m_refreshTimer;
+    PipelineRunner *m_runner;
+    QJsonObject m_pipelines;
+    QJsonObject m_topics;
+    QVector<StageForm> m_forms;
+    QStringList m_schedulingWarnings;   // of the stages of the current run
+};
+
+#endif // PIPELINEDIALOG_H
@@ -0,0 +1,477 @@
+#include "PipelineRunner.h"
+#include "QuishProcess.h"
+#include "Launcher.h"
+
+#include <QSocketNotifier>
+#include <QThread>
+#include <QTimer>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 1024 * 1024;
+const int PIPE_SIZE = 1024 * 1024;
+
+int available(int fd)
+{
+    int size = 0;
+    return ioctl(fd, FIONREAD, &size) == 0 ? size : 0;
+}
+
+void closeFd(int *fd)
+{
+    if (*fd >= 0) {
+        ::close(*fd);
+        *fd = -1;
+    }
+}
+
+}
+
+PipelineRunner::PipelineRunner(QObject *parent)
+    : QObject(parent)
+{
+}
+
+PipelineRunner::~PipelineRunner()
+{
+    m_cancelled = true;
+    for (const Stage &stage : m_stages) {
+        if (stage.process && stage.started && !stage.finished) {
+            stage.process->killGroup();
+        }
+    }
+    if (m_relayThread) {
+        m_relayThread->wait();
+    }
+    closeAll();
+}
+
+void PipelineRunner::clear()
+{
+    if (m_running) {
+        return;
+    }
+    closeAll();
+    for (Stage &stage : m_stages) {
+        delete stage.process;
+    }
+    m_stages.clear();
+    m_tap = -1;
+}
+
+void PipelineRunner::addStage(const QString &name, const QString &commandLine, const QString &workingDirectory,
+                              const QSharedPointer<const Scheduling::Prepared> &scheduling)
+{
+    Stage stage;
+    stage.name = name;
+    stage.commandLine = commandLine;
+    stage.workingDirectory = workingDirectory;
+    stage.scheduling = scheduling;
+    memset(&stage.usage, 0, sizeof(stage.usage));
+    m_stages.append(stage);
+}
+
+bool PipelineRunner::start(QString *errorMessage)
+{
+    if (m_running || m_stages.isEmpty()) {
+        return false;
+    }
+    closeAll();
+    const int count = m_stages.size();
+    const int tapStage = tap();
+
+    // Every pipe first: the children must not start until all of them exist
+    int tapFds[2] = { -1, -1 };
+    bool piped = pipe2(tapFds, O_CLOEXEC | O_NONBLOCK) == 0;
+    m_tapRead = tapFds[0];
+    m_childStdin.fill(-1, count);
+    m_childStdout.fill(-1, count);
+    for (int i = 0; i < count; ++i) {
+        Link *link = new Link;
+        m_links.append(link);
+        int out[2] = { -1, -1 };
+        piped = piped && pipe2(out, O_CLOEXEC) == 0;
+        link->source = out[0];
+        m_childStdout[i] = out[1];
+        if (i + 1 < count) {
+            int in[2] = { -1, -1 };
+            piped = piped && pipe2(in, O_CLOEXEC) == 0;
+            m_childStdin[i + 1] = in[0];
+            link->destination = in[1];
+        } else if (i == tapStage) {
+            link->destination = tapFds[1];
+        } else {
+            link->destination = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+        }
+        if (i == tapStage && i + 1 < count) {
+            link->tee = tapFds[1];
+        }
+        // Only Quish's ends are non-blocking, the commands see ordinary pipes
+        for (int fd : { link->source, link->destination }) {
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                fcntl(fd, F_SETPIPE_SZ, PIPE_SIZE);
+            }
+        }
+    }
+    if (!piped) {
+        *errorMessage = tr("Cannot create the pipes: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        closeAll();
+        return false;
+    }
+
+    m_cancelled = false;
+    m_stagesDone = false;
+    m_running = true;
+    m_totalMs = 0;
+    m_timer.start();
+    for (int i = 0; i < count; ++i) {
+        Stage &stage = m_stages[i];
+        delete stage.process;
+        stage.process = new QuishProcess(this);
+        stage.exitCode = -1;
+        stage.started = false;
+        stage.finished = false;
+        stage.startMs = -1;
+        stage.elapsedMs = 0;
+        stage.hasUsage = false;
+        stage.errors.clear();
+
+        QuishProcess *process = stage.process;
+        process->setCollectResourceUsage(true);
+        if (stage.scheduling) {
+            process->setScheduling(*stage.scheduling);
+        }
+        if (m_childStdin[i] >= 0) {
+            process->setStdinDescriptor(m_childStdin[i]);
+        }
+        process->setStdoutDescriptor(m_childStdout[i]);
+        process->setWorkingDirectory(stage.workingDirectory);
+        connect(process, &QProcess::started, this, [this, i]() {
+            m_stages[i].started = true;
+            m_stages[i].startMs = m_timer.elapsed();
+            closeChildEnds(i);
+            emit stageChanged(i);
+        });
+        connect(process, &QProcess::readyReadStandardError, this, [this, i]() {
+            m_stages[i].errors.append(m_stages[i].process->readAllStandardError());
+        });
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+                [this, i](int exitCode, QProcess::ExitStatus exitStatus) {
+                    onStageFinished(i, exitStatus == QProcess::NormalExit ? exitCode : -1);
+                });
+        connect(process, &QProcess::errorOccurred, this, [this, i](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                m_stages[i].errors.append(m_stages[i].process->errorString().toLocal8Bit() + "\n");
+                closeChildEnds(i);
+                onStageFinished(i, 127);
+            }
+        });
+
+        // No shell for the pipe itself; a stage only gets one if its own line needs it
+        QStringList arguments = Launcher::argumentsFor(stage.commandLine);
+        process->start(arguments.first(), arguments.mid(1));
+        if (i == 0) {
+            process->closeWriteChannel();
+        }
+    }
+
+    m_tapNotifier = new QSocketNotifier(m_tapRead, QSocketNotifier::Read, this);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    connect(m_tapNotifier, QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated),
+            this, &PipelineRunner::readTap);
+#else
+    connect(m_tapNotifier, &QSocketNotifier::activated, this, &PipelineRunner::readTap);
+#endif
+
+    m_relayThread = QThread::create([this]() { relay(); });
+    connect(m_relayThread, &QThread::finished, this, [this]() {
+        readTap();
+        checkFinished();
+    });
+    m_relayThread->start();
+    return true;
+}
+
+void PipelineRunner::cancel()
+{
+    if (!m_running) {
+        return;
+    }
+    m_cancelled = true;
+    for (const Stage &stage : m_stages) {
+        if (stage.process && stage.started && !stage.finished) {
+            stage.process->terminateGroup();
+        }
+    }
+    QTimer::singleShot(3000, this, [this]() {
+        if (!m_running || !m_cancelled) {
+            return;
+        }
+        for (const Stage &stage : m_stages) {
+            if (stage.process && stage.started && !stage.finished) {
+                stage.process->killGroup();
+            }
+        }
+    });
+}
+
+qint64 PipelineRunner::stageTimeMs(int index) const
+{
+    const Stage &stage = m_stages.at(index);
+    if (stage.started && !stage.finished) {
+        return m_timer.elapsed() - stage.startMs;
+    }
+    return stage.elapsedMs;
+}
+
+qint64 PipelineRunner::elapsedMs() const
+{
+    return m_running ? m_timer.elapsed() : m_totalMs;
+}
+
+qint64 PipelineRunner::bytesOut(int index) const
+{
+    return index < m_links.size() ? m_links.at(index)->bytes.load() : 0;
+}
+
+qint64 PipelineRunner::bytesIn(int index) const
+{
+    return index > 0 ? bytesOut(index - 1) : 0;
+}
+
+qint64 PipelineRunner::inputBlockedMs(int index) const
+{
+    if (index <= 0 || index > m_links.size()) {
+        return 0;
+    }
+    const Link *link = m_links.at(index - 1);
+    qint64 since = link->blockedSince;
+    qint64 ongoing = since >= 0 && m_running ? m_timer.elapsed() - since : 0;
+    return link->blockedMs + ongoing;
+}
+
+int PipelineRunner::bottleneck() const
+{
+    // Everything before the slow stage waits on it, everything after it waits for it
+    int slowest = 0;
+    for (int i = 1; i < m_stages.size(); ++i) {
+        qint64 time = stageTimeMs(i);
+        if (time > 0 && inputBlockedMs(i) * 2 > time) {
+            slowest = i;
+        }
+    }
+    return slowest;
+}
+
+// Relay thread: moves the data of every link until they are all closed
+void PipelineRunner::relay()
+{
+    // A stage that exits early gives EPIPE here, not a dead Quish
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+
+    QVector<struct pollfd> fds;
+    while (!m_cancelled) {
+        fds.clear();
+        for (Link *link : m_links) {
+            struct pollfd wait;
+            wait.revents = 0;
+            if (!link->done && transfer(link, &wait.fd, &wait.events)) {
+                fds.append(wait);
+            }
+        }
+        if (fds.isEmpty()) {
+            break;
+        }
+        // Short timeout so a cancel, or the end of the last stage, is noticed
+        poll(fds.data(), fds.size(), 100);
+    }
+
+    for (Link *link : m_links) {
+        closeLink(link);
+    }
+    struct timespec immediately = { 0, 0 };
+    while (sigtimedwait(&pipeSignal, nullptr, &immediately) > 0) {
+    }
+}
+
+// Moves what the stage has written so far; false once the link is closed,
+// otherwise the descriptor and event to wait for before the next try
+bool PipelineRunner::transfer(Link *link, int *waitFd, short *waitEvents)
+{
+    for (int round = 0; round < 16; ++round) {
+        if (link->tee >= 0 && link->pendingTeed == 0) {
+            ssize_t teed = tee(link->source, link->tee, CHUNK_SIZE, SPLICE_F_NONBLOCK);
+            if (teed > 0) {
+                link->pendingTeed = teed;
+            } else if (teed < 0 && errno == EAGAIN && available(link->source) > 0) {
+                // The view is behind: wait for it rather than drop what it shows
+                *waitFd = link->tee;
+                *waitEvents = POLLOUT;
+                return true;
+            } else if (teed < 0 && errno == EPIPE) {
+                closeFd(&link->tee);
+            }
+            // Otherwise the source is empty or at its end, which the splice tells
+        }
+
+        qint64 size = link->pendingTeed > 0 ? link->pendingTeed : CHUNK_SIZE;
+        ssize_t moved = splice(link->source, nullptr, link->destination, nullptr, size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved > 0) {
+            link->bytes += moved;
+            link->pendingTeed = qMax<qint64>(0, link->pendingTeed - moved);
+            setBlocked(link, false);
+            continue;
+        }
+        if (moved < 0 && errno == EINTR) {
+            continue;
+        }
+        if (moved < 0 && errno == EAGAIN) {
+            bool backedUp = available(link->source) > 0;
+            setBlocked(link, backedUp);
+            if (!backedUp && m_stagesDone) {
+                // Only a leftover child of a finished stage could still write here
+                closeLink(link);
+                return false;
+            }
+            *waitFd = backedUp ? link->destination : link->source;
+            *waitEvents = backedUp ? POLLOUT : POLLIN;
+            return true;
+        }
+        // The end of the stage's output, or EPIPE: the next stage is gone, and
+        // closing our end gives this one SIGPIPE as under a shell
+        closeLink(link);
+        return false;
+    }
+    // Let the other links have their turn; poll() returns at once if there is more
+    *waitFd = link->source;
+    *waitEvents = POLLIN;
+    return true;
+}
+
+void PipelineRunner::setBlocked(Link *link, bool blocked)
+{
+    qint64 since = link->blockedSince;
+    if (blocked && since < 0) {
+        link->blockedSince = m_timer.elapsed();
+    } else if (!blocked && since >= 0) {
+        link->blockedMs += m_timer.elapsed() - since;
+        link->blockedSince = -1;
+    }
+}
+
+void PipelineRunner::closeLink(Link *link)
+{
+    setBlocked(link, false);
+    closeFd(&link->source);
+    closeFd(&link->destination);
+    closeFd(&link->tee);
+    link->done = true;
+}
+
+void PipelineRunner::onStageFinished(int index, int exitCode)
+{
+    Stage &stage = m_stages[index];
+    if (stage.finished) {
+        return;
+    }
+    stage.finished = true;
+    stage.exitCode = exitCode;
+    stage.elapsedMs = stage.startMs >= 0 ? m_timer.elapsed() - stage.startMs : 0;
+    if (stage.process->hasResourceUsage()) {
+        stage.usage = stage.process->resourceUsage();
+        stage.hasUsage = true;
+    }
+    stage.errors.append(stage.process->readAllStandardError());
+    emit stageChanged(index);
+
+    bool allFinished = true;
+    for (const Stage &other : m_stages) {
+        allFinished = allFinished && other.finished;
+    }
+    m_stagesDone = allFinished;
+    checkFinished();
+}
+
+qint64 PipelineRunner::readTap()
+{
+    if (m_tapRead < 0) {
+        return 0;
+    }
+    // Bounded, so a fast pipeline cannot keep the event loop to itself
+    char buffer[65536];
+    QByteArray data;
+    for (int round = 0; round < 16; ++round) {
+        ssize_t count = ::read(m_tapRead, buffer, sizeof(buffer));
+        if (count > 0) {
+            data.append(buffer, count);
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0 && m_tapNotifier) {
+            m_tapNotifier->setEnabled(false);
+        }
+        break;
+    }
+    if (!data.isEmpty()) {
+        emit tapOutput(data);
+    }
+    return data.size();
+}
+
+void PipelineRunner::checkFinished()
+{
+    if (!m_running || !m_stagesDone || !m_relayThread || !m_relayThread->isFinished()) {
+        return;
+    }
+    // Whatever the tap still holds belongs to this run
+    while (readTap() > 0) {
+    }
+    m_running = false;
+    m_totalMs = m_timer.elapsed();
+    // Like a shell: the pipeline's status is the last stage's
+    emit finished(!m_cancelled && m_stages.last().exitCode == 0);
+}
+
+void PipelineRunner::closeChildEnds(int index)
+{
+    if (index < m_childStdin.size()) {
+        closeFd(&m_childStdin[index]);
+        closeFd(&m_childStdout[index]);
+    }
+}
+
+void PipelineRunner::closeAll()
+{
+    if (m_relayThread) {
+        m_relayThread->wait();
+        delete m_relayThread;
+        m_relayThread = nullptr;
+    }
+    for (Link *link : m_links) {
+        closeLink(link);
+    }
+    qDeleteAll(m_links);
+    m_links.clear();
+    for (int i = 0; i < m_childStdin.size(); ++i) {
+        closeChildEnds(i);
+    }
+    delete m_tapNotifier;
+    m_tapNotifier = nullptr;
+    closeFd(&m_tapRead);
+}
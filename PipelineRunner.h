@@ -0,0 +1,115 @@
+#ifndef PIPELINERUNNER_H
+#define PIPELINERUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <atomic>
+#include <sys/resource.h>
+#include "Scheduling.h"
+
+class QSocketNotifier;
+class QThread;
+class QuishProcess;
+
+// Runs commands as a pipeline, each stage's stdout into the next one's stdin,
+// without a shell in between. Quish holds both ends of every link and a relay
+// thread moves the data across with splice(), so it can count the bytes and
+// see which stage holds the others up. The tapped stage is also tee()d into
+// tapOutput(); the output of the last stage ends there unless another is tapped.
+class PipelineRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stage {
+        QString name;               // "<topic>/<command>" as given
+        QString commandLine;
+        QString workingDirectory;
+        QSharedPointer<const Scheduling::Prepared> scheduling;  // null without one
+        QuishProcess *process = nullptr;
+        int exitCode = -1;
+        bool started = false;
+        bool finished = false;
+        qint64 startMs = -1;        // since the start of the pipeline
+        qint64 elapsedMs = 0;
+        bool hasUsage = false;
+        struct rusage usage;
+        QByteArray errors;          // stderr, which is not part of the pipeline
+    };
+
+    explicit PipelineRunner(QObject *parent = nullptr);
+    ~PipelineRunner();
+
+    void clear();
+    void addStage(const QString &name, const QString &commandLine, const QString &workingDirectory,
+                  const QSharedPointer<const Scheduling::Prepared> &scheduling = {});
+    void setTap(int stage) { m_tap = stage; }
+    int tap() const { return m_tap < 0 || m_tap >= m_stages.size() ? m_stages.size() - 1 : m_tap; }
+
+    bool start(QString *errorMessage);
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    int stageCount() const { return m_stages.size(); }
+    const Stage &stage(int index) const { return m_stages.at(index); }
+    qint64 stageTimeMs(int index) const;
+    qint64 elapsedMs() const;
+
+    // What the stage wrote to its stdout so far; its input is what the previous one wrote
+    qint64 bytesOut(int index) const;
+    qint64 bytesIn(int index) const;
+    // Time the stage's input was backed up: the stage before it could have
+    // written more, but this one did not read
+    qint64 inputBlockedMs(int index) const;
+    // The stage that sets the pace: the last one whose input is backed up
+    // most of the time, or the first one when none is
+    int bottleneck() const;
+
+signals:
+    void stageChanged(int index);
+    void tapOutput(const QByteArray &data);
+    void finished(bool succeeded);
+
+private:
+    // Stage i's stdout to the next stage's stdin, or to the tap (or /dev/null) for the last one
+    struct Link {
+        int source = -1;
+        int destination = -1;
+        int tee = -1;
+        qint64 pendingTeed = 0;     // in the tap already, not yet moved on
+        bool done = false;
+        std::atomic<qint64> blockedSince { -1 };
+        std::atomic<qint64> bytes { 0 };
+        std::atomic<qint64> blockedMs { 0 };
+    };
+
+    void relay();
+    bool transfer(Link *link, int *waitFd, short *waitEvents);
+    void setBlocked(Link *link, bool blocked);
+    void closeLink(Link *link);
+    void onStageFinished(int index, int exitCode);
+    qint64 readTap();
+    void checkFinished();
+    void closeChildEnds(int index);
+    void closeAll();
+
+    QVector<Stage> m_stages;
+    QList<Link*> m_links;
+    QVector<int> m_childStdin;
+    QVector<int> m_childStdout;
+    int m_tap = -1;
+    int m_tapRead = -1;
+    QSocketNotifier *m_tapNotifier = nullptr;
+    QThread *m_relayThread = nullptr;
+    std::atomic<bool> m_cancelled { false };
+    std::atomic<bool> m_stagesDone { false };
+    QElapsedTimer m_timer;
+    qint64 m_totalMs = 0;
+    bool m_running = false;
+};
+
+#endif // PIPELINERUNNER_H
@@ -0,0 +1,228 @@
+#include "ProcessPool.h"
+#include "IoEngine.h"
+#include "QuishProcess.h"
+
+#include <QThread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+extern char **environ;
+
+// Same safety margin GNU xargs keeps below the kernel limit
+static const qint64 COMMAND_LINE_HEADROOM = 2048;
+
+ProcessPool::ProcessPool(QObject *parent)
+    : QObject(parent)
+    , m_maxConcurrent(qMax(1, QThread::idealThreadCount()))
+{
+}
+
+ProcessPool::~ProcessPool()
+{
+    cancel();
+    for (quint64 stream : m_outputs) {
+        IoEngine::instance()->remove(stream);
+    }
+}
+
+int ProcessPool::addJob(const QString &commandLine, const QString &workingDirectory,
+                        const QSharedPointer<const Scheduling::Prepared> &scheduling)
+{
+    Job job;
+    job.commandLine = commandLine;
+    job.workingDirectory = workingDirectory;
+    job.scheduling = scheduling;
+    m_jobs.append(job);
+    return m_jobs.size() - 1;
+}
+
+void ProcessPool::setMaxConcurrent(int maxConcurrent)
+{
+    m_maxConcurrent = qMax(1, maxConcurrent);
+    launchPending();
+}
+
+void ProcessPool::start()
+{
+    m_cancelled = false;
+    if (m_jobs.isEmpty()) {
+        emit allFinished();
+        return;
+    }
+    launchPending();
+}
+
+void ProcessPool::cancel()
+{
+    m_cancelled = true;
+    m_nextJob = m_jobs.size();
+    // Jobs lead their process groups: what they started goes with them
+    for (QuishProcess *process : m_running.values()) {
+        process->killGroup();
+    }
+}
+
+void ProcessPool::clear()
+{
+    cancel();
+    for (QuishProcess *process : m_running.values()) {
+        process->disconnect(this);
+        process->waitForFinished(1000);
+        delete process;
+    }
+    for (quint64 stream : m_outputs) {
+        IoEngine::instance()->remove(stream);
+    }
+    m_running.clear();
+    m_outputs.clear();
+    m_exitCodes.clear();
+    m_timers.clear();
+    m_jobs.clear();
+    m_nextJob = 0;
+    m_finishedCount = 0;
+}
+
+void ProcessPool::launchPending()
+{
+    while (!m_cancelled && m_running.size() < m_maxConcurrent && m_nextJob < m_jobs.size()) {
+        const int id = m_nextJob++;
+        Job &job = m_jobs[id];
+
+        QuishProcess *process = new QuishProcess(this);
+        if (!job.workingDirectory.isEmpty()) {
+            process->setWorkingDirectory(job.workingDirectory);
+        }
+        if (job.scheduling) {
+            process->setScheduling(*job.scheduling);
+        }
+        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this,
+                [this, id](int exitCode, QProcess::ExitStatus exitStatus) {
+            onJobExited(id, exitStatus == QProcess::NormalExit ? exitCode : -1);
+        });
+        connect(process, &QProcess::errorOccurred, this, [this, id](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                onJobExited(id, -1);
+            }
+        });
+
+        // stdout and stderr both go to one pipe of ours, so QProcess has no
+        // channel left to watch and the I/O engine thread reads it
+        int fds[2] = { -1, -1 };
+        process->setStandardOutputFile(QProcess::nullDevice());
+        process->setStandardErrorFile(QProcess::nullDevice());
+        if (pipe2(fds, O_CLOEXEC) == 0) {
+            process->setStdoutDescriptor(fds[1]);
+            process->setStderrDescriptor(fds[1]);
+            quint64 stream = IoEngine::instance()->add(fds[0], [this, id](const QByteArray &data) {
+                m_jobs[id].output.append(data);
+                emit jobOutput(id, data);
+            }, [this, id]() {
+                onOutputClosed(id);
+            });
+            m_outputs.insert(id, stream);
+        }
+
+        m_running.insert(id, process);
+        m_timers[id].start();
+        job.started = true;
+        emit jobStarted(id);
+        process->start("/bin/sh", QStringList() << "-c" << job.commandLine);
+        if (fds[1] >= 0) {
+            ::close(fds[1]);
+        }
+    }
+}
+
+void ProcessPool::onJobExited(int id, int exitCode)
+{
+    if (!m_running.contains(id) || m_exitCodes.contains(id)) {
+        return;
+    }
+    m_exitCodes.insert(id, exitCode);
+    if (m_outputs.contains(id)) {
+        // Take what is left in the pipe, even if a background grandchild keeps it open;
+        // the job finishes once the engine reports it closed
+        IoEngine::instance()->close(m_outputs.value(id));
+        return;
+    }
+    finishJob(id);
+}
+
+void ProcessPool::onOutputClosed(int id)
+{
+    m_outputs.remove(id);
+    if (m_exitCodes.contains(id)) {
+        finishJob(id);
+    }
+}
+
+void ProcessPool::finishJob(int id)
+{
+    QuishProcess *process = m_running.take(id);
+    if (!process) {
+        return;
+    }
+
+    Job &job = m_jobs[id];
+    job.exitCode = m_exitCodes.take(id);
+    job.elapsedMs = m_timers.take(id).elapsed();
+    job.finished = true;
+    m_finishedCount++;
+    process->deleteLater();
+
+    emit jobFinished(id);
+
+    launchPending();
+    if (m_running.isEmpty() && m_nextJob >= m_jobs.size()) {
+        emit allFinished();
+    }
+}
+
+qint64 ProcessPool::commandLineLimit()
+{
+    long argMax = sysconf(_SC_ARG_MAX);
+    if (argMax <= 0) {
+        argMax = 128 * 1024;
+    }
+
+    // argv and envp share the ARG_MAX space, pointers included
+    qint64 environmentSize = 0;
+    for (char **env = environ; *env; ++env) {
+        environmentSize += strlen(*env) + 1 + sizeof(char*);
+    }
+
+    // The whole command line is a single argument of sh, and Linux caps the
+    // length of one argument at MAX_ARG_STRLEN (32 pages)
+    long pageSize = sysconf(_SC_PAGESIZE);
+    qint64 maxArgStrlen = 32 * (pageSize > 0 ? pageSize : 4096);
+
+    qint64 limit = qMin<qint64>(argMax - environmentSize, maxArgStrlen) - COMMAND_LINE_HEADROOM;
+    return qMax<qint64>(limit, 0);
+}
+
+QList<QStringList> ProcessPool::splitIntoBatches(const QStringList &arguments, qint64 budget)
+{
+    QList<QStringList> batches;
+    QStringList current;
+    qint64 currentSize = 0;
+
+    for (const QString &argument : arguments) {
+        qint64 size = argument.toLocal8Bit().size() + 1;
+        if (size > budget) {
+            return QList<QStringList>();
+        }
+        if (currentSize + size > budget && !current.isEmpty()) {
+            batches.append(current);
+            current.clear();
+            currentSize = 0;
+        }
+        current.append(argument);
+        currentSize += size;
+    }
+    if (!current.isEmpty()) {
+        batches.append(current);
+    }
+    return batches;
+}
@@ -0,0 +1,80 @@
+#ifndef PROCESSPOOL_H
+#define PROCESSPOOL_H
+
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMap>
+#include <QSharedPointer>
+#include "Scheduling.h"
+
+class QuishProcess;
+
+// Runs a queue of shell command lines with at most maxConcurrent of them alive
+// at the same time. Each job keeps its merged output, exit code and wall time.
+// The output pipes are read by the IoEngine thread, not by one QProcess each.
+class ProcessPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Job {
+        QString commandLine;
+        QString workingDirectory;
+        QByteArray output;
+        int exitCode = -1;
+        qint64 elapsedMs = 0;
+        bool started = false;
+        bool finished = false;
+        // Applied in the job's process before exec; shared by a whole sweep or batch
+        QSharedPointer<const Scheduling::Prepared> scheduling;
+    };
+
+    explicit ProcessPool(QObject *parent = nullptr);
+    ~ProcessPool();
+
+    int addJob(const QString &commandLine, const QString &workingDirectory,
+               const QSharedPointer<const Scheduling::Prepared> &scheduling = {});
+    void setMaxConcurrent(int maxConcurrent);
+    int maxConcurrent() const { return m_maxConcurrent; }
+
+    void start();
+    void cancel();
+    void clear();
+
+    int jobCount() const { return m_jobs.size(); }
+    int finishedCount() const { return m_finishedCount; }
+    int runningCount() const { return m_running.size(); }
+    bool isRunning() const { return !m_running.isEmpty() || m_nextJob < m_jobs.size(); }
+    const Job &job(int id) const { return m_jobs.at(id); }
+
+    // Longest command line that can be handed to "/bin/sh -c" on this system
+    static qint64 commandLineLimit();
+    // Packs already quoted arguments into batches whose joined length fits in budget
+    static QList<QStringList> splitIntoBatches(const QStringList &arguments, qint64 budget);
+
+signals:
+    void jobStarted(int id);
+    void jobOutput(int id, const QByteArray &data);
+    void jobFinished(int id);
+    void allFinished();
+
+private:
+    void launchPending();
+    void onJobExited(int id, int exitCode);
+    void onOutputClosed(int id);
+    void finishJob(int id);
+
+    QVector<Job> m_jobs;
+    QMap<int, QuishProcess*> m_running;
+    QMap<int, quint64> m_outputs;           // IoEngine stream of each running job
+    QMap<int, int> m_exitCodes;             // exited, output not yet closed
+    QMap<int, QElapsedTimer> m_timers;
+    int m_maxConcurrent;
+    int m_nextJob = 0;
+    int m_finishedCount = 0;
+    bool m_cancelled = false;
+};
+
+#endif // PROCESSPOOL_H
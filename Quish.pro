@@ -1,4 +1,4 @@
-QT       += core gui network
+QT       += core gui network sql
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -19,13 +19,71 @@ SOURCES += main.cpp \
     JsonHighlighter.cpp \
     CodeEditor.cpp \
     settings.cpp \
-    SaveCommandDialog.cpp
+    SaveCommandDialog.cpp \
+    ProcessPool.cpp \
+    SweepDialog.cpp \
+    BenchmarkDialog.cpp \
+    QuishProcess.cpp \
+    Launcher.cpp \
+    ResourceMonitor.cpp \
+    CpuCounters.cpp \
+    ResultCache.cpp \
+    CommandLine.cpp \
+    Cli.cpp \
+    InstanceServer.cpp \
+    WatchController.cpp \
+    WorkflowRunner.cpp \
+    WorkflowDialog.cpp \
+    Scheduling.cpp \
+    GroupStopper.cpp \
+    StdinFeeder.cpp \
+    PipelineRunner.cpp \
+    PipelineDialog.cpp \
+    IoEngine.cpp \
+    RunHistory.cpp \
+    HistoryView.cpp \
+    ConfigCache.cpp \
+    CommandCatalog.cpp \
+    ConfigFragments.cpp \
+    FuzzyIndex.cpp \
+    CommandPalette.cpp \
+    ConfigJournal.cpp \
+    ArgumentForm.cpp
 
 HEADERS += MainWindow.h \
     JsonHighlighter.h \
     CodeEditor.h \
     settings.h \
-    SaveCommandDialog.h
+    SaveCommandDialog.h \
+    ProcessPool.h \
+    SweepDialog.h \
+    BenchmarkDialog.h \
+    QuishProcess.h \
+    Launcher.h \
+    ResourceMonitor.h \
+    CpuCounters.h \
+    ResultCache.h \
+    CommandLine.h \
+    Cli.h \
+    InstanceServer.h \
+    WatchController.h \
+    WorkflowRunner.h \
+    WorkflowDialog.h \
+    Scheduling.h \
+    GroupStopper.h \
+    StdinFeeder.h \
+    PipelineRunner.h \
+    PipelineDialog.h \
+    IoEngine.h \
+    RunHistory.h \
+    HistoryView.h \
+    ConfigCache.h \
+    CommandCatalog.h \
+    ConfigFragments.h \
+    FuzzyIndex.h \
+    CommandPalette.h \
+    ConfigJournal.h \
+    ArgumentForm.h
 
 FORMS += \
     MainWindow.ui
@@ -0,0 +1,454 @@
+#include "QuishProcess.h"
+#include "GroupStopper.h"
+
+#include <QSocketNotifier>
+#include <QProcessEnvironment>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+namespace {
+
+// What the reaper writes back once the command has exited
+struct ReaperReport {
+    int status;
+    struct rusage usage;
+    bool hasCpuCounters;
+    CpuCounters::Values cpuCounters;
+};
+
+volatile pid_t s_reapedChild = -1;
+
+void forwardSignal(int signal, siginfo_t *info, void *)
+{
+    // Quish signals the whole process group, the command got it already
+    if (s_reapedChild > 0 && !(info && info->si_pid == getppid())) {
+        kill(s_reapedChild, signal);
+    }
+}
+
+void closeFrom(int first, int last)
+{
+    if (first > last) {
+        return;
+    }
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, first, last, 0) == 0) {
+        return;
+    }
+#endif
+    long maxFd = sysconf(_SC_OPEN_MAX);
+    if (maxFd < 0 || maxFd > 65536) {
+        maxFd = 65536;
+    }
+    for (int fd = first; fd <= last && fd < maxFd; ++fd) {
+        close(fd);
+    }
+}
+
+// Closes every descriptor but keep1 and keep2 (-1 when unused)
+void closeAllExcept(int keep1, int keep2)
+{
+    int low = qMin(keep1, keep2);
+    int high = qMax(keep1, keep2);
+    if (low < 0) {
+        closeFrom(0, high - 1);
+        closeFrom(high + 1, INT_MAX);
+        return;
+    }
+    closeFrom(0, low - 1);
+    closeFrom(low + 1, high - 1);
+    closeFrom(high + 1, INT_MAX);
+}
+
+} // namespace
+
+QuishProcess::QuishProcess(QObject *parent)
+    : QProcess(parent)
+{
+    m_ptySlaveName[0] = '\0';
+    memset(&m_resourceUsage, 0, sizeof(m_resourceUsage));
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    setChildProcessModifier([this]() { setupChild(); });
+#endif
+    // Connected first so the pty is drained and the report read before
+    // anybody else sees finished()
+    connect(this, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this]() {
+        if (usesPty()) {
+            readPty();
+            closePty();
+        }
+        readReport();
+    });
+    connect(this, &QProcess::started, this, [this]() {
+        if (m_reportWrite >= 0) {
+            ::close(m_reportWrite);
+            m_reportWrite = -1;
+        }
+    });
+}
+
+QuishProcess::~QuishProcess()
+{
+    // QProcess kills only the reaper on destruction
+    if (state() != QProcess::NotRunning) {
+        killGroup();
+    }
+    closePty();
+    if (m_reportRead >= 0) {
+        ::close(m_reportRead);
+    }
+    if (m_reportWrite >= 0) {
+        ::close(m_reportWrite);
+    }
+}
+
+void QuishProcess::signalGroup(int signal)
+{
+    if (state() != QProcess::NotRunning) {
+        GroupStopper::signalGroup(processId(), signal);
+    }
+}
+
+bool QuishProcess::setCollectResourceUsage(bool collect)
+{
+    if (!collect || m_reportRead >= 0) {
+        return true;
+    }
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0) {
+        return false;
+    }
+    m_reportRead = fds[0];
+    m_reportWrite = fds[1];
+    return true;
+}
+
+void QuishProcess::readReport()
+{
+    if (m_reportRead < 0) {
+        return;
+    }
+    ReaperReport report;
+    ssize_t size;
+    do {
+        size = ::read(m_reportRead, &report, sizeof(report));
+    } while (size < 0 && errno == EINTR);
+    if (size == sizeof(report)) {
+        m_resourceUsage = report.usage;
+        m_hasResourceUsage = true;
+        m_terminationSignal = WIFSIGNALED(report.status) ? WTERMSIG(report.status) : 0;
+    }
+    if (size == sizeof(report) && report.hasCpuCounters) {
+        m_cpuCounters = report.cpuCounters;
+        m_hasCpuCounters = true;
+    }
+    ::close(m_reportRead);
+    m_reportRead = -1;
+}
+
+bool QuishProcess::setCollectCpuCounters(bool excludeKernel)
+{
+    if (!setCollectResourceUsage(true)) {
+        return false;
+    }
+    m_collectCpuCounters = true;
+    m_excludeKernel = excludeKernel;
+    return true;
+}
+
+void QuishProcess::setScheduling(const Scheduling::Prepared &prepared)
+{
+    m_scheduling = prepared;
+    m_hasScheduling = true;
+}
+
+bool QuishProcess::enablePty(int columns, int rows, QString *errorMessage)
+{
+    if (usesPty()) {
+        return true;
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0
+        || ptsname_r(master, m_ptySlaveName, sizeof(m_ptySlaveName)) != 0) {
+        if (errorMessage) {
+            *errorMessage = tr("Could not allocate a pseudo-terminal: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        }
+        if (master >= 0) {
+            ::close(master);
+        }
+        return false;
+    }
+    fcntl(master, F_SETFD, FD_CLOEXEC);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    // Keep our own handle on the slave side until the run is over: the master
+    // then never reports EIO while the child is starting, and nothing written
+    // by a short-lived child is lost before we drain it.
+    m_ptySlave = ::open(m_ptySlaveName, O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (m_ptySlave >= 0) {
+        struct termios attributes;
+        if (tcgetattr(m_ptySlave, &attributes) == 0) {
+            attributes.c_oflag &= ~ONLCR;
+            attributes.c_lflag &= ~(ECHO | ECHONL);
+            tcsetattr(m_ptySlave, TCSANOW, &attributes);
+        }
+    }
+
+    struct winsize size;
+    memset(&size, 0, sizeof(size));
+    size.ws_col = columns > 0 ? columns : 80;
+    size.ws_row = rows > 0 ? rows : 24;
+    ioctl(master, TIOCSWINSZ, &size);
+
+    m_ptyMaster = master;
+    m_ptyNotifier = new QSocketNotifier(m_ptyMaster, QSocketNotifier::Read, this);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    connect(m_ptyNotifier, QOverload<QSocketDescriptor, QSocketNotifier::Type>::of(&QSocketNotifier::activated),
+            this, &QuishProcess::readPty);
+#else
+    connect(m_ptyNotifier, &QSocketNotifier::activated, this, &QuishProcess::readPty);
+#endif
+
+    QProcessEnvironment environment = processEnvironment();
+    if (environment.isEmpty()) {
+        environment = QProcessEnvironment::systemEnvironment();
+    }
+    environment.insert("TERM", "dumb");
+    setProcessEnvironment(environment);
+    return true;
+}
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+void QuishProcess::setupChildProcess()
+{
+    setupChild();
+}
+#endif
+
+// Runs in the forked child right before exec: only async-signal-safe calls here
+void QuishProcess::setupChild()
+{
+    // Before the reaper forks, so it and the command share the envelope
+    if (m_hasScheduling) {
+        Scheduling::apply(m_scheduling);
+    }
+
+    // Each run leads its own process group (a session on a pty), so stopping
+    // it reaches everything it started
+    if (m_ptyMaster < 0) {
+        setpgid(0, 0);
+    }
+    if (m_ptyMaster >= 0) {
+        setsid();
+        int slave = ::open(m_ptySlaveName, O_RDWR);
+        if (slave >= 0) {
+            ioctl(slave, TIOCSCTTY, 0);
+            dup2(slave, STDIN_FILENO);
+            dup2(slave, STDOUT_FILENO);
+            dup2(slave, STDERR_FILENO);
+            if (slave > STDERR_FILENO) {
+                ::close(slave);
+            }
+        }
+    }
+    if (m_stdinFd >= 0) {
+        dup2(m_stdinFd, STDIN_FILENO);
+    }
+    if (m_stdoutFd >= 0) {
+        dup2(m_stdoutFd, STDOUT_FILENO);
+    }
+    if (m_stderrFd >= 0) {
+        dup2(m_stderrFd, STDERR_FILENO);
+    }
+
+    if (m_reportWrite >= 0) {
+        // The command becomes our child and we stay in between as its reaper.
+        // Default SIGCHLD so no handler inherited from Quish can steal the status.
+        signal(SIGCHLD, SIG_DFL);
+
+        // With counters, the command waits on this gate until they are attached
+        int gate[2] = { -1, -1 };
+        if (m_collectCpuCounters && pipe2(gate, O_CLOEXEC) != 0) {
+            gate[0] = gate[1] = -1;
+        }
+
+        pid_t child = fork();
+        if (child == 0) {
+            if (gate[0] >= 0) {
+                char c;
+                ::close(gate[1]);
+                while (::read(gate[0], &c, 1) < 0 && errno == EINTR) {
+                }
+                ::close(gate[0]);
+            }
+            return;
+        }
+        if (child > 0) {
+            if (gate[0] >= 0) {
+                ::close(gate[0]);
+            }
+            runReaper(child, gate[1]);
+        }
+    }
+}
+
+// Intermediate process: wait for the command, report its rusage and exit the same way
+void QuishProcess::runReaper(pid_t child, int gate)
+{
+    s_reapedChild = child;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = forwardSignal;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGHUP, &action, nullptr);
+    sigaction(SIGQUIT, &action, nullptr);
+
+    // Only the command may hold the output pipes, so Quish sees EOF when it is done
+    int reportFd = m_reportWrite;
+    closeAllExcept(reportFd, gate);
+
+    ReaperReport report;
+    memset(&report, 0, sizeof(report));
+
+    // Same sequence as perf stat: attach while the child waits on the gate, count from its exec
+    int counterFds[CpuCounters::CounterCount];
+    for (int i = 0; i < CpuCounters::CounterCount; ++i) {
+        counterFds[i] = -1;
+    }
+    if (gate >= 0) {
+        CpuCounters::open(child, m_excludeKernel, counterFds, &report.cpuCounters);
+        report.hasCpuCounters = true;
+        ::close(gate);
+    }
+
+    while (wait4(child, &report.status, 0, &report.usage) < 0 && errno == EINTR) {
+    }
+    if (report.hasCpuCounters) {
+        CpuCounters::read(counterFds, &report.cpuCounters);
+        CpuCounters::close(counterFds);
+    }
+    ssize_t written = write(reportFd, &report, sizeof(report));
+    Q_UNUSED(written);
+
+    if (WIFSIGNALED(report.status)) {
+        signal(WTERMSIG(report.status), SIG_DFL);
+        raise(WTERMSIG(report.status));
+    }
+    _exit(WIFEXITED(report.status) ? WEXITSTATUS(report.status) : 1);
+}
+
+void QuishProcess::readPty()
+{
+    if (m_ptyMaster < 0) {
+        return;
+    }
+
+    char buffer[65536];
+    QByteArray data;
+    for (;;) {
+        ssize_t count = ::read(m_ptyMaster, buffer, sizeof(buffer));
+        if (count > 0) {
+            data.append(buffer, count);
+            continue;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count == 0 || (count < 0 && errno != EAGAIN)) {
+            // EIO: every slave handle is closed
+            if (m_ptyNotifier) {
+                m_ptyNotifier->setEnabled(false);
+            }
+        }
+        break;
+    }
+
+    data = stripTerminalControls(data);
+    if (!data.isEmpty()) {
+        emit ptyOutput(data);
+    }
+}
+
+void QuishProcess::closePty()
+{
+    if (m_ptyNotifier) {
+        m_ptyNotifier->setEnabled(false);
+        m_ptyNotifier->deleteLater();
+        m_ptyNotifier = nullptr;
+    }
+    if (m_ptySlave >= 0) {
+        ::close(m_ptySlave);
+        m_ptySlave = -1;
+    }
+    if (m_ptyMaster >= 0) {
+        ::close(m_ptyMaster);
+        m_ptyMaster = -1;
+    }
+}
+
+// The output view is plain text: drop CSI and OSC escape sequences, keeping an
+// incomplete trailing sequence for the next read
+QByteArray QuishProcess::stripTerminalControls(const QByteArray &data)
+{
+    QByteArray input = m_ptyPending + data;
+    m_ptyPending.clear();
+
+    QByteArray output;
+    output.reserve(input.size());
+    const int n = input.size();
+    int i = 0;
+    while (i < n) {
+        char c = input.at(i);
+        if (c != '\x1b') {
+            if (!(c == '\r' && i + 1 < n && input.at(i + 1) == '\n')) {
+                output.append(c);
+            }
+            i++;
+            continue;
+        }
+
+        if (i + 1 >= n) {
+            m_ptyPending = input.mid(i);
+            break;
+        }
+
+        char kind = input.at(i + 1);
+        int j = i + 2;
+        if (kind == '[') {
+            while (j < n && (static_cast<unsigned char>(input.at(j)) < 0x40 || static_cast<unsigned char>(input.at(j)) > 0x7e)) {
+                j++;
+            }
+            if (j >= n) {
+                m_ptyPending = input.mid(i);
+                break;
+            }
+            i = j + 1;
+        } else if (kind == ']') {
+            while (j < n && input.at(j) != '\x07' && !(input.at(j) == '\x1b' && j + 1 < n && input.at(j + 1) == '\\')) {
+                j++;
+            }
+            if (j >= n) {
+                m_ptyPending = input.mid(i);
+                break;
+            }
+            i = input.at(j) == '\x07' ? j + 1 : j + 2;
+        } else {
+            i += 2;
+        }
+    }
+    return output;
+}
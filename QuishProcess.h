@@ -0,0 +1,95 @@
+#ifndef QUISHPROCESS_H
+#define QUISHPROCESS_H
+
+#include <QProcess>
+#include <QByteArray>
+#include "CpuCounters.h"
+#include "Scheduling.h"
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+class QSocketNotifier;
+
+// QProcess with the extra child-side setup Quish needs before exec, such as
+// running the command on a pseudo-terminal instead of pipes, or reaping it
+// from a small intermediate process to get its wait4() resource usage.
+// The child leads a new process group whose id is processId().
+class QuishProcess : public QProcess
+{
+    Q_OBJECT
+
+public:
+    explicit QuishProcess(QObject *parent = nullptr);
+    ~QuishProcess();
+
+    // Must be called before start(); the output then arrives through ptyOutput()
+    bool enablePty(int columns, int rows, QString *errorMessage = nullptr);
+    bool usesPty() const { return m_ptyMaster >= 0; }
+
+    // Must be called before start(); the usage is available once finished() is emitted
+    bool setCollectResourceUsage(bool collect);
+    bool hasResourceUsage() const { return m_hasResourceUsage; }
+    const struct rusage &resourceUsage() const { return m_resourceUsage; }
+    // The signal that ended the command, 0 when it exited or the reaper did not report
+    int terminationSignal() const { return m_terminationSignal; }
+
+    // Attaches perf counters to the command before it execs; implies resource usage
+    bool setCollectCpuCounters(bool excludeKernel);
+    bool hasCpuCounters() const { return m_hasCpuCounters; }
+    const CpuCounters::Values &cpuCounters() const { return m_cpuCounters; }
+
+    // Affinity, priorities, limits and cgroup applied in the child before exec
+    void setScheduling(const Scheduling::Prepared &prepared);
+
+    // The signal goes to the whole process group: the command, what it started
+    // and the reaper. QProcess::terminate() and kill() only reach the reaper,
+    // which cannot pass SIGKILL on.
+    void terminateGroup() { signalGroup(SIGTERM); }
+    void killGroup() { signalGroup(SIGKILL); }
+    void signalGroup(int signal);
+
+    // Descriptors the command gets as its stdin, stdout and stderr instead of QProcess's pipes
+    void setStdinDescriptor(int fd) { m_stdinFd = fd; }
+    void setStdoutDescriptor(int fd) { m_stdoutFd = fd; }
+    void setStderrDescriptor(int fd) { m_stderrFd = fd; }
+
+signals:
+    void ptyOutput(const QByteArray &data);
+
+protected:
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    void setupChildProcess() override;
+#endif
+
+private:
+    void setupChild();
+    [[noreturn]] void runReaper(pid_t child, int gate);
+    void readReport();
+    void readPty();
+    void closePty();
+    QByteArray stripTerminalControls(const QByteArray &data);
+
+    int m_ptyMaster = -1;
+    int m_ptySlave = -1;
+    char m_ptySlaveName[128];
+    QSocketNotifier *m_ptyNotifier = nullptr;
+    QByteArray m_ptyPending;
+    int m_reportRead = -1;
+    int m_reportWrite = -1;
+    bool m_hasResourceUsage = false;
+    struct rusage m_resourceUsage;
+    int m_terminationSignal = 0;
+    bool m_collectCpuCounters = false;
+    bool m_excludeKernel = false;
+    bool m_hasCpuCounters = false;
+    CpuCounters::Values m_cpuCounters;
+    bool m_hasScheduling = false;
+    Scheduling::Prepared m_scheduling;
+    int m_stdinFd = -1;
+    int m_stdoutFd = -1;
+    int m_stderrFd = -1;
+};
+
+#endif // QUISHPROCESS_H
@@ -0,0 +1,235 @@
+#include "ResourceMonitor.h"
+
+#include <QTimer>
+#include <QThread>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QMultiMap>
+#include <QList>
+
+#include <unistd.h>
+
+namespace {
+
+struct ProcStat {
+    pid_t ppid = 0;
+    qint64 cpuTicks = 0;
+    qint64 rssPages = 0;
+};
+
+bool readProcStat(pid_t pid, ProcStat *stat)
+{
+    QFile file(QString("/proc/%1/stat").arg(pid));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray data = file.readAll();
+
+    // The command name is in parentheses and may contain spaces
+    int end = data.lastIndexOf(')');
+    if (end < 0) {
+        return false;
+    }
+    QList<QByteArray> fields = data.mid(end + 2).split(' ');
+    // fields[0] is field 3 (state) of proc(5)
+    if (fields.size() < 22) {
+        return false;
+    }
+    stat->ppid = fields[1].toInt();
+    stat->cpuTicks = fields[11].toLongLong() + fields[12].toLongLong() + fields[13].toLongLong() + fields[14].toLongLong();
+    stat->rssPages = fields[21].toLongLong();
+    return true;
+}
+
+qint64 readKeyValue(const QByteArray &data, const QByteArray &key)
+{
+    int index = data.indexOf("\n" + key);
+    if (index < 0) {
+        if (!data.startsWith(key)) {
+            return 0;
+        }
+        index = -1;
+    }
+    int start = index + 1 + key.size();
+    int end = data.indexOf('\n', start);
+    return data.mid(start, end < 0 ? -1 : end - start).trimmed().toLongLong();
+}
+
+struct TreeSample {
+    bool found = false;
+    qint64 cpuTicks = 0;
+    ResourceSample sample;          // all but cpuPercent
+};
+
+// Worker thread: the totals of rootPid and everything below it
+TreeSample sampleTree(pid_t rootPid)
+{
+    TreeSample tree;
+
+    // Index every process by parent to walk the tree below the root
+    QMap<pid_t, ProcStat> stats;
+    QMultiMap<pid_t, pid_t> children;
+    const QStringList entries = QDir("/proc").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        bool isPid = false;
+        pid_t pid = entry.toInt(&isPid);
+        ProcStat stat;
+        if (isPid && readProcStat(pid, &stat)) {
+            stats.insert(pid, stat);
+            children.insert(stat.ppid, pid);
+        }
+    }
+    if (!stats.contains(rootPid)) {
+        return tree;
+    }
+    tree.found = true;
+
+    static const long pageSize = sysconf(_SC_PAGESIZE);
+
+    ResourceSample &current = tree.sample;
+    QList<pid_t> pending;
+    pending.append(rootPid);
+    while (!pending.isEmpty()) {
+        pid_t pid = pending.takeFirst();
+        const ProcStat &stat = stats[pid];
+        tree.cpuTicks += stat.cpuTicks;
+        current.rssBytes += stat.rssPages * pageSize;
+        current.processCount++;
+
+        QFile status(QString("/proc/%1/status").arg(pid));
+        if (status.open(QIODevice::ReadOnly)) {
+            QByteArray data = status.readAll();
+            current.contextSwitches += readKeyValue(data, "voluntary_ctxt_switches:")
+                                       + readKeyValue(data, "nonvoluntary_ctxt_switches:");
+        }
+        // Not readable for processes of other users (sudo)
+        QFile io(QString("/proc/%1/io").arg(pid));
+        if (io.open(QIODevice::ReadOnly)) {
+            QByteArray data = io.readAll();
+            current.readBytes += readKeyValue(data, "read_bytes:");
+            current.writeBytes += readKeyValue(data, "write_bytes:");
+        }
+
+        pending.append(children.values(pid));
+    }
+    return tree;
+}
+
+} // namespace
+
+ResourceMonitor::ResourceMonitor(QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+{
+    connect(m_timer, &QTimer::timeout, this, &ResourceMonitor::sample);
+}
+
+ResourceMonitor::~ResourceMonitor()
+{
+    // Its result is queued to this object
+    if (m_sampler) {
+        m_sampler->wait();
+    }
+}
+
+void ResourceMonitor::start(pid_t rootPid, int intervalMs)
+{
+    m_rootPid = rootPid;
+    ++m_generation;
+    m_lastCpuTicks = -1;
+    m_lastSample = ResourceSample();
+    m_lastSampleTime.start();
+    m_timer->start(intervalMs);
+    sample();
+}
+
+void ResourceMonitor::stop()
+{
+    m_timer->stop();
+    m_rootPid = -1;
+    ++m_generation;
+}
+
+void ResourceMonitor::sample()
+{
+    // A scan still going on a busy system skips this beat
+    if (m_rootPid <= 0 || m_sampler) {
+        return;
+    }
+
+    pid_t rootPid = m_rootPid;
+    int generation = m_generation;
+    QThread *thread = QThread::create([this, rootPid, generation]() {
+        TreeSample tree = sampleTree(rootPid);
+        QMetaObject::invokeMethod(this, [this, generation, tree]() {
+            if (generation == m_generation && tree.found) {
+                addSample(tree.sample, tree.cpuTicks);
+            }
+        }, Qt::QueuedConnection);
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_sampler = thread;
+    thread->start();
+}
+
+void ResourceMonitor::addSample(ResourceSample current, qint64 cpuTicks)
+{
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+    qint64 elapsedMs = m_lastSampleTime.restart();
+    if (m_lastCpuTicks >= 0 && elapsedMs > 0 && ticksPerSecond > 0) {
+        double cpuMs = (cpuTicks - m_lastCpuTicks) * 1000.0 / ticksPerSecond;
+        current.cpuPercent = qMax(0.0, cpuMs * 100.0 / elapsedMs);
+    }
+    m_lastCpuTicks = cpuTicks;
+
+    // Exited processes take their counters with them: keep the totals monotonic
+    current.readBytes = qMax(current.readBytes, m_lastSample.readBytes);
+    current.writeBytes = qMax(current.writeBytes, m_lastSample.writeBytes);
+    current.contextSwitches = qMax(current.contextSwitches, m_lastSample.contextSwitches);
+
+    m_lastSample = current;
+    emit sampled(current);
+}
+
+QString ResourceMonitor::formatSample(const ResourceSample &sample)
+{
+    return tr("CPU %1% | RSS %2 | R %3 W %4 | CS %5")
+        .arg(sample.cpuPercent, 0, 'f', 0)
+        .arg(formatBytes(sample.rssBytes))
+        .arg(formatBytes(sample.readBytes))
+        .arg(formatBytes(sample.writeBytes))
+        .arg(sample.contextSwitches);
+}
+
+QString ResourceMonitor::formatUsage(const struct rusage &usage)
+{
+    double user = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double system = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    return tr("user %1 s, sys %2 s, max RSS %3, major faults %4")
+        .arg(user, 0, 'f', 3)
+        .arg(system, 0, 'f', 3)
+        .arg(formatBytes(static_cast<qint64>(usage.ru_maxrss) * 1024))
+        .arg(usage.ru_majflt);
+}
+
+QString ResourceMonitor::formatBytes(qint64 size)
+{
+    if (size < 1024) {
+        return QString("%1 B").arg(size);
+    } else if (size < 1024 * 1024) {
+        return QString("%1 KB").arg(size / 1024.0, 0, 'f', 1);
+    } else if (size < 1024 * 1024 * 1024) {
+        return QString("%1 MB").arg(size / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+    return QString("%1 GB").arg(size / (1024.0 * 1024.0 * 1024.0), 0, 'f', 1);
+}
+
+QString ResourceMonitor::formatMs(double ms, int secondsPrecision, int msPrecision)
+{
+    if (ms >= 1000) {
+        return QString("%1 s").arg(ms / 1000.0, 0, 'f', secondsPrecision);
+    }
+    return QString("%1 ms").arg(ms, 0, 'f', msPrecision);
+}
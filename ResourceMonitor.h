@@ -0,0 +1,60 @@
+#ifndef RESOURCEMONITOR_H
+#define RESOURCEMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QString>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+class QThread;
+class QTimer;
+
+struct ResourceSample {
+    double cpuPercent = 0.0;
+    qint64 rssBytes = 0;
+    qint64 readBytes = 0;
+    qint64 writeBytes = 0;
+    qint64 contextSwitches = 0;
+    int processCount = 0;
+};
+
+// Samples a running process tree from /proc/<pid>/stat, status and io. The
+// scan of /proc runs on a worker thread; sampled() is emitted on this one.
+class ResourceMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ResourceMonitor(QObject *parent = nullptr);
+    ~ResourceMonitor();
+
+    void start(pid_t rootPid, int intervalMs = 1000);
+    void stop();
+    const ResourceSample &lastSample() const { return m_lastSample; }
+
+    static QString formatSample(const ResourceSample &sample);
+    static QString formatUsage(const struct rusage &usage);
+    static QString formatBytes(qint64 size);
+    // Milliseconds, shown in seconds from one second on
+    static QString formatMs(double ms, int secondsPrecision = 1, int msPrecision = 0);
+
+signals:
+    void sampled(const ResourceSample &sample);
+
+private:
+    void sample();
+    void addSample(ResourceSample current, qint64 cpuTicks);
+
+    QTimer *m_timer;
+    QPointer<QThread> m_sampler;
+    int m_generation = 0;           // bumped by start() and stop(), to drop a late scan
+    pid_t m_rootPid = -1;
+    qint64 m_lastCpuTicks = -1;
+    QElapsedTimer m_lastSampleTime;
+    ResourceSample m_lastSample;
+};
+
+#endif // RESOURCEMONITOR_H
@@ -0,0 +1,101 @@
+#include "ResultCache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <sys/stat.h>
+
+namespace ResultCache {
+
+namespace {
+
+const quint32 CACHE_MAGIC = 0x51434331; // "QCC1"
+const qint64 MAX_ENTRY_SIZE = 16 * 1024 * 1024;
+const int MAX_ENTRIES = 512;
+
+QString cacheDirectory()
+{
+    return QDir::homePath() + "/.Quish/cache";
+}
+
+// Keeps the most recently written entries
+void prune()
+{
+    QDir dir(cacheDirectory());
+    const QFileInfoList entries = dir.entryInfoList(QDir::Files, QDir::Time);
+    for (int i = MAX_ENTRIES; i < entries.size(); ++i) {
+        QFile::remove(entries[i].absoluteFilePath());
+    }
+}
+
+} // namespace
+
+QString key(const QString &commandLine, const QString &workingDirectory, const QStringList &inputFiles)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(commandLine.toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(workingDirectory.toUtf8());
+
+    for (const QString &path : inputFiles) {
+        QString absolutePath = QDir(workingDirectory).absoluteFilePath(path);
+        QByteArray identity = QByteArray(1, '\0') + absolutePath.toUtf8();
+        struct stat info;
+        if (stat(QFile::encodeName(absolutePath).constData(), &info) == 0) {
+            identity += QString(":%1:%2:%3:%4.%5")
+                            .arg(info.st_dev)
+                            .arg(info.st_ino)
+                            .arg(info.st_size)
+                            .arg(info.st_mtim.tv_sec)
+                            .arg(info.st_mtim.tv_nsec)
+                            .toLatin1();
+        } else {
+            identity += ":missing";
+        }
+        hash.addData(identity);
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool lookup(const QString &key, Entry *entry)
+{
+    QFile file(cacheDirectory() + "/" + key);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream stream(&file);
+    quint32 magic;
+    qint32 exitCode;
+    stream >> magic;
+    if (magic != CACHE_MAGIC) {
+        return false;
+    }
+    stream >> exitCode >> entry->created >> entry->output;
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+    entry->exitCode = exitCode;
+    return true;
+}
+
+void store(const QString &key, const QByteArray &output, int exitCode)
+{
+    if (output.size() > MAX_ENTRY_SIZE || !QDir().mkpath(cacheDirectory())) {
+        return;
+    }
+    QSaveFile file(cacheDirectory() + "/" + key);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream stream(&file);
+    stream << CACHE_MAGIC << qint32(exitCode) << QDateTime::currentDateTime() << output;
+    if (file.commit()) {
+        prune();
+    }
+}
+
+}
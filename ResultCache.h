@@ -0,0 +1,27 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+
+// Stored output and exit code of "cacheable" commands, in ~/.Quish/cache
+namespace ResultCache {
+
+struct Entry {
+    QByteArray output;
+    int exitCode = 0;
+    QDateTime created;
+};
+
+// Hash of the command line, the working directory and the identity
+// (inode, size, mtime) of every input file
+QString key(const QString &commandLine, const QString &workingDirectory, const QStringList &inputFiles);
+
+bool lookup(const QString &key, Entry *entry);
+void store(const QString &key, const QByteArray &output, int exitCode);
+
+}
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,262 @@
+#include "RunHistory.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+#include <QVariant>
+
+namespace {
+
+const char *READ_CONNECTION = "quish-history";
+const char *WRITE_CONNECTION = "quish-history-writer";
+// A batch is written when this many runs are queued, or after the interval
+const int BATCH_SIZE = 32;
+const int FLUSH_INTERVAL_MS = 2000;
+
+const char *SCHEMA[] = {
+    "CREATE TABLE IF NOT EXISTS runs ("
+    " id INTEGER PRIMARY KEY,"
+    " command TEXT NOT NULL,"
+    " command_line TEXT NOT NULL,"
+    " argv TEXT NOT NULL,"
+    " working_directory TEXT NOT NULL,"
+    " started_at INTEGER NOT NULL,"
+    " duration_ms INTEGER NOT NULL,"
+    " exit_code INTEGER NOT NULL,"
+    " user_ms INTEGER,"
+    " system_ms INTEGER,"
+    " max_rss_kb INTEGER,"
+    " output_bytes INTEGER NOT NULL)",
+    "CREATE INDEX IF NOT EXISTS runs_by_command ON runs (command, started_at)",
+};
+
+QVariant optional(qint64 value)
+{
+    return value < 0 ? QVariant() : QVariant(value);
+}
+
+// WAL lets the window read while the writer commits
+bool openDatabase(const QString &connection, QString *errorMessage)
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connection);
+    db.setDatabaseName(RunHistory::databasePath());
+    if (!db.open()) {
+        *errorMessage = db.lastError().text();
+        return false;
+    }
+    QSqlQuery query(db);
+    query.exec("PRAGMA journal_mode=WAL");
+    query.exec("PRAGMA synchronous=NORMAL");
+    query.exec("PRAGMA busy_timeout=5000");
+    return true;
+}
+
+}
+
+RunHistory::RunHistory(QObject *parent)
+    : QObject(parent)
+{
+    QDir().mkpath(QFileInfo(databasePath()).absolutePath());
+    if (!openDatabase(READ_CONNECTION, &m_errorString)) {
+        return;
+    }
+    QSqlDatabase db = QSqlDatabase::database(READ_CONNECTION);
+    QSqlQuery query(db);
+    for (const char *statement : SCHEMA) {
+        if (!query.exec(statement)) {
+            m_errorString = query.lastError().text();
+            return;
+        }
+    }
+    m_open = true;
+    m_writer = QThread::create([this]() { writeLoop(); });
+    m_writer->start();
+}
+
+RunHistory::~RunHistory()
+{
+    if (m_writer) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_quit = true;
+        }
+        m_queued.wakeAll();
+        m_writer->wait();
+        delete m_writer;
+    }
+    QSqlDatabase::removeDatabase(READ_CONNECTION);
+}
+
+QString RunHistory::databasePath()
+{
+    return QDir::homePath() + "/.Quish/history.sqlite";
+}
+
+void RunHistory::setUsage(Entry *entry, const struct rusage &usage)
+{
+    entry->userMs = usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+    entry->systemMs = usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+    entry->maxRssKb = usage.ru_maxrss;
+}
+
+void RunHistory::record(const Entry &entry)
+{
+    if (!m_open) {
+        return;
+    }
+    Entry queued = entry;
+    queued.id = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_queue.append(queued);
+        if (m_queue.size() >= BATCH_SIZE) {
+            m_queued.wakeAll();
+        }
+    }
+    emit recorded(queued);
+}
+
+QVector<RunHistory::Entry> RunHistory::recent(int limit, const QString &command) const
+{
+    QVector<Entry> entries;
+    if (!m_open) {
+        return entries;
+    }
+
+    // The newest runs may still be waiting for the writer. It commits under the
+    // lock, so a run is either pending or in the database, never both.
+    QMutexLocker locker(&m_mutex);
+    for (const QVector<Entry> *pending : { &m_queue, &m_writing }) {
+        for (auto it = pending->crbegin(); it != pending->crend() && entries.size() < limit; ++it) {
+            if (command.isEmpty() || it->command == command) {
+                entries.append(*it);
+            }
+        }
+    }
+
+    QSqlQuery query(QSqlDatabase::database(READ_CONNECTION));
+    query.prepare(QString("SELECT id, command, command_line, argv, working_directory, started_at, duration_ms,"
+                          " exit_code, user_ms, system_ms, max_rss_kb, output_bytes FROM runs%1"
+                          " ORDER BY id DESC LIMIT ?").arg(command.isEmpty() ? "" : " WHERE command = ?"));
+    if (!command.isEmpty()) {
+        query.addBindValue(command);
+    }
+    query.addBindValue(limit - entries.size());
+    query.exec();
+    while (query.next()) {
+        Entry entry;
+        entry.id = query.value(0).toLongLong();
+        entry.command = query.value(1).toString();
+        entry.commandLine = query.value(2).toString();
+        for (const QJsonValue &argument : QJsonDocument::fromJson(query.value(3).toByteArray()).array()) {
+            entry.argv.append(argument.toString());
+        }
+        entry.workingDirectory = query.value(4).toString();
+        entry.started = QDateTime::fromMSecsSinceEpoch(query.value(5).toLongLong());
+        entry.durationMs = query.value(6).toLongLong();
+        entry.exitCode = query.value(7).toInt();
+        entry.userMs = query.value(8).isNull() ? -1 : query.value(8).toLongLong();
+        entry.systemMs = query.value(9).isNull() ? -1 : query.value(9).toLongLong();
+        entry.maxRssKb = query.value(10).isNull() ? -1 : query.value(10).toLongLong();
+        entry.outputBytes = query.value(11).toLongLong();
+        entries.append(entry);
+    }
+    return entries;
+}
+
+QHash<QString, RunHistory::CommandStats> RunHistory::commandStats() const
+{
+    QHash<QString, CommandStats> stats;
+    if (!m_open) {
+        return stats;
+    }
+
+    // Under the lock for the same reason as in recent()
+    QMutexLocker locker(&m_mutex);
+    for (const QVector<Entry> *pending : { &m_queue, &m_writing }) {
+        for (const Entry &entry : *pending) {
+            CommandStats &command = stats[entry.command];
+            ++command.runs;
+            if (entry.exitCode != 0) {
+                ++command.failed;
+            }
+            if (!command.lastRun.isValid() || entry.started > command.lastRun) {
+                command.lastRun = entry.started;
+            }
+        }
+    }
+
+    QSqlQuery query(QSqlDatabase::database(READ_CONNECTION));
+    query.exec("SELECT command, COUNT(*), SUM(exit_code != 0), MAX(started_at) FROM runs GROUP BY command");
+    while (query.next()) {
+        CommandStats &command = stats[query.value(0).toString()];
+        command.runs += query.value(1).toInt();
+        command.failed += query.value(2).toInt();
+        QDateTime lastRun = QDateTime::fromMSecsSinceEpoch(query.value(3).toLongLong());
+        if (!command.lastRun.isValid() || lastRun > command.lastRun) {
+            command.lastRun = lastRun;
+        }
+    }
+    return stats;
+}
+
+// Writer thread: the only user of its connection
+void RunHistory::writeLoop()
+{
+    QString errorMessage;
+    bool opened = openDatabase(WRITE_CONNECTION, &errorMessage);
+    {
+        QSqlDatabase db = QSqlDatabase::database(WRITE_CONNECTION, false);
+        QMutexLocker locker(&m_mutex);
+        for (;;) {
+            if (m_queue.size() < BATCH_SIZE && !m_quit) {
+                m_queued.wait(&m_mutex, FLUSH_INTERVAL_MS);
+            }
+            if (m_queue.isEmpty()) {
+                if (m_quit) {
+                    break;
+                }
+                continue;
+            }
+            m_writing.swap(m_queue);
+            locker.unlock();
+
+            if (opened) {
+                db.transaction();
+                QSqlQuery insert(db);
+                insert.prepare("INSERT INTO runs (command, command_line, argv, working_directory,"
+                               " started_at, duration_ms, exit_code, user_ms, system_ms, max_rss_kb, output_bytes)"
+                               " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+                for (const Entry &entry : m_writing) {
+                    insert.addBindValue(entry.command);
+                    insert.addBindValue(entry.commandLine);
+                    insert.addBindValue(QString::fromUtf8(
+                        QJsonDocument(QJsonArray::fromStringList(entry.argv)).toJson(QJsonDocument::Compact)));
+                    insert.addBindValue(entry.workingDirectory);
+                    insert.addBindValue(entry.started.toMSecsSinceEpoch());
+                    insert.addBindValue(entry.durationMs);
+                    insert.addBindValue(entry.exitCode);
+                    insert.addBindValue(optional(entry.userMs));
+                    insert.addBindValue(optional(entry.systemMs));
+                    insert.addBindValue(optional(entry.maxRssKb));
+                    insert.addBindValue(entry.outputBytes);
+                    insert.exec();
+                }
+            }
+
+            // Readers see these runs either as pending or as stored
+            locker.relock();
+            if (opened) {
+                db.commit();
+            }
+            m_writing.clear();
+        }
+    }
+    QSqlDatabase::removeDatabase(WRITE_CONNECTION);
+}
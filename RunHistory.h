@@ -0,0 +1,78 @@
+#ifndef RUNHISTORY_H
+#define RUNHISTORY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <sys/resource.h>
+
+class QThread;
+
+// Every run of the window, kept in ~/.Quish/history.sqlite. Runs are queued
+// from the GUI thread and written in batches, one transaction each, by a
+// writer thread with its own connection; reads see the queued ones too.
+// Several Quish instances may share the file: SQLite hands out the ids.
+class RunHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry {
+        qint64 id = 0;              // 0 until written
+        QString command;            // "<topic>/<command>"
+        QString commandLine;
+        QStringList argv;           // what was exec'd; empty when it cannot be replayed as one line
+        QString workingDirectory;
+        QDateTime started;
+        qint64 durationMs = 0;
+        int exitCode = -1;
+        qint64 userMs = -1;         // -1 when the run's rusage is unknown
+        qint64 systemMs = -1;
+        qint64 maxRssKb = -1;
+        qint64 outputBytes = 0;
+    };
+
+    struct CommandStats {
+        int runs = 0;
+        int failed = 0;
+        QDateTime lastRun;
+    };
+
+    explicit RunHistory(QObject *parent = nullptr);
+    ~RunHistory();
+
+    bool isOpen() const { return m_open; }
+    QString errorString() const { return m_errorString; }
+
+    void record(const Entry &entry);
+    // Newest first, of one command when it is given
+    QVector<Entry> recent(int limit, const QString &command = QString()) const;
+    // Runs, failures and last run of every command, by "<topic>/<command>"
+    QHash<QString, CommandStats> commandStats() const;
+
+    static void setUsage(Entry *entry, const struct rusage &usage);
+    static QString databasePath();
+
+signals:
+    void recorded(const Entry &entry);
+
+private:
+    void writeLoop();
+
+    bool m_open = false;
+    QString m_errorString;
+    QThread *m_writer = nullptr;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_queued;
+    QVector<Entry> m_queue;
+    QVector<Entry> m_writing;       // taken by the writer, not committed yet; committed under m_mutex
+    bool m_quit = false;
+};
+
+#endif // RUNHISTORY_H
@@ -1,4 +1,5 @@
 #include "SaveCommandDialog.h"
+#include "Scheduling.h"
 #include <QFormLayout>
 #include <QLineEdit>
 #include <QRadioButton>
@@ -11,6 +12,7 @@
 #include <QJsonValue>
 #include <QVariant>
 #include <QScrollArea>
+#include <QMessageBox>
 
 SaveCommandDialog::SaveCommandDialog(QWidget *parent) : QDialog(parent)
 {
@@ -69,6 +71,22 @@ void SaveCommandDialog::setWidgets(QWidget *scrollAreaWidgetContents)
         currentRow++;
     }
 
+    QCheckBox *cpuCountersCheckBox = scrollAreaWidgetContents->findChild<QCheckBox*>("m_cpuCountersCheckBox");
+    if (cpuCountersCheckBox) {
+        QCheckBox *dialogCheckBox = new QCheckBox(this);
+        m_widgets.append(cpuCountersCheckBox);
+        m_checkBoxes.append(dialogCheckBox);
+
+        QLabel *nameLabel = new QLabel(cpuCountersCheckBox->text(), this);
+        QLabel *valueLabel = new QLabel(cpuCountersCheckBox->isChecked() ? "Checked" : "Unchecked", this);
+        valueLabel->setStyleSheet("font-style: italic;");
+
+        m_dialogGridLayout->addWidget(nameLabel, currentRow, 0);
+        m_dialogGridLayout->addWidget(valueLabel, currentRow, 1);
+        m_dialogGridLayout->addWidget(dialogCheckBox, currentRow, 2);
+        currentRow++;
+    }
+
     QCheckBox *clearOutputCheckBox = scrollAreaWidgetContents->findChild<QCheckBox*>("m_clearOutputCheckBox");
     if (clearOutputCheckBox) {
         QCheckBox *dialogCheckBox = new QCheckBox(this);
@@ -187,6 +205,9 @@ void SaveCommandDialog::setWidgets(QWidget *scrollAreaWidgetContents)
             }
         }
 
+        // Per-argument options (like batching) are saved along with their argument
+        if (sourceWidget && sourceWidget->property("formOption").toBool()) continue;
+
         // If we successfully identified a widget and its label, add it to the dialog
         if (sourceWidget && !labelText.isEmpty()) {
             QCheckBox *dialogCheckBox = new QCheckBox(this);
@@ -243,6 +264,10 @@ void SaveCommandDialog::onOkClicked()
             m_newCommand["sudo"] = qobject_cast<QCheckBox*>(widget)->isChecked();
             continue;
         }
+        if (widget->objectName() == "m_cpuCountersCheckBox") {
+            m_newCommand["cpu_counters"] = qobject_cast<QCheckBox*>(widget)->isChecked();
+            continue;
+        }
         if (widget->objectName() == "m_clearOutputCheckBox") {
             m_newCommand["clear_output"] = qobject_cast<QCheckBox*>(widget)->isChecked();
             continue;
@@ -253,6 +278,19 @@ void SaveCommandDialog::onOkClicked()
             continue;
         }
 
+        if (widget->objectName() == "m_schedulingLineEdit") {
+            QJsonObject scheduling;
+            QString error;
+            if (!Scheduling::fromText(qobject_cast<QLineEdit*>(widget)->text(), &scheduling, &error)) {
+                QMessageBox::warning(this, tr("Scheduling"), error);
+                return;
+            }
+            if (!scheduling.isEmpty()) {
+                m_newCommand["scheduling"] = scheduling;
+            }
+            continue;
+        }
+
         if (widget->objectName() == "miscLineEdit") {
             QJsonObject miscArg;
             miscArg["name"] = "Misc";
@@ -272,6 +310,12 @@ void SaveCommandDialog::onOkClicked()
         arg["flag"] = widget->property("argFlag").toString();
         arg["exclusive_group"] = widget->property("exclusiveGroup").toString();
         arg["mandatory"] = widget->property("mandatory").toBool();
+        if (arg["type"].toString() == "files" && widget->property("batch").toBool()) {
+            arg["batch"] = true;
+            if (widget->property("batchWorkers").toInt() > 0) {
+                arg["batch_workers"] = widget->property("batchWorkers").toInt();
+            }
+        }
 
         QVariant defaultValue;
         if (auto rb = qobject_cast<QRadioButton*>(widget)) defaultValue = rb->isChecked();
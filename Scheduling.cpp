@@ -0,0 +1,429 @@
+#include "Scheduling.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QRegularExpression>
+
+#include <algorithm>
+#include <iterator>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace Scheduling {
+
+namespace {
+
+const char *const KEYS[] = {
+    "cpus", "nice", "ionice", "rlimit_as", "rlimit_nofile", "rlimit_cpu", "cgroup", "cpu_max", "memory_max"
+};
+
+const char CGROUP_ROOT[] = "/sys/fs/cgroup";
+const qint64 CPU_MAX_PERIOD = 100000;
+
+// From linux/ioprio.h, which older kernel headers do not ship
+const int IOPRIO_CLASS_SHIFT = 13;
+const int IOPRIO_WHO_PROCESS = 1;
+enum { IoprioClassRealtime = 1, IoprioClassBestEffort = 2, IoprioClassIdle = 3 };
+
+QString tr(const char *text)
+{
+    return QCoreApplication::translate("Scheduling", text);
+}
+
+bool isKey(const QString &key)
+{
+    return std::find(std::begin(KEYS), std::end(KEYS), key) != std::end(KEYS);
+}
+
+QString valueText(const QJsonValue &value)
+{
+    return value.toVariant().toString().trimmed();
+}
+
+// "4G", "512M", "1024" bytes; "max" or "unlimited" is RLIM_INFINITY
+bool parseSize(const QString &text, rlim_t *size)
+{
+    static const QRegularExpression sizeRe("^(\\d+)\\s*([KMGT]?)(i?B)?$", QRegularExpression::CaseInsensitiveOption);
+    if (text == "max" || text == "unlimited") {
+        *size = RLIM_INFINITY;
+        return true;
+    }
+    QRegularExpressionMatch match = sizeRe.match(text);
+    if (!match.hasMatch()) {
+        return false;
+    }
+    rlim_t value = match.captured(1).toULongLong();
+    QString unit = match.captured(2).toUpper();
+    int shift = unit == "K" ? 10 : unit == "M" ? 20 : unit == "G" ? 30 : unit == "T" ? 40 : 0;
+    *size = value << shift;
+    return true;
+}
+
+bool parseCount(const QString &text, rlim_t *count)
+{
+    if (text == "max" || text == "unlimited") {
+        *count = RLIM_INFINITY;
+        return true;
+    }
+    bool ok;
+    *count = text.toULongLong(&ok);
+    return ok;
+}
+
+bool parseCpus(const QString &text, cpu_set_t *cpus)
+{
+    CPU_ZERO(cpus);
+    const QStringList parts = text.split(',', Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        QStringList range = part.trimmed().split('-');
+        bool firstOk;
+        bool lastOk = true;
+        int first = range.first().toInt(&firstOk);
+        int last = range.size() == 2 ? range.last().toInt(&lastOk) : first;
+        if (!firstOk || !lastOk || range.size() > 2 || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, cpus);
+        }
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+// "50%" of one CPU, "<quota> <period>" or "max", as cpu.max takes it
+bool parseCpuMax(const QString &text, QString *cpuMax)
+{
+    if (text.endsWith('%')) {
+        bool ok;
+        double percent = text.chopped(1).trimmed().toDouble(&ok);
+        if (!ok || percent <= 0) {
+            return false;
+        }
+        *cpuMax = QString("%1 %2").arg(qMax<qint64>(1000, qRound64(percent * CPU_MAX_PERIOD / 100))).arg(CPU_MAX_PERIOD);
+        return true;
+    }
+    QStringList parts = text.split(' ', Qt::SkipEmptyParts);
+    bool quotaOk = parts.value(0) == "max";
+    bool periodOk = parts.size() == 1;
+    if (!quotaOk) {
+        parts.value(0).toLongLong(&quotaOk);
+    }
+    if (parts.size() == 2) {
+        parts.value(1).toLongLong(&periodOk);
+    }
+    if (!quotaOk || !periodOk || parts.size() > 2) {
+        return false;
+    }
+    *cpuMax = parts.join(' ');
+    return true;
+}
+
+bool writeControl(const QString &path, const QByteArray &value, QString *reason)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CLOEXEC);
+    bool written = fd >= 0 && ::write(fd, value.constData(), value.size()) == value.size();
+    int error = errno;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!written) {
+        *reason = tr("cannot write %1: %2").arg(path, QString::fromLocal8Bit(strerror(error)));
+    }
+    return written;
+}
+
+// Path of Quish's own group, relative to the cgroup v2 root
+QString ownCgroup()
+{
+    QFile file("/proc/self/cgroup");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    for (const QByteArray &line : file.readAll().split('\n')) {
+        if (line.startsWith("0::")) {
+            return QString::fromLocal8Bit(line.mid(3));
+        }
+    }
+    return QString();
+}
+
+bool prepareCgroup(const QString &name, const QString &cpuMax, const QString &memoryMax, Prepared *prepared,
+                   QString *reason)
+{
+    if (!QFile::exists(QString(CGROUP_ROOT) + "/cgroup.controllers")) {
+        *reason = tr("cgroup v2 is not mounted at %1").arg(CGROUP_ROOT);
+        return false;
+    }
+
+    // A sibling of our own group by default: under systemd that is the delegated
+    // user slice, and our own group cannot get children while it has processes
+    QString directory = CGROUP_ROOT;
+    QString relative = name;
+    if (name.startsWith('/')) {
+        relative = name.mid(1);
+    } else {
+        QString own = ownCgroup();
+        directory += own.left(qMax(0, own.lastIndexOf('/')));
+    }
+
+    QStringList controllers;
+    if (!cpuMax.isEmpty()) {
+        controllers.append("cpu");
+    }
+    if (!memoryMax.isEmpty()) {
+        controllers.append("memory");
+    }
+
+    const QStringList components = relative.split('/', Qt::SkipEmptyParts);
+    if (components.isEmpty() || components.contains("..") || components.contains(".")) {
+        *reason = tr("invalid group name \"%1\"").arg(name);
+        return false;
+    }
+    for (const QString &component : components) {
+        // Limits in a group need its controllers enabled by the parent
+        QFile subtreeControl(directory + "/cgroup.subtree_control");
+        QStringList enabled;
+        if (subtreeControl.open(QIODevice::ReadOnly)) {
+            enabled = QString::fromLatin1(subtreeControl.readAll()).simplified().split(' ', Qt::SkipEmptyParts);
+            subtreeControl.close();
+        }
+        for (const QString &controller : controllers) {
+            if (!enabled.contains(controller)
+                && !writeControl(subtreeControl.fileName(), "+" + controller.toLatin1(), reason)) {
+                return false;
+            }
+        }
+
+        directory += "/" + component;
+        if (mkdir(QFile::encodeName(directory).constData(), 0755) != 0 && errno != EEXIST) {
+            int error = errno;
+            *reason = error == EACCES || error == EPERM || error == EROFS
+                          ? tr("%1 is not writable; is a cgroup delegated to you?").arg(directory.left(directory.lastIndexOf('/')))
+                          : tr("cannot create %1: %2").arg(directory, QString::fromLocal8Bit(strerror(error)));
+            return false;
+        }
+    }
+
+    if ((!cpuMax.isEmpty() && !writeControl(directory + "/cpu.max", cpuMax.toLatin1(), reason))
+        || (!memoryMax.isEmpty() && !writeControl(directory + "/memory.max", memoryMax.toLatin1(), reason))) {
+        return false;
+    }
+
+    QByteArray procs = QFile::encodeName(directory + "/cgroup.procs");
+    if (access(procs.constData(), W_OK) != 0 || procs.size() >= PATH_MAX) {
+        *reason = tr("cannot move processes into %1").arg(directory);
+        return false;
+    }
+    memcpy(prepared->cgroupProcs, procs.constData(), procs.size() + 1);
+    return true;
+}
+
+void prepareLimit(const QString &key, int resource, rlim_t value, Prepared *prepared, QStringList *warnings)
+{
+    // Unprivileged, the hard limit can only go down
+    struct rlimit current;
+    if (getrlimit(resource, &current) == 0 && current.rlim_max != RLIM_INFINITY && geteuid() != 0
+        && (value == RLIM_INFINITY || value > current.rlim_max)) {
+        warnings->append(tr("%1 is capped at the hard limit %2").arg(key).arg(static_cast<qulonglong>(current.rlim_max)));
+        value = current.rlim_max;
+    }
+    int index = prepared->limitCount++;
+    prepared->limitResources[index] = resource;
+    prepared->limits[index].rlim_cur = value;
+    prepared->limits[index].rlim_max = value;
+}
+
+}
+
+QString toText(const QJsonObject &scheduling)
+{
+    QStringList pairs;
+    for (const char *key : KEYS) {
+        if (scheduling.contains(key)) {
+            QString text = valueText(scheduling[key]);
+            // Values with spaces (cpu_max "50000 100000") are written with commas
+            pairs.append(QString("%1=%2").arg(key, text.replace(' ', ',')));
+        }
+    }
+    return pairs.join(' ');
+}
+
+bool fromText(const QString &text, QJsonObject *scheduling, QString *errorMessage)
+{
+    *scheduling = QJsonObject();
+    const QStringList pairs = text.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+    for (const QString &pair : pairs) {
+        int equals = pair.indexOf('=');
+        QString key = pair.left(equals);
+        QString value = pair.mid(equals + 1);
+        if (equals <= 0 || !isKey(key)) {
+            QStringList keys;
+            for (const char *known : KEYS) {
+                keys.append(known);
+            }
+            *errorMessage = tr("\"%1\" is not a scheduling setting; expected key=value with a key among: %2")
+                                .arg(pair, keys.join(", "));
+            return false;
+        }
+        if (key == "cpu_max") {
+            value.replace(',', ' ');
+        }
+        bool isNumber;
+        int number = value.toInt(&isNumber);
+        if (isNumber && (key == "nice" || key == "rlimit_nofile" || key == "rlimit_cpu")) {
+            scheduling->insert(key, number);
+        } else {
+            scheduling->insert(key, value);
+        }
+    }
+    return true;
+}
+
+bool prepare(const QJsonObject &scheduling, Prepared *prepared, QStringList *warnings, QString *errorMessage)
+{
+    *prepared = Prepared();
+    for (auto it = scheduling.begin(); it != scheduling.end(); ++it) {
+        if (!isKey(it.key())) {
+            *errorMessage = tr("Unknown scheduling setting \"%1\"").arg(it.key());
+            return false;
+        }
+    }
+    bool root = geteuid() == 0;
+
+    if (scheduling.contains("cpus")) {
+        QString text = valueText(scheduling["cpus"]);
+        if (!parseCpus(text, &prepared->cpus)) {
+            *errorMessage = tr("Invalid cpus \"%1\", expected a list like 0-3,6").arg(text);
+            return false;
+        }
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            cpu_set_t usable;
+            CPU_AND(&usable, &allowed, &prepared->cpus);
+            if (CPU_COUNT(&usable) == 0) {
+                *errorMessage = tr("None of the CPUs %1 is available here").arg(text);
+                return false;
+            }
+            if (CPU_COUNT(&usable) < CPU_COUNT(&prepared->cpus)) {
+                warnings->append(tr("CPUs outside %1 are not available and are left out").arg(text));
+            }
+        }
+        prepared->hasAffinity = true;
+    }
+
+    if (scheduling.contains("nice")) {
+        bool ok;
+        int nice = valueText(scheduling["nice"]).toInt(&ok);
+        if (!ok || nice < -20 || nice > 19) {
+            *errorMessage = tr("Invalid nice \"%1\", expected -20 to 19").arg(valueText(scheduling["nice"]));
+            return false;
+        }
+        // RLIMIT_NICE allows down to 20 - rlim_cur
+        struct rlimit limit;
+        errno = 0;
+        int current = getpriority(PRIO_PROCESS, 0);
+        if (!root && errno == 0 && nice < current && getrlimit(RLIMIT_NICE, &limit) == 0
+            && limit.rlim_cur != RLIM_INFINITY && static_cast<rlim_t>(20 - nice) > limit.rlim_cur) {
+            warnings->append(tr("nice %1 needs privileges, the command keeps nice %2").arg(nice).arg(current));
+        }
+        prepared->hasNice = true;
+        prepared->nice = nice;
+    }
+
+    if (scheduling.contains("ionice")) {
+        QString text = valueText(scheduling["ionice"]);
+        QString className = text.section(':', 0, 0);
+        bool levelOk = true;
+        int level = text.contains(':') ? text.section(':', 1).toInt(&levelOk) : 4;
+        int ioClass = className == "realtime" ? IoprioClassRealtime
+                      : className == "best-effort" ? IoprioClassBestEffort
+                      : className == "idle" ? IoprioClassIdle : 0;
+        if (ioClass == 0 || !levelOk || level < 0 || level > 7) {
+            *errorMessage = tr("Invalid ionice \"%1\", expected idle, best-effort[:0-7] or realtime[:0-7]").arg(text);
+            return false;
+        }
+        if (ioClass == IoprioClassRealtime && !root) {
+            warnings->append(tr("realtime I/O priority needs root, the command keeps its own"));
+        }
+        prepared->ioPriority = (ioClass << IOPRIO_CLASS_SHIFT) | (ioClass == IoprioClassIdle ? 0 : level);
+    }
+
+    const struct {
+        const char *key;
+        int resource;
+        bool isSize;
+    } limits[MaxLimits] = {
+        { "rlimit_as", RLIMIT_AS, true },
+        { "rlimit_nofile", RLIMIT_NOFILE, false },
+        { "rlimit_cpu", RLIMIT_CPU, false }
+    };
+    for (const auto &limit : limits) {
+        if (!scheduling.contains(limit.key)) {
+            continue;
+        }
+        QString text = valueText(scheduling[limit.key]);
+        rlim_t value;
+        if (!(limit.isSize ? parseSize(text, &value) : parseCount(text, &value))) {
+            *errorMessage = tr("Invalid %1 \"%2\"").arg(limit.key, text);
+            return false;
+        }
+        prepareLimit(limit.key, limit.resource, value, prepared, warnings);
+    }
+
+    QString cgroup = valueText(scheduling["cgroup"]);
+    QString cpuMax;
+    QString memoryMax;
+    if (scheduling.contains("cpu_max") && !parseCpuMax(valueText(scheduling["cpu_max"]), &cpuMax)) {
+        *errorMessage = tr("Invalid cpu_max \"%1\", expected 50% or \"<quota> <period>\"").arg(valueText(scheduling["cpu_max"]));
+        return false;
+    }
+    if (scheduling.contains("memory_max")) {
+        rlim_t bytes;
+        if (!parseSize(valueText(scheduling["memory_max"]), &bytes)) {
+            *errorMessage = tr("Invalid memory_max \"%1\"").arg(valueText(scheduling["memory_max"]));
+            return false;
+        }
+        memoryMax = bytes == RLIM_INFINITY ? QString("max") : QString::number(static_cast<qulonglong>(bytes));
+    }
+    if (cgroup.isEmpty() && (!cpuMax.isEmpty() || !memoryMax.isEmpty())) {
+        *errorMessage = tr("cpu_max and memory_max need a cgroup");
+        return false;
+    }
+    QString reason;
+    if (!cgroup.isEmpty() && !prepareCgroup(cgroup, cpuMax, memoryMax, prepared, &reason)) {
+        warnings->append(tr("not placed in cgroup %1: %2").arg(cgroup, reason));
+    }
+    return true;
+}
+
+void apply(const Prepared &prepared)
+{
+    if (prepared.cgroupProcs[0] != '\0') {
+        // "0" moves the writing process
+        int fd = ::open(prepared.cgroupProcs, O_WRONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            ssize_t written = ::write(fd, "0", 1);
+            (void)written;
+            ::close(fd);
+        }
+    }
+    if (prepared.hasAffinity) {
+        sched_setaffinity(0, sizeof(prepared.cpus), &prepared.cpus);
+    }
+    if (prepared.hasNice) {
+        setpriority(PRIO_PROCESS, 0, prepared.nice);
+    }
+    if (prepared.ioPriority >= 0) {
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, prepared.ioPriority);
+    }
+    for (int i = 0; i < prepared.limitCount; ++i) {
+        setrlimit(prepared.limitResources[i], &prepared.limits[i]);
+    }
+}
+
+}
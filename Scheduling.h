@@ -0,0 +1,50 @@
+#ifndef SCHEDULING_H
+#define SCHEDULING_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include <limits.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+// Resource envelope of a command, from its "scheduling" object:
+//   cpus        CPU affinity, e.g. "0-3,6"
+//   nice        -20..19
+//   ionice      "idle", "best-effort[:0-7]" or "realtime[:0-7]"
+//   rlimit_as   address space, e.g. "4G"; rlimit_nofile; rlimit_cpu in seconds
+//   cgroup      cgroup v2 group, next to Quish's own unless it starts with '/'
+//   cpu_max     "50%" or "<quota> <period>"; memory_max e.g. "2G"
+namespace Scheduling {
+
+enum { MaxLimits = 3 };
+
+// Everything the forked child needs, as plain data
+struct Prepared {
+    bool hasAffinity = false;
+    cpu_set_t cpus;
+    bool hasNice = false;
+    int nice = 0;
+    int ioPriority = -1;
+    int limitCount = 0;
+    int limitResources[MaxLimits];
+    struct rlimit limits[MaxLimits];
+    char cgroupProcs[PATH_MAX] = {};
+};
+
+// The form shows the settings as "key=value" pairs separated by spaces
+QString toText(const QJsonObject &scheduling);
+bool fromText(const QString &text, QJsonObject *scheduling, QString *errorMessage);
+
+// Checks the values and creates the cgroup. Invalid values fail; settings that
+// will not take effect (no privilege, no delegated cgroup) end up in warnings.
+bool prepare(const QJsonObject &scheduling, Prepared *prepared, QStringList *warnings, QString *errorMessage);
+
+// Async-signal-safe: called between fork and exec. Failures are ignored,
+// prepare() already warned about what can fail.
+void apply(const Prepared &prepared);
+
+}
+
+#endif // SCHEDULING_H
@@ -0,0 +1,253 @@
+#include "StdinFeeder.h"
+#include "ResourceMonitor.h"
+
+#include <QFile>
+#include <QThread>
+#include <QTimer>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const qint64 CHUNK_SIZE = 1024 * 1024;
+const int PIPE_SIZE = 1024 * 1024;
+
+// Short timeouts so a cancel is noticed while nothing comes in or the command
+// is not reading. The source is waited for first: the pipe is writable most of
+// the time, and a FIFO with no data would otherwise be spliced in a busy loop.
+bool waitReady(int source, int pipeWrite)
+{
+    struct pollfd fd;
+    if (source >= 0) {
+        fd.fd = source;
+        fd.events = POLLIN;
+        if (poll(&fd, 1, 100) <= 0) {
+            return false;
+        }
+    }
+    fd.fd = pipeWrite;
+    fd.events = POLLOUT;
+    return poll(&fd, 1, 100) > 0;
+}
+
+}
+
+StdinFeeder::StdinFeeder(QObject *parent)
+    : QObject(parent)
+    , m_progressTimer(new QTimer(this))
+{
+    m_progressTimer->setInterval(250);
+    connect(m_progressTimer, &QTimer::timeout, this, [this]() {
+        emit progress(m_fed, m_total);
+    });
+}
+
+StdinFeeder::~StdinFeeder()
+{
+    cancel();
+    delete m_thread;
+    closeAll();
+}
+
+bool StdinFeeder::open(const QString &path, QString *errorMessage)
+{
+    int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *errorMessage = tr("Cannot open %1 for stdin: %2").arg(path, QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+    bool opened = open(fd, errorMessage);
+    ::close(fd);
+    return opened;
+}
+
+bool StdinFeeder::open(int fd, QString *errorMessage)
+{
+    closeAll();
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || S_ISDIR(status.st_mode)) {
+        *errorMessage = tr("Nothing to feed to stdin");
+        return false;
+    }
+    m_source = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (m_source < 0) {
+        *errorMessage = tr("Cannot feed stdin: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        return false;
+    }
+    m_total = S_ISREG(status.st_mode) ? status.st_size : -1;
+    m_fed = 0;
+    m_error = 0;
+    m_cancelled = false;
+    return openPipe(errorMessage);
+}
+
+bool StdinFeeder::openPipe(QString *errorMessage)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        *errorMessage = tr("Cannot feed stdin: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+        closeAll();
+        return false;
+    }
+    m_pipeRead = fds[0];
+    m_pipeWrite = fds[1];
+    // Only our end is non-blocking, the command reads its stdin as usual
+    fcntl(m_pipeWrite, F_SETFL, fcntl(m_pipeWrite, F_GETFL) | O_NONBLOCK);
+    fcntl(m_pipeWrite, F_SETPIPE_SZ, PIPE_SIZE);
+    return true;
+}
+
+void StdinFeeder::releaseChildFd()
+{
+    if (m_pipeRead >= 0) {
+        ::close(m_pipeRead);
+        m_pipeRead = -1;
+    }
+}
+
+void StdinFeeder::start()
+{
+    if (m_thread || m_source < 0 || m_pipeWrite < 0) {
+        return;
+    }
+    m_thread = QThread::create([this]() { feed(); });
+    connect(m_thread, &QThread::finished, this, [this]() {
+        m_progressTimer->stop();
+        emit progress(m_fed, m_total);
+        emit finished();
+    });
+    m_progressTimer->start();
+    m_thread->start();
+}
+
+void StdinFeeder::cancel()
+{
+    m_cancelled = true;
+    if (m_thread) {
+        m_thread->wait();
+    }
+}
+
+bool StdinFeeder::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+QString StdinFeeder::summary() const
+{
+    QString fed = ResourceMonitor::formatBytes(m_fed);
+    int error = m_error;
+    if (error != 0 && error != EPIPE) {
+        return tr("stdin failed after %1: %2").arg(fed, QString::fromLocal8Bit(strerror(error)));
+    }
+    if (m_total < 0 || m_fed == m_total) {
+        return tr("stdin: %1 fed").arg(fed);
+    }
+    if (error == EPIPE) {
+        return tr("stdin closed by the command after %1 of %2").arg(fed, ResourceMonitor::formatBytes(m_total));
+    }
+    return tr("stdin: %1 of %2 fed").arg(fed, ResourceMonitor::formatBytes(m_total));
+}
+
+// Worker thread: only the descriptors and the atomics are touched from here
+void StdinFeeder::feed()
+{
+    // A command that exits without reading everything gives EPIPE, not a dead Quish
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+
+    // Regular files are read at explicit offsets, pipes and devices as they come
+    loff_t offset = 0;
+    loff_t *offsetPointer = m_total >= 0 ? &offset : nullptr;
+    while (!m_cancelled && (m_total < 0 || offset < m_total)) {
+        if (!waitReady(offsetPointer ? -1 : m_source, m_pipeWrite)) {
+            continue;
+        }
+        qint64 chunk = m_total >= 0 ? qMin<qint64>(CHUNK_SIZE, m_total - offset) : CHUNK_SIZE;
+        ssize_t count = splice(m_source, offsetPointer, m_pipeWrite, nullptr, chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (count > 0) {
+            if (!offsetPointer) {
+                offset += count;
+            }
+            m_fed = offset;
+            continue;
+        }
+        if (count == 0) {
+            break;
+        }
+        if (errno == EINTR || errno == EAGAIN) {
+            continue;
+        }
+        if (errno == EINVAL && offsetPointer) {
+            // Some file systems cannot splice; their pages can still be mapped
+            m_error = feedMapped() ? 0 : errno;
+        } else {
+            m_error = errno;
+        }
+        break;
+    }
+
+    // Closing our end is the command's EOF
+    ::close(m_pipeWrite);
+    m_pipeWrite = -1;
+    if (m_error == EPIPE) {
+        struct timespec immediately = { 0, 0 };
+        sigtimedwait(&pipeSignal, nullptr, &immediately);
+    }
+}
+
+bool StdinFeeder::feedMapped()
+{
+    qint64 offset = m_fed;
+    void *map = mmap(nullptr, m_total, PROT_READ, MAP_PRIVATE, m_source, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, m_total, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(map);
+    bool succeeded = true;
+    while (!m_cancelled && offset < m_total) {
+        if (!waitReady(-1, m_pipeWrite)) {
+            continue;
+        }
+        ssize_t count = write(m_pipeWrite, data + offset, qMin(CHUNK_SIZE, m_total - offset));
+        if (count > 0) {
+            offset += count;
+            m_fed = offset;
+            continue;
+        }
+        if (count < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        succeeded = false;
+        break;
+    }
+    int error = errno;
+    munmap(map, m_total);
+    errno = error;
+    return succeeded;
+}
+
+void StdinFeeder::closeAll()
+{
+    if (m_source >= 0) {
+        ::close(m_source);
+        m_source = -1;
+    }
+    releaseChildFd();
+    if (m_pipeWrite >= 0) {
+        ::close(m_pipeWrite);
+        m_pipeWrite = -1;
+    }
+}
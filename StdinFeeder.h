@@ -0,0 +1,64 @@
+#ifndef STDINFEEDER_H
+#define STDINFEEDER_H
+
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+
+class QThread;
+class QTimer;
+
+// Streams a file into a command's stdin from a worker thread. The data goes
+// from the page cache to the pipe with splice() (mmap and write when the
+// source cannot splice), so multi-GB inputs never pass through Quish's heap
+// or the GUI thread.
+class StdinFeeder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StdinFeeder(QObject *parent = nullptr);
+    ~StdinFeeder();
+
+    // The source is a file, or a descriptor such as the previous run's output,
+    // which is duplicated and read from its start
+    bool open(const QString &path, QString *errorMessage);
+    bool open(int fd, QString *errorMessage);
+
+    // Read end of the pipe, to become the child's stdin; released once the child has it
+    int childFd() const { return m_pipeRead; }
+    void releaseChildFd();
+
+    void start();
+    // Stops feeding and waits for the worker; the command then sees EOF
+    void cancel();
+    bool isRunning() const;
+
+    qint64 total() const { return m_total; }
+    qint64 fed() const { return m_fed; }
+    // "stdin: 4.0 GB fed" and the like, for the run summary
+    QString summary() const;
+
+signals:
+    void progress(qint64 fed, qint64 total);
+    void finished();
+
+private:
+    bool openPipe(QString *errorMessage);
+    void feed();
+    bool feedMapped();
+    void closeAll();
+
+    int m_source = -1;
+    int m_pipeRead = -1;
+    int m_pipeWrite = -1;
+    qint64 m_total = -1;    // -1 when the source has no size, such as a FIFO
+    std::atomic<qint64> m_fed { 0 };
+    std::atomic<bool> m_cancelled { false };
+    std::atomic<int> m_error { 0 };
+    QThread *m_thread = nullptr;
+    QTimer *m_progressTimer;
+};
+
+#endif // STDINFEEDER_H
@@ -0,0 +1,336 @@
+#include "SweepDialog.h"
+#include "ProcessPool.h"
+#include "ResourceMonitor.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QPlainTextEdit>
+#include <QDialogButtonBox>
+#include <QThread>
+#include <QRegularExpression>
+
+static const int MAX_SWEEP_COMBINATIONS = 10000;
+
+SweepDialog::SweepDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_pool(new ProcessPool(this))
+{
+    setWindowTitle(tr("Parameter Sweep"));
+    setMinimumSize(700, 500);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    mainLayout->addWidget(new QLabel(tr("Check the arguments to sweep and give their values "
+                                        "(e.g. \"1,2,4\", \"1..16\", \"0..100:10\" or \"1..64*2\"):"), this));
+    m_argsTable = new QTableWidget(0, 3, this);
+    m_argsTable->setHorizontalHeaderLabels(QStringList() << tr("Sweep") << tr("Argument") << tr("Values"));
+    m_argsTable->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
+    m_argsTable->verticalHeader()->setVisible(false);
+    mainLayout->addWidget(m_argsTable, 1);
+
+    QHBoxLayout *controlsLayout = new QHBoxLayout();
+    controlsLayout->addWidget(new QLabel(tr("Concurrency:"), this));
+    m_concurrencySpinBox = new QSpinBox(this);
+    m_concurrencySpinBox->setRange(1, 1024);
+    m_concurrencySpinBox->setValue(qMax(1, QThread::idealThreadCount()));
+    controlsLayout->addWidget(m_concurrencySpinBox);
+    controlsLayout->addStretch();
+    m_lblProgress = new QLabel(this);
+    controlsLayout->addWidget(m_lblProgress);
+    m_btnStart = new QPushButton(QIcon(":/icons/Player Play.png"), tr("Start"), this);
+    m_btnStop = new QPushButton(QIcon(":/icons/Player Stop.png"), tr("Stop"), this);
+    m_btnStop->setEnabled(false);
+    controlsLayout->addWidget(m_btnStart);
+    controlsLayout->addWidget(m_btnStop);
+    mainLayout->addLayout(controlsLayout);
+
+    m_resultsTable = new QTableWidget(0, 0, this);
+    m_resultsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_resultsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_resultsTable->setSortingEnabled(false);
+    m_resultsTable->verticalHeader()->setVisible(false);
+    mainLayout->addWidget(m_resultsTable, 2);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+
+    connect(m_btnStart, &QPushButton::clicked, this, &SweepDialog::onStartClicked);
+    connect(m_btnStop, &QPushButton::clicked, this, &SweepDialog::onStopClicked);
+    connect(m_concurrencySpinBox, QOverload<int>::of(&QSpinBox::valueChanged), m_pool, &ProcessPool::setMaxConcurrent);
+    connect(m_pool, &ProcessPool::jobStarted, this, &SweepDialog::onJobStarted);
+    connect(m_pool, &ProcessPool::jobFinished, this, &SweepDialog::onJobFinished);
+    connect(m_pool, &ProcessPool::allFinished, this, &SweepDialog::onAllFinished);
+    connect(m_resultsTable, &QTableWidget::cellDoubleClicked, this, &SweepDialog::showJobOutput);
+}
+
+void SweepDialog::setArguments(const QList<QPair<QString, QString>> &arguments, const QMap<QString, QString> &sweepSpecs)
+{
+    m_argsTable->setRowCount(0);
+    m_sweepCheckBoxes.clear();
+    m_valueLineEdits.clear();
+    m_argNames.clear();
+
+    for (const auto &argument : arguments) {
+        int row = m_argsTable->rowCount();
+        m_argsTable->insertRow(row);
+
+        QCheckBox *checkBox = new QCheckBox(m_argsTable);
+        QLineEdit *lineEdit = new QLineEdit(m_argsTable);
+        if (sweepSpecs.contains(argument.first)) {
+            lineEdit->setText(sweepSpecs.value(argument.first));
+            checkBox->setChecked(true);
+        } else {
+            lineEdit->setText(argument.second);
+        }
+        connect(lineEdit, &QLineEdit::textEdited, checkBox, [checkBox]() { checkBox->setChecked(true); });
+
+        QTableWidgetItem *nameItem = new QTableWidgetItem(argument.first);
+        nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
+        m_argsTable->setCellWidget(row, 0, checkBox);
+        m_argsTable->setItem(row, 1, nameItem);
+        m_argsTable->setCellWidget(row, 2, lineEdit);
+
+        m_sweepCheckBoxes.append(checkBox);
+        m_valueLineEdits.append(lineEdit);
+        m_argNames.append(argument.first);
+    }
+    m_argsTable->resizeColumnToContents(0);
+    m_argsTable->resizeColumnToContents(1);
+}
+
+void SweepDialog::setCommandLineBuilder(const CommandLineBuilder &builder)
+{
+    m_builder = builder;
+}
+
+void SweepDialog::setWorkingDirectory(const QString &workingDirectory)
+{
+    m_workingDirectory = workingDirectory;
+}
+
+void SweepDialog::setScheduling(const QSharedPointer<const Scheduling::Prepared> &scheduling)
+{
+    m_scheduling = scheduling;
+}
+
+QStringList SweepDialog::expandValues(const QString &spec, bool *truncated)
+{
+    static const QRegularExpression rangeRe("^\\s*(-?\\d+)\\s*\\.\\.\\s*(-?\\d+)\\s*(?:([:*])\\s*(\\d+))?\\s*$");
+    QStringList values;
+    if (truncated) {
+        *truncated = false;
+    }
+
+    for (const QString &part : spec.split(',', Qt::SkipEmptyParts)) {
+        QRegularExpressionMatch match = rangeRe.match(part);
+        bool fromOk = false;
+        bool toOk = false;
+        bool stepOk = true;
+        qint64 from = match.captured(1).toLongLong(&fromOk);
+        qint64 to = match.captured(2).toLongLong(&toOk);
+        bool geometric = match.captured(3) == "*";
+        qint64 step = match.captured(4).isEmpty() ? (geometric ? 2 : 1) : match.captured(4).toLongLong(&stepOk);
+        // Numbers that do not fit in 64 bits are taken as they are written, as is anything else
+        if (!match.hasMatch() || !fromOk || !toOk || !stepOk || step <= 0 || (geometric && (step < 2 || from <= 0))) {
+            values.append(part.trimmed());
+            continue;
+        }
+        if (from > to && geometric) {
+            continue;
+        }
+
+        // The distance left to the end is compared instead of stepping past it, which could overflow
+        for (qint64 v = from;;) {
+            if (values.size() >= MAX_SWEEP_COMBINATIONS) {
+                if (truncated) {
+                    *truncated = true;
+                }
+                return values;
+            }
+            values.append(QString::number(v));
+            if (geometric) {
+                if (v > to / step) {
+                    break;
+                }
+                v *= step;
+            } else if (from <= to) {
+                if (quint64(to) - quint64(v) < quint64(step)) {
+                    break;
+                }
+                v += step;
+            } else {
+                if (quint64(v) - quint64(to) < quint64(step)) {
+                    break;
+                }
+                v -= step;
+            }
+        }
+    }
+    return values;
+}
+
+void SweepDialog::onStartClicked()
+{
+    if (!m_builder) {
+        return;
+    }
+
+    QList<QStringList> valueLists;
+    m_sweptNames.clear();
+    for (int i = 0; i < m_argNames.size(); ++i) {
+        if (!m_sweepCheckBoxes[i]->isChecked()) {
+            continue;
+        }
+        bool truncated;
+        QStringList values = expandValues(m_valueLineEdits[i]->text(), &truncated);
+        if (values.isEmpty()) {
+            QMessageBox::warning(this, tr("Warning"), tr("No values given for argument '%1'.").arg(m_argNames[i]));
+            return;
+        }
+        if (truncated) {
+            QMessageBox::warning(this, tr("Warning"), tr("Too many values for argument '%1' (limit is %2).")
+                                                          .arg(m_argNames[i]).arg(MAX_SWEEP_COMBINATIONS));
+            return;
+        }
+        m_sweptNames.append(m_argNames[i]);
+        valueLists.append(values);
+    }
+
+    if (m_sweptNames.isEmpty()) {
+        QMessageBox::warning(this, tr("Warning"), tr("Select at least one argument to sweep."));
+        return;
+    }
+
+    qint64 combinations = 1;
+    for (const QStringList &values : valueLists) {
+        combinations *= values.size();
+        if (combinations > MAX_SWEEP_COMBINATIONS) {
+            QMessageBox::warning(this, tr("Warning"), tr("Too many combinations (limit is %1).").arg(MAX_SWEEP_COMBINATIONS));
+            return;
+        }
+    }
+
+    m_pool->clear();
+    m_pool->setMaxConcurrent(m_concurrencySpinBox->value());
+
+    QStringList headers = m_sweptNames;
+    headers << tr("Status") << tr("Exit Code") << tr("Wall (ms)") << tr("Output");
+    m_resultsTable->clear();
+    m_resultsTable->setColumnCount(headers.size());
+    m_resultsTable->setHorizontalHeaderLabels(headers);
+    m_resultsTable->setRowCount(0);
+
+    // Walk the cartesian product like an odometer, last argument varying fastest
+    QVector<int> indices(valueLists.size(), 0);
+    for (qint64 n = 0; n < combinations; ++n) {
+        QMap<QString, QString> overrides;
+        for (int i = 0; i < valueLists.size(); ++i) {
+            overrides.insert(m_sweptNames[i], valueLists[i][indices[i]]);
+        }
+
+        QString commandLine = m_builder(overrides);
+        if (commandLine.isEmpty()) {
+            m_pool->clear();
+            m_resultsTable->setRowCount(0);
+            return;
+        }
+        int id = m_pool->addJob(commandLine, m_workingDirectory, m_scheduling);
+
+        m_resultsTable->insertRow(id);
+        for (int i = 0; i < valueLists.size(); ++i) {
+            m_resultsTable->setItem(id, i, new QTableWidgetItem(valueLists[i][indices[i]]));
+        }
+        m_resultsTable->setItem(id, valueLists.size(), new QTableWidgetItem(tr("queued")));
+        m_resultsTable->item(id, 0)->setToolTip(commandLine);
+
+        for (int i = valueLists.size() - 1; i >= 0; --i) {
+            if (++indices[i] < valueLists[i].size()) {
+                break;
+            }
+            indices[i] = 0;
+        }
+    }
+    m_resultsTable->resizeColumnsToContents();
+
+    m_btnStart->setEnabled(false);
+    m_btnStop->setEnabled(true);
+    m_argsTable->setEnabled(false);
+    m_lblProgress->setText(tr("0 / %1").arg(m_pool->jobCount()));
+    m_pool->start();
+}
+
+void SweepDialog::onStopClicked()
+{
+    m_pool->cancel();
+}
+
+void SweepDialog::onJobStarted(int id)
+{
+    int statusColumn = m_sweptNames.size();
+    if (QTableWidgetItem *item = m_resultsTable->item(id, statusColumn)) {
+        item->setText(tr("running"));
+    }
+}
+
+void SweepDialog::onJobFinished(int id)
+{
+    const ProcessPool::Job &job = m_pool->job(id);
+    int column = m_sweptNames.size();
+    QColor color = job.exitCode == 0 ? QColor("green") : QColor("red");
+
+    m_resultsTable->setItem(id, column, new QTableWidgetItem(tr("done")));
+    QTableWidgetItem *exitItem = new QTableWidgetItem();
+    exitItem->setData(Qt::DisplayRole, job.exitCode);
+    exitItem->setForeground(color);
+    m_resultsTable->setItem(id, column + 1, exitItem);
+    QTableWidgetItem *wallItem = new QTableWidgetItem();
+    wallItem->setData(Qt::DisplayRole, job.elapsedMs);
+    m_resultsTable->setItem(id, column + 2, wallItem);
+    m_resultsTable->setItem(id, column + 3, new QTableWidgetItem(ResourceMonitor::formatBytes(job.output.size())));
+
+    m_lblProgress->setText(tr("%1 / %2").arg(m_pool->finishedCount()).arg(m_pool->jobCount()));
+}
+
+void SweepDialog::onAllFinished()
+{
+    int statusColumn = m_sweptNames.size();
+    for (int id = 0; id < m_pool->jobCount(); ++id) {
+        if (!m_pool->job(id).started) {
+            if (QTableWidgetItem *item = m_resultsTable->item(id, statusColumn)) {
+                item->setText(tr("cancelled"));
+            }
+        }
+    }
+    m_resultsTable->resizeColumnsToContents();
+    m_btnStart->setEnabled(true);
+    m_btnStop->setEnabled(false);
+    m_argsTable->setEnabled(true);
+}
+
+void SweepDialog::showJobOutput(int row, int column)
+{
+    Q_UNUSED(column);
+    if (row < 0 || row >= m_pool->jobCount()) {
+        return;
+    }
+    const ProcessPool::Job &job = m_pool->job(row);
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(job.commandLine);
+    dialog.resize(700, 450);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QPlainTextEdit *txtOutput = new QPlainTextEdit(&dialog);
+    QFont monospaceFont("Monospace");
+    monospaceFont.setStyleHint(QFont::Monospace);
+    txtOutput->setFont(monospaceFont);
+    txtOutput->setReadOnly(true);
+    txtOutput->setPlainText(QString::fromLocal8Bit(job.output));
+    layout->addWidget(new QLabel(job.commandLine, &dialog));
+    layout->addWidget(txtOutput);
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttonBox, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttonBox);
+    dialog.exec();
+}
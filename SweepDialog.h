@@ -0,0 +1,66 @@
+#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+
+#include <QDialog>
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QTableWidget>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QCheckBox>
+#include <QLineEdit>
+#include <QSharedPointer>
+#include <functional>
+#include "Scheduling.h"
+
+class ProcessPool;
+
+class SweepDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<QString(const QMap<QString, QString> &)> CommandLineBuilder;
+
+    explicit SweepDialog(QWidget *parent = nullptr);
+
+    // Each argument is given as (name, current value, sweep spec from the config)
+    void setArguments(const QList<QPair<QString, QString>> &arguments, const QMap<QString, QString> &sweepSpecs);
+    void setCommandLineBuilder(const CommandLineBuilder &builder);
+    void setWorkingDirectory(const QString &workingDirectory);
+    // Applied to every run of the sweep
+    void setScheduling(const QSharedPointer<const Scheduling::Prepared> &scheduling);
+
+    // "1,2,5", "1..10", "1..100:10" or "1..1024*2"; truncated is set when the
+    // values would go past the combination limit
+    static QStringList expandValues(const QString &spec, bool *truncated = nullptr);
+
+private slots:
+    void onStartClicked();
+    void onStopClicked();
+    void onJobStarted(int id);
+    void onJobFinished(int id);
+    void onAllFinished();
+    void showJobOutput(int row, int column);
+
+private:
+    QTableWidget *m_argsTable;
+    QTableWidget *m_resultsTable;
+    QSpinBox *m_concurrencySpinBox;
+    QPushButton *m_btnStart;
+    QPushButton *m_btnStop;
+    QLabel *m_lblProgress;
+    QList<QCheckBox*> m_sweepCheckBoxes;
+    QList<QLineEdit*> m_valueLineEdits;
+    QStringList m_argNames;
+    QStringList m_sweptNames;
+    CommandLineBuilder m_builder;
+    QString m_workingDirectory;
+    QSharedPointer<const Scheduling::Prepared> m_scheduling;
+    ProcessPool *m_pool;
+};
+
+#endif // SWEEPDIALOG_H
@@ -0,0 +1,221 @@
+#include "WatchController.h"
+
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QVector>
+#include <QPair>
+
+// Past this many cells the middle of a diff is shown as removed + added
+static const qint64 MAX_DIFF_CELLS = 4000000;
+
+WatchController::WatchController(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_debounceTimer(new QTimer(this))
+    , m_intervalTimer(new QTimer(this))
+{
+    m_debounceTimer->setSingleShot(true);
+    connect(m_debounceTimer, &QTimer::timeout, this, [this]() {
+        // Editors save by replacing the file, which drops it from the watcher
+        refreshWatches();
+        emit changed(m_pendingReason);
+    });
+    connect(m_intervalTimer, &QTimer::timeout, this, [this]() {
+        emit tick();
+    });
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &WatchController::onPathChanged);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &WatchController::onPathChanged);
+}
+
+void WatchController::start(const QStringList &paths, const QStringList &globs, const QString &baseDirectory,
+                            int intervalMs, int debounceMs)
+{
+    stop();
+    m_paths = paths;
+    m_globs = globs;
+    m_baseDirectory = baseDirectory;
+    m_debounceTimer->setInterval(qMax(0, debounceMs));
+    refreshWatches();
+    if (intervalMs > 0) {
+        m_intervalTimer->start(intervalMs);
+    }
+    m_active = true;
+}
+
+void WatchController::stop()
+{
+    m_active = false;
+    m_debounceTimer->stop();
+    m_intervalTimer->stop();
+    if (!m_watcher->files().isEmpty()) {
+        m_watcher->removePaths(m_watcher->files());
+    }
+    if (!m_watcher->directories().isEmpty()) {
+        m_watcher->removePaths(m_watcher->directories());
+    }
+}
+
+int WatchController::watchedCount() const
+{
+    return m_watcher->files().size() + m_watcher->directories().size();
+}
+
+void WatchController::refreshWatches()
+{
+    QStringList files;
+    QStringList directories;
+    m_watchedDirectories.clear();
+    m_globMatches.clear();
+    m_missingCount = 0;
+
+    QDir base(m_baseDirectory);
+    for (const QString &path : m_paths) {
+        QFileInfo info(base.absoluteFilePath(path));
+        if (info.isDir()) {
+            directories.append(info.absoluteFilePath());
+            m_watchedDirectories.append(info.absoluteFilePath());
+        } else if (info.exists()) {
+            files.append(info.absoluteFilePath());
+        } else if (QFileInfo(info.absolutePath()).isDir()) {
+            // Notice when it gets created
+            directories.append(info.absolutePath());
+            m_missingCount++;
+        }
+    }
+
+    // Globs match file names in one directory, e.g. "src/*.cpp"
+    for (const QString &glob : m_globs) {
+        QFileInfo info(base.absoluteFilePath(glob));
+        QDir directory(info.absolutePath());
+        if (!directory.exists()) {
+            continue;
+        }
+        directories.append(directory.absolutePath());
+        const QStringList entries = directory.entryList(QStringList() << info.fileName(), QDir::Files);
+        for (const QString &entry : entries) {
+            files.append(directory.absoluteFilePath(entry));
+            m_globMatches.append(directory.absoluteFilePath(entry));
+        }
+    }
+    m_globMatches.sort();
+
+    files.removeDuplicates();
+    directories.removeDuplicates();
+    QStringList stale = m_watcher->files() + m_watcher->directories();
+    if (!stale.isEmpty()) {
+        m_watcher->removePaths(stale);
+    }
+    if (!files.isEmpty()) {
+        m_watcher->addPaths(files);
+    }
+    if (!directories.isEmpty()) {
+        m_watcher->addPaths(directories);
+    }
+}
+
+void WatchController::onPathChanged(const QString &path)
+{
+    if (!m_active) {
+        return;
+    }
+
+    // Directories watched only for globs or missing files: any other entry
+    // coming and going there is not our business
+    if (!m_watchedDirectories.contains(path) && QFileInfo(path).isDir()) {
+        QStringList matchesBefore = m_globMatches;
+        int missingBefore = m_missingCount;
+        refreshWatches();
+        if (m_globMatches == matchesBefore && m_missingCount == missingBefore) {
+            return;
+        }
+    }
+
+    m_pendingReason = tr("%1 changed").arg(QFileInfo(path).fileName());
+    m_debounceTimer->start();
+}
+
+QStringList WatchController::diffLines(const QStringList &before, const QStringList &after, int context)
+{
+    const int n = before.size();
+    const int m = after.size();
+    int prefix = 0;
+    while (prefix < n && prefix < m && before[prefix] == after[prefix]) {
+        prefix++;
+    }
+    int suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix && before[n - 1 - suffix] == after[m - 1 - suffix]) {
+        suffix++;
+    }
+
+    // (operation, line) for the whole text: ' ' kept, '-' removed, '+' added
+    QVector<QPair<char, QString>> operations;
+    for (int i = 0; i < prefix; ++i) {
+        operations.append(qMakePair(' ', before[i]));
+    }
+
+    const int rows = n - prefix - suffix;
+    const int columns = m - prefix - suffix;
+    if (static_cast<qint64>(rows + 1) * (columns + 1) <= MAX_DIFF_CELLS) {
+        // Longest common subsequence of the middle part
+        QVector<int> lengths((rows + 1) * (columns + 1), 0);
+        auto at = [&](int i, int j) -> int & { return lengths[i * (columns + 1) + j]; };
+        for (int i = rows - 1; i >= 0; --i) {
+            for (int j = columns - 1; j >= 0; --j) {
+                at(i, j) = before[prefix + i] == after[prefix + j] ? at(i + 1, j + 1) + 1 : qMax(at(i + 1, j), at(i, j + 1));
+            }
+        }
+        int i = 0;
+        int j = 0;
+        while (i < rows || j < columns) {
+            if (i < rows && j < columns && before[prefix + i] == after[prefix + j]) {
+                operations.append(qMakePair(' ', before[prefix + i]));
+                i++;
+                j++;
+            } else if (i < rows && (j == columns || at(i + 1, j) >= at(i, j + 1))) {
+                operations.append(qMakePair('-', before[prefix + i]));
+                i++;
+            } else {
+                operations.append(qMakePair('+', after[prefix + j]));
+                j++;
+            }
+        }
+    } else {
+        for (int i = 0; i < rows; ++i) {
+            operations.append(qMakePair('-', before[prefix + i]));
+        }
+        for (int j = 0; j < columns; ++j) {
+            operations.append(qMakePair('+', after[prefix + j]));
+        }
+    }
+
+    for (int i = n - suffix; i < n; ++i) {
+        operations.append(qMakePair(' ', before[i]));
+    }
+
+    // Keep the changes and their context, eliding the rest
+    QVector<bool> shown(operations.size(), false);
+    for (int k = 0; k < operations.size(); ++k) {
+        if (operations[k].first != ' ') {
+            int last = qMin(static_cast<int>(operations.size()) - 1, k + context);
+            for (int c = qMax(0, k - context); c <= last; ++c) {
+                shown[c] = true;
+            }
+        }
+    }
+    QStringList lines;
+    bool elided = false;
+    for (int k = 0; k < operations.size(); ++k) {
+        if (!shown[k]) {
+            elided = true;
+            continue;
+        }
+        if (elided && !lines.isEmpty()) {
+            lines.append("...");
+        }
+        elided = false;
+        lines.append(QString(QLatin1Char(operations[k].first)) + QLatin1Char(' ') + operations[k].second);
+    }
+    return lines;
+}
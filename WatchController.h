@@ -0,0 +1,50 @@
+#ifndef WATCHCONTROLLER_H
+#define WATCHCONTROLLER_H
+
+#include <QObject>
+#include <QStringList>
+
+class QFileSystemWatcher;
+class QTimer;
+
+// Emits changed() when watched paths or glob matches change (debounced),
+// and tick() periodically when an interval is set
+class WatchController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WatchController(QObject *parent = nullptr);
+
+    // Relative paths and globs are taken from baseDirectory
+    void start(const QStringList &paths, const QStringList &globs, const QString &baseDirectory,
+               int intervalMs, int debounceMs);
+    void stop();
+    bool isActive() const { return m_active; }
+    int watchedCount() const;
+
+    // Changed lines of after against before, with a little context, "+ "/"- " prefixed
+    static QStringList diffLines(const QStringList &before, const QStringList &after, int context = 2);
+
+signals:
+    void changed(const QString &reason);
+    void tick();
+
+private:
+    void onPathChanged(const QString &path);
+    void refreshWatches();
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_debounceTimer;
+    QTimer *m_intervalTimer;
+    QStringList m_paths;
+    QStringList m_globs;
+    QString m_baseDirectory;
+    QStringList m_watchedDirectories;   // given as paths, any change there counts
+    QStringList m_globMatches;
+    int m_missingCount = 0;
+    QString m_pendingReason;
+    bool m_active = false;
+};
+
+#endif // WATCHCONTROLLER_H
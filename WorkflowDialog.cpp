@@ -0,0 +1,389 @@
+#include "WorkflowDialog.h"
+#include "WorkflowRunner.h"
+#include "ResourceMonitor.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QDialogButtonBox>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QGraphicsRectItem>
+#include <QGraphicsSimpleTextItem>
+#include <QGraphicsPathItem>
+#include <QPainterPath>
+#include <QFontDatabase>
+#include <QTimer>
+
+static const qreal NODE_WIDTH = 170;
+static const qreal NODE_HEIGHT = 50;
+static const qreal LAYER_GAP = 70;
+static const qreal ROW_GAP = 20;
+static const QColor CRITICAL_COLOR(230, 120, 0);
+
+static QColor stateColor(WorkflowRunner::NodeState state)
+{
+    switch (state) {
+    case WorkflowRunner::Waiting:
+        return QColor(235, 235, 235);
+    case WorkflowRunner::Ready:
+        return QColor(255, 243, 176);
+    case WorkflowRunner::Running:
+        return QColor(158, 203, 255);
+    case WorkflowRunner::Succeeded:
+        return QColor(168, 230, 161);
+    case WorkflowRunner::Failed:
+        return QColor(244, 166, 166);
+    case WorkflowRunner::Skipped:
+        return QColor(210, 210, 210);
+    }
+    return Qt::white;
+}
+
+WorkflowDialog::WorkflowDialog(QWidget *parent)
+    : QDialog(parent)
+    , m_scene(new QGraphicsScene(this))
+    , m_refreshTimer(new QTimer(this))
+    , m_runner(new WorkflowRunner(this))
+{
+    setWindowTitle(tr("Workflows"));
+    setMinimumSize(800, 600);
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *controlsLayout = new QHBoxLayout();
+    controlsLayout->addWidget(new QLabel(tr("Workflow:"), this));
+    m_workflowComboBox = new QComboBox(this);
+    controlsLayout->addWidget(m_workflowComboBox);
+    controlsLayout->addWidget(new QLabel(tr("Max parallel:"), this));
+    m_parallelSpinBox = new QSpinBox(this);
+    m_parallelSpinBox->setRange(1, 1024);
+    controlsLayout->addWidget(m_parallelSpinBox);
+    controlsLayout->addStretch();
+    m_lblProgress = new QLabel(this);
+    controlsLayout->addWidget(m_lblProgress);
+    m_btnStart = new QPushButton(QIcon(":/icons/Player Play.png"), tr("Start"), this);
+    m_btnStop = new QPushButton(QIcon(":/icons/Player Stop.png"), tr("Stop"), this);
+    m_btnStop->setEnabled(false);
+    controlsLayout->addWidget(m_btnStart);
+    controlsLayout->addWidget(m_btnStop);
+    mainLayout->addLayout(controlsLayout);
+
+    m_view = new QGraphicsView(m_scene, this);
+    m_view->setRenderHint(QPainter::Antialiasing);
+    m_view->setDragMode(QGraphicsView::ScrollHandDrag);
+    mainLayout->addWidget(m_view, 3);
+
+    m_lblCriticalPath = new QLabel(this);
+    m_lblCriticalPath->setWordWrap(true);
+    mainLayout->addWidget(m_lblCriticalPath);
+
+    m_outputText = new QPlainTextEdit(this);
+    m_outputText->setReadOnly(true);
+    m_outputText->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_outputText->setPlaceholderText(tr("Click a node to see its command and output"));
+    mainLayout->addWidget(m_outputText, 1);
+
+    QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttonBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttonBox);
+
+    m_refreshTimer->setInterval(200);
+    connect(m_refreshTimer, &QTimer::timeout, this, [this]() {
+        for (int i = 0; i < m_runner->nodeCount(); ++i) {
+            if (m_runner->node(i).state == WorkflowRunner::Running) {
+                updateNode(i);
+            }
+        }
+        updateCriticalPath();
+        updateProgress();
+        showNodeOutput();
+    });
+
+    connect(m_workflowComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &WorkflowDialog::onWorkflowChanged);
+    connect(m_parallelSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), m_runner, &WorkflowRunner::setMaxParallel);
+    connect(m_btnStart, &QPushButton::clicked, this, &WorkflowDialog::onStartClicked);
+    connect(m_btnStop, &QPushButton::clicked, this, &WorkflowDialog::onStopClicked);
+    connect(m_runner, &WorkflowRunner::nodeChanged, this, &WorkflowDialog::onNodeChanged);
+    connect(m_runner, &WorkflowRunner::finished, this, &WorkflowDialog::onFinished);
+    connect(m_scene, &QGraphicsScene::selectionChanged, this, &WorkflowDialog::onSelectionChanged);
+}
+
+void WorkflowDialog::setWorkflows(const QJsonObject &workflows, const QJsonObject &topics)
+{
+    m_workflows = workflows;
+    m_topics = topics;
+    m_workflowComboBox->blockSignals(true);
+    m_workflowComboBox->clear();
+    m_workflowComboBox->addItems(workflows.keys());
+    m_workflowComboBox->blockSignals(false);
+    onWorkflowChanged(m_workflowComboBox->currentIndex());
+}
+
+void WorkflowDialog::selectWorkflow(const QString &name)
+{
+    int index = m_workflowComboBox->findText(name);
+    if (index >= 0) {
+        m_workflowComboBox->setCurrentIndex(index);
+    }
+}
+
+void WorkflowDialog::reject()
+{
+    m_refreshTimer->stop();
+    m_runner->disconnect(this);
+    m_runner->cancel();
+    QDialog::reject();
+}
+
+void WorkflowDialog::onWorkflowChanged(int index)
+{
+    m_selectedNode = -1;
+    m_outputText->clear();
+    m_lblProgress->setStyleSheet(QString());
+    if (index < 0) {
+        m_scene->clear();
+        m_nodeItems.clear();
+        m_edges.clear();
+        m_btnStart->setEnabled(false);
+        return;
+    }
+
+    QString errorMessage;
+    QJsonObject workflow = m_workflows[m_workflowComboBox->itemText(index)].toObject();
+    bool loaded = m_runner->load(workflow, m_topics, &errorMessage);
+    m_parallelSpinBox->setValue(m_runner->maxParallel());
+    buildScene();
+    m_btnStart->setEnabled(loaded);
+    if (!loaded) {
+        m_lblProgress->setStyleSheet("color: red;");
+        m_lblProgress->setText(errorMessage);
+        m_lblCriticalPath->clear();
+        return;
+    }
+    updateProgress();
+    updateCriticalPath();
+}
+
+void WorkflowDialog::onStartClicked()
+{
+    m_workflowComboBox->setEnabled(false);
+    m_btnStart->setEnabled(false);
+    m_btnStop->setEnabled(true);
+    m_lblProgress->setStyleSheet(QString());
+    m_shownOutputSize = -1;
+    m_refreshTimer->start();
+    m_runner->start();
+}
+
+void WorkflowDialog::onStopClicked()
+{
+    m_btnStop->setEnabled(false);
+    m_runner->cancel();
+}
+
+void WorkflowDialog::onNodeChanged(int index)
+{
+    updateNode(index);
+    updateCriticalPath();
+    updateProgress();
+    if (index == m_selectedNode) {
+        showNodeOutput();
+    }
+}
+
+void WorkflowDialog::onFinished(bool succeeded)
+{
+    m_refreshTimer->stop();
+    m_workflowComboBox->setEnabled(true);
+    m_btnStart->setEnabled(true);
+    m_btnStop->setEnabled(false);
+    for (int i = 0; i < m_runner->nodeCount(); ++i) {
+        updateNode(i);
+    }
+    updateCriticalPath();
+    updateProgress();
+    if (!succeeded) {
+        m_lblProgress->setStyleSheet("color: red;");
+    }
+    showNodeOutput();
+}
+
+void WorkflowDialog::onSelectionChanged()
+{
+    m_selectedNode = -1;
+    const QList<QGraphicsItem*> selected = m_scene->selectedItems();
+    if (!selected.isEmpty()) {
+        m_selectedNode = selected.first()->data(0).toInt();
+    }
+    m_shownOutputSize = -1;
+    showNodeOutput();
+}
+
+// Layered layout: a node sits one column right of its deepest dependency
+void WorkflowDialog::buildScene()
+{
+    m_scene->clear();
+    m_nodeItems.clear();
+    m_edges.clear();
+    m_nodeItems.resize(m_runner->nodeCount());
+
+    QVector<int> rows(m_runner->layerCount(), 0);
+    QVector<QPointF> positions(m_runner->nodeCount());
+    for (int i = 0; i < m_runner->nodeCount(); ++i) {
+        const WorkflowRunner::Node &node = m_runner->node(i);
+        positions[i] = QPointF(node.layer * (NODE_WIDTH + LAYER_GAP), rows[node.layer]++ * (NODE_HEIGHT + ROW_GAP));
+
+        NodeItems &items = m_nodeItems[i];
+        items.box = m_scene->addRect(0, 0, NODE_WIDTH, NODE_HEIGHT);
+        items.box->setPos(positions[i]);
+        items.box->setFlag(QGraphicsItem::ItemIsSelectable);
+        items.box->setData(0, i);
+        items.box->setZValue(1);
+        items.box->setToolTip(QString("%1\n%2").arg(node.commandLine, node.workingDirectory));
+
+        items.title = new QGraphicsSimpleTextItem(node.id, items.box);
+        QFont font = items.title->font();
+        font.setBold(true);
+        items.title->setFont(font);
+        items.title->setPos(8, 6);
+        items.timing = new QGraphicsSimpleTextItem(items.box);
+        items.timing->setPos(8, 27);
+    }
+
+    for (int i = 0; i < m_runner->nodeCount(); ++i) {
+        for (int dependency : m_runner->node(i).dependsOn) {
+            QPointF start = positions[dependency] + QPointF(NODE_WIDTH, NODE_HEIGHT / 2);
+            QPointF end = positions[i] + QPointF(0, NODE_HEIGHT / 2);
+            QPainterPath path(start);
+            qreal bend = (end.x() - start.x()) / 2;
+            path.cubicTo(start + QPointF(bend, 0), end - QPointF(bend, 0), end);
+            path.moveTo(end);
+            path.lineTo(end + QPointF(-8, -4));
+            path.moveTo(end);
+            path.lineTo(end + QPointF(-8, 4));
+
+            EdgeItem edge;
+            edge.from = dependency;
+            edge.to = i;
+            edge.path = m_scene->addPath(path);
+            m_edges.append(edge);
+        }
+    }
+
+    for (int i = 0; i < m_runner->nodeCount(); ++i) {
+        updateNode(i);
+    }
+    m_scene->setSceneRect(m_scene->itemsBoundingRect().adjusted(-20, -20, 20, 20));
+}
+
+void WorkflowDialog::updateNode(int index)
+{
+    if (index >= m_nodeItems.size()) {
+        return;
+    }
+    const WorkflowRunner::Node &node = m_runner->node(index);
+    NodeItems &items = m_nodeItems[index];
+    items.box->setBrush(stateColor(node.state));
+
+    QString timing = WorkflowRunner::stateName(node.state);
+    if (node.state == WorkflowRunner::Running || node.state == WorkflowRunner::Succeeded) {
+        timing += " " + ResourceMonitor::formatMs(m_runner->nodeTimeMs(index));
+    } else if (node.state == WorkflowRunner::Failed) {
+        timing += QString(" %1, exit %2").arg(ResourceMonitor::formatMs(m_runner->nodeTimeMs(index))).arg(node.exitCode);
+    }
+    items.timing->setText(timing);
+}
+
+void WorkflowDialog::updateCriticalPath()
+{
+    qint64 totalMs = 0;
+    QVector<int> path = m_runner->criticalPath(&totalMs);
+
+    for (int i = 0; i < m_nodeItems.size(); ++i) {
+        bool critical = totalMs > 0 && path.contains(i);
+        QPen pen(critical ? CRITICAL_COLOR : QColor(Qt::black), critical ? 3 : 1);
+        if (m_runner->node(i).state == WorkflowRunner::Skipped) {
+            pen.setStyle(Qt::DashLine);
+        }
+        m_nodeItems[i].box->setPen(pen);
+    }
+    for (const EdgeItem &edge : m_edges) {
+        int position = path.indexOf(edge.from);
+        bool critical = totalMs > 0 && position >= 0 && position + 1 < path.size() && path[position + 1] == edge.to;
+        edge.path->setPen(QPen(critical ? CRITICAL_COLOR : QColor(Qt::gray), critical ? 3 : 1.5));
+        edge.path->setZValue(critical ? 0.5 : 0);
+    }
+
+    if (totalMs <= 0) {
+        m_lblCriticalPath->setText(tr("Critical path: known once the workflow runs"));
+        return;
+    }
+    QStringList ids;
+    for (int index : path) {
+        ids.append(QString("%1 (%2)").arg(m_runner->node(index).id, ResourceMonitor::formatMs(m_runner->nodeTimeMs(index))));
+    }
+    m_lblCriticalPath->setText(tr("Critical path: %1 = %2 of %3 wall time")
+                                   .arg(ids.join(QString::fromUtf8(" → ")), ResourceMonitor::formatMs(totalMs),
+                                        ResourceMonitor::formatMs(m_runner->elapsedMs())));
+}
+
+void WorkflowDialog::updateProgress()
+{
+    int done = 0;
+    int failed = 0;
+    int skipped = 0;
+    int running = 0;
+    for (int i = 0; i < m_runner->nodeCount(); ++i) {
+        switch (m_runner->node(i).state) {
+        case WorkflowRunner::Succeeded:
+            done++;
+            break;
+        case WorkflowRunner::Failed:
+            failed++;
+            break;
+        case WorkflowRunner::Skipped:
+            skipped++;
+            break;
+        case WorkflowRunner::Running:
+            running++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    QString text = tr("%1/%2 done").arg(done).arg(m_runner->nodeCount());
+    if (running > 0) {
+        text += tr(", %1 running").arg(running);
+    }
+    if (failed > 0) {
+        text += tr(", %1 failed").arg(failed);
+    }
+    if (skipped > 0) {
+        text += tr(", %1 skipped").arg(skipped);
+    }
+    if (m_runner->elapsedMs() > 0) {
+        text += " - " + ResourceMonitor::formatMs(m_runner->elapsedMs());
+    }
+    // Settings that will not take effect stay in view for the whole run
+    if (!m_runner->warnings().isEmpty()) {
+        text += "\n" + tr("Scheduling: %1").arg(m_runner->warnings().join("; "));
+    }
+    m_lblProgress->setText(text);
+}
+
+void WorkflowDialog::showNodeOutput()
+{
+    if (m_selectedNode < 0 || m_selectedNode >= m_runner->nodeCount()) {
+        return;
+    }
+    QByteArray output = m_runner->output(m_selectedNode);
+    if (output.size() == m_shownOutputSize) {
+        return;
+    }
+    m_shownOutputSize = output.size();
+
+    const WorkflowRunner::Node &node = m_runner->node(m_selectedNode);
+    m_outputText->setPlainText(QString("$ %1\n(in %2)\n\n%3")
+                                   .arg(node.commandLine, node.workingDirectory, QString::fromLocal8Bit(output)));
+    m_outputText->moveCursor(QTextCursor::End);
+}
@@ -0,0 +1,82 @@
+#ifndef WORKFLOWDIALOG_H
+#define WORKFLOWDIALOG_H
+
+#include <QDialog>
+#include <QJsonObject>
+#include <QVector>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QPlainTextEdit>
+
+class QGraphicsScene;
+class QGraphicsView;
+class QGraphicsRectItem;
+class QGraphicsSimpleTextItem;
+class QGraphicsPathItem;
+class QTimer;
+class WorkflowRunner;
+
+// Runs the workflows of the config and draws their graph live: node state,
+// timings, and the critical path through it
+class WorkflowDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit WorkflowDialog(QWidget *parent = nullptr);
+
+    // workflows is the "workflows" object of the config, by name
+    void setWorkflows(const QJsonObject &workflows, const QJsonObject &topics);
+    void selectWorkflow(const QString &name);
+
+public slots:
+    void reject() override;
+
+private slots:
+    void onWorkflowChanged(int index);
+    void onStartClicked();
+    void onStopClicked();
+    void onNodeChanged(int index);
+    void onFinished(bool succeeded);
+    void onSelectionChanged();
+
+private:
+    struct NodeItems {
+        QGraphicsRectItem *box = nullptr;
+        QGraphicsSimpleTextItem *title = nullptr;
+        QGraphicsSimpleTextItem *timing = nullptr;
+    };
+    struct EdgeItem {
+        int from;
+        int to;
+        QGraphicsPathItem *path;
+    };
+
+    void buildScene();
+    void updateNode(int index);
+    void updateCriticalPath();
+    void updateProgress();
+    void showNodeOutput();
+
+    QComboBox *m_workflowComboBox;
+    QSpinBox *m_parallelSpinBox;
+    QPushButton *m_btnStart;
+    QPushButton *m_btnStop;
+    QLabel *m_lblProgress;
+    QLabel *m_lblCriticalPath;
+    QGraphicsScene *m_scene;
+    QGraphicsView *m_view;
+    QPlainTextEdit *m_outputText;
+    QTimer *m_refreshTimer;
+    WorkflowRunner *m_runner;
+    QJsonObject m_workflows;
+    QJsonObject m_topics;
+    QVector<NodeItems> m_nodeItems;
+    QVector<EdgeItem> m_edges;
+    int m_selectedNode = -1;
+    int m_shownOutputSize = -1;
+};
+
+#endif // WORKFLOWDIALOG_H
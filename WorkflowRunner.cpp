@@ -0,0 +1,363 @@
+#include "WorkflowRunner.h"
+#include "CommandLine.h"
+#include "ProcessPool.h"
+
+#include <QDir>
+#include <QJsonArray>
+#include <QStringList>
+
+WorkflowRunner::WorkflowRunner(QObject *parent)
+    : QObject(parent)
+    , m_pool(new ProcessPool(this))
+{
+    connect(m_pool, &ProcessPool::jobStarted, this, &WorkflowRunner::onJobStarted);
+    connect(m_pool, &ProcessPool::jobFinished, this, &WorkflowRunner::onJobFinished);
+    connect(m_pool, &ProcessPool::allFinished, this, &WorkflowRunner::onAllFinished);
+}
+
+bool WorkflowRunner::load(const QJsonObject &workflow, const QJsonObject &topics, QString *errorMessage)
+{
+    cancel();
+    m_nodes.clear();
+    m_order.clear();
+    m_warnings.clear();
+
+    const QJsonArray nodes = workflow["nodes"].toArray();
+    if (nodes.isEmpty()) {
+        *errorMessage = tr("The workflow has no nodes");
+        return false;
+    }
+
+    // Commands may be given without their topic when the workflow names one
+    QString topic = workflow["topic"].toString();
+    QMap<QString, int> indexes;
+    for (const QJsonValue &value : nodes) {
+        const QJsonObject object = value.toObject();
+        Node node;
+        node.command = object["command"].toString();
+        node.id = object["id"].toString(node.command);
+        if (node.id.isEmpty()) {
+            *errorMessage = tr("Node %1 has neither an id nor a command").arg(m_nodes.size() + 1);
+            m_nodes.clear();
+            return false;
+        }
+        if (indexes.contains(node.id)) {
+            *errorMessage = tr("Duplicate node id \"%1\"").arg(node.id);
+            m_nodes.clear();
+            return false;
+        }
+
+        QJsonObject command;
+        if (!CommandLine::findCommand(topics, node.command, &command)
+            && (topic.isEmpty() || !CommandLine::findCommand(topics, topic + "/" + node.command, &command))) {
+            *errorMessage = tr("Node \"%1\": no command \"%2\"").arg(node.id, node.command);
+            m_nodes.clear();
+            return false;
+        }
+
+        // Argument values on top of the command's defaults, as --set does
+        CommandLine::Values values = CommandLine::defaults(command);
+        QString error;
+        if (!CommandLine::setValues(command, object["set"].toObject(), &values, &error)) {
+            *errorMessage = tr("Node \"%1\": %2").arg(node.id, error);
+            m_nodes.clear();
+            return false;
+        }
+        values.misc = object["misc"].toString();
+        node.commandLine = CommandLine::build(command, values, &error);
+        if (node.commandLine.isEmpty()) {
+            *errorMessage = tr("Node \"%1\": %2").arg(node.id, error);
+            m_nodes.clear();
+            return false;
+        }
+
+        node.workingDirectory = object["working_directory"].toString(
+            command.value("working_directory").toString(workflow["working_directory"].toString()));
+        node.workingDirectory = node.workingDirectory.isEmpty() ? QDir::homePath() : CommandLine::expandHome(node.workingDirectory);
+
+        // The node's own scheduling replaces the command's
+        QJsonObject scheduling = object.contains("scheduling") ? object["scheduling"].toObject()
+                                                                 : command.value("scheduling").toObject();
+        if (!scheduling.isEmpty()) {
+            QSharedPointer<Scheduling::Prepared> prepared(new Scheduling::Prepared);
+            QStringList warnings;
+            if (!Scheduling::prepare(scheduling, prepared.data(), &warnings, &error)) {
+                *errorMessage = tr("Node \"%1\": %2").arg(node.id, error);
+                m_nodes.clear();
+                return false;
+            }
+            for (const QString &warning : warnings) {
+                m_warnings.append(tr("Node \"%1\": %2").arg(node.id, warning));
+            }
+            node.scheduling = prepared;
+        }
+
+        indexes.insert(node.id, m_nodes.size());
+        m_nodes.append(node);
+    }
+
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        for (const QJsonValue &dependency : nodes[i].toObject()["depends_on"].toArray()) {
+            QString id = dependency.toString();
+            if (!indexes.contains(id)) {
+                *errorMessage = tr("Node \"%1\" depends on unknown node \"%2\"").arg(m_nodes[i].id, id);
+                m_nodes.clear();
+                return false;
+            }
+            int from = indexes.value(id);
+            if (!m_nodes[i].dependsOn.contains(from)) {
+                m_nodes[i].dependsOn.append(from);
+                m_nodes[from].dependents.append(i);
+            }
+        }
+    }
+
+    // Kahn's algorithm: whatever never gets free of dependencies is on a cycle
+    QVector<int> pending(m_nodes.size());
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        pending[i] = m_nodes[i].dependsOn.size();
+        if (pending[i] == 0) {
+            m_order.append(i);
+        }
+    }
+    for (int k = 0; k < m_order.size(); ++k) {
+        const Node &node = m_nodes[m_order[k]];
+        for (int dependent : node.dependents) {
+            m_nodes[dependent].layer = qMax(m_nodes[dependent].layer, node.layer + 1);
+            if (--pending[dependent] == 0) {
+                m_order.append(dependent);
+            }
+        }
+    }
+    if (m_order.size() < m_nodes.size()) {
+        QStringList cycle;
+        for (int i = 0; i < m_nodes.size(); ++i) {
+            if (pending[i] > 0) {
+                cycle.append(m_nodes[i].id);
+            }
+        }
+        *errorMessage = tr("Dependency cycle among: %1").arg(cycle.join(", "));
+        m_nodes.clear();
+        m_order.clear();
+        return false;
+    }
+
+    setMaxParallel(workflow["max_parallel"].toInt(maxParallel()));
+    return true;
+}
+
+void WorkflowRunner::setMaxParallel(int maxParallel)
+{
+    m_pool->setMaxConcurrent(maxParallel);
+}
+
+int WorkflowRunner::maxParallel() const
+{
+    return m_pool->maxConcurrent();
+}
+
+void WorkflowRunner::start()
+{
+    if (m_running || m_nodes.isEmpty()) {
+        return;
+    }
+    m_pool->clear();
+    m_jobNodes.clear();
+    m_cancelled = false;
+    m_running = true;
+    m_totalMs = 0;
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        Node &node = m_nodes[i];
+        node.state = Waiting;
+        node.exitCode = -1;
+        node.startMs = -1;
+        node.elapsedMs = 0;
+        node.job = -1;
+        emit nodeChanged(i);
+    }
+    m_timer.start();
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].dependsOn.isEmpty()) {
+            enqueue(i);
+        }
+    }
+    m_pool->start();
+}
+
+void WorkflowRunner::cancel()
+{
+    if (!m_running) {
+        return;
+    }
+    m_cancelled = true;
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].state == Waiting || m_nodes[i].state == Ready) {
+            m_nodes[i].state = Skipped;
+            emit nodeChanged(i);
+        }
+    }
+    // Running nodes end as failed when the kill lands; the pool reports allFinished then
+    bool anyRunning = m_pool->runningCount() > 0;
+    m_pool->cancel();
+    if (!anyRunning) {
+        onAllFinished();
+    }
+}
+
+QByteArray WorkflowRunner::output(int index) const
+{
+    int job = m_nodes.at(index).job;
+    return job >= 0 && job < m_pool->jobCount() ? m_pool->job(job).output : QByteArray();
+}
+
+int WorkflowRunner::layerCount() const
+{
+    int layers = 0;
+    for (const Node &node : m_nodes) {
+        layers = qMax(layers, node.layer + 1);
+    }
+    return layers;
+}
+
+qint64 WorkflowRunner::elapsedMs() const
+{
+    return m_running ? m_timer.elapsed() : m_totalMs;
+}
+
+qint64 WorkflowRunner::nodeTimeMs(int index) const
+{
+    const Node &node = m_nodes.at(index);
+    if (node.state == Running) {
+        return m_timer.elapsed() - node.startMs;
+    }
+    return node.elapsedMs;
+}
+
+QVector<int> WorkflowRunner::criticalPath(qint64 *totalMs) const
+{
+    // Longest path through the DAG, nodes weighted by their time
+    QVector<qint64> finish(m_nodes.size(), 0);
+    QVector<int> previous(m_nodes.size(), -1);
+    int last = -1;
+    for (int index : m_order) {
+        qint64 ready = 0;
+        for (int dependency : m_nodes[index].dependsOn) {
+            if (previous[index] < 0 || finish[dependency] > ready) {
+                ready = finish[dependency];
+                previous[index] = dependency;
+            }
+        }
+        finish[index] = ready + nodeTimeMs(index);
+        if (last < 0 || finish[index] > finish[last]) {
+            last = index;
+        }
+    }
+
+    QVector<int> path;
+    for (int index = last; index >= 0; index = previous[index]) {
+        path.prepend(index);
+    }
+    if (totalMs) {
+        *totalMs = last >= 0 ? finish[last] : 0;
+    }
+    return path;
+}
+
+QString WorkflowRunner::stateName(NodeState state)
+{
+    switch (state) {
+    case Waiting:
+        return tr("waiting");
+    case Ready:
+        return tr("queued");
+    case Running:
+        return tr("running");
+    case Succeeded:
+        return tr("done");
+    case Failed:
+        return tr("failed");
+    case Skipped:
+        return tr("skipped");
+    }
+    return QString();
+}
+
+void WorkflowRunner::enqueue(int index)
+{
+    Node &node = m_nodes[index];
+    node.state = Ready;
+    node.job = m_pool->addJob(node.commandLine, node.workingDirectory, node.scheduling);
+    m_jobNodes.insert(node.job, index);
+    emit nodeChanged(index);
+}
+
+void WorkflowRunner::skipDownstream(int index)
+{
+    for (int dependent : m_nodes[index].dependents) {
+        if (m_nodes[dependent].state == Waiting) {
+            m_nodes[dependent].state = Skipped;
+            emit nodeChanged(dependent);
+            skipDownstream(dependent);
+        }
+    }
+}
+
+void WorkflowRunner::onJobStarted(int job)
+{
+    int index = m_jobNodes.value(job, -1);
+    if (index < 0) {
+        return;
+    }
+    m_nodes[index].state = Running;
+    m_nodes[index].startMs = m_timer.elapsed();
+    emit nodeChanged(index);
+}
+
+void WorkflowRunner::onJobFinished(int job)
+{
+    int index = m_jobNodes.value(job, -1);
+    if (index < 0) {
+        return;
+    }
+    Node &node = m_nodes[index];
+    node.exitCode = m_pool->job(job).exitCode;
+    node.elapsedMs = m_pool->job(job).elapsedMs;
+    node.state = node.exitCode == 0 ? Succeeded : Failed;
+    emit nodeChanged(index);
+
+    if (node.state == Failed) {
+        skipDownstream(index);
+        return;
+    }
+    // Queued from here, the pool picks them up before it checks whether it is done
+    for (int dependent : m_nodes[index].dependents) {
+        if (m_cancelled || m_nodes[dependent].state != Waiting) {
+            continue;
+        }
+        bool ready = true;
+        for (int dependency : m_nodes[dependent].dependsOn) {
+            ready = ready && m_nodes[dependency].state == Succeeded;
+        }
+        if (ready) {
+            enqueue(dependent);
+        }
+    }
+}
+
+void WorkflowRunner::onAllFinished()
+{
+    if (!m_running) {
+        return;
+    }
+    m_totalMs = m_timer.elapsed();
+    m_running = false;
+    bool succeeded = !m_cancelled;
+    for (int i = 0; i < m_nodes.size(); ++i) {
+        if (m_nodes[i].state == Waiting || m_nodes[i].state == Ready) {
+            m_nodes[i].state = Skipped;
+            emit nodeChanged(i);
+        }
+        succeeded = succeeded && m_nodes[i].state == Succeeded;
+    }
+    emit finished(succeeded);
+}
@@ -0,0 +1,99 @@
+#ifndef WORKFLOWRUNNER_H
+#define WORKFLOWRUNNER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMap>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+#include "Scheduling.h"
+
+class ProcessPool;
+
+// Runs the commands of a workflow (a DAG declared in the "workflows" section)
+// as soon as everything they depend on succeeded, at most maxParallel at once.
+// A failure skips everything downstream of it; independent branches go on.
+class WorkflowRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum NodeState {
+        Waiting,
+        Ready,      // dependencies done, waiting for a free slot
+        Running,
+        Succeeded,
+        Failed,
+        Skipped
+    };
+
+    struct Node {
+        QString id;
+        QString command;            // "<topic>/<command>" as given
+        QString commandLine;
+        QString workingDirectory;
+        QSharedPointer<const Scheduling::Prepared> scheduling;  // null without one
+        QVector<int> dependsOn;
+        QVector<int> dependents;
+        int layer = 0;              // longest distance from a node without dependencies
+        NodeState state = Waiting;
+        int exitCode = -1;
+        qint64 startMs = -1;        // since the start of the workflow
+        qint64 elapsedMs = 0;
+        int job = -1;
+    };
+
+    explicit WorkflowRunner(QObject *parent = nullptr);
+
+    // Resolves the nodes against the topics; fails on unknown commands or
+    // dependencies and on cycles
+    bool load(const QJsonObject &workflow, const QJsonObject &topics, QString *errorMessage);
+    // Scheduling settings of the loaded nodes that will not take effect
+    QStringList warnings() const { return m_warnings; }
+
+    void setMaxParallel(int maxParallel);
+    int maxParallel() const;
+
+    void start();
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+    int nodeCount() const { return m_nodes.size(); }
+    const Node &node(int index) const { return m_nodes.at(index); }
+    QByteArray output(int index) const;
+    int layerCount() const;
+
+    // Wall time of the whole workflow so far
+    qint64 elapsedMs() const;
+    // Time of a node, counting running ones up to now
+    qint64 nodeTimeMs(int index) const;
+    // Longest chain of dependent nodes by time, first node first
+    QVector<int> criticalPath(qint64 *totalMs = nullptr) const;
+
+    static QString stateName(NodeState state);
+
+signals:
+    void nodeChanged(int index);
+    void finished(bool succeeded);
+
+private:
+    void enqueue(int index);
+    void skipDownstream(int index);
+    void onJobStarted(int job);
+    void onJobFinished(int job);
+    void onAllFinished();
+
+    ProcessPool *m_pool;
+    QVector<Node> m_nodes;
+    QVector<int> m_order;           // topological
+    QStringList m_warnings;
+    QMap<int, int> m_jobNodes;
+    QElapsedTimer m_timer;
+    qint64 m_totalMs = 0;
+    bool m_running = false;
+    bool m_cancelled = false;
+};
+
+#endif // WORKFLOWRUNNER_H
@@ -1,4 +1,6 @@
 #include "MainWindow.h"
+#include "Launcher.h"
+#include "Cli.h"
 #include <QApplication>
 #include <QEvent>
 #include <QKeyEvent>
@@ -9,6 +11,19 @@
 
 int main(int argc, char *argv[])
 {
+    // Scripts and cron: run a configured command without any of the GUI
+    if (Cli::requested(argc, argv)) {
+        return Cli::run(argc, argv);
+    }
+
+    // A second plain "quish" brings the running one to the front instead
+    if (argc == 1 && Cli::raiseRunningInstance()) {
+        return 0;
+    }
+
+    // Fork the launcher while this process is still small and single-threaded
+    Launcher::preFork();
+
     qputenv("QT_IM_MODULE", QByteArray("simple"));
     QApplication a(argc, argv);
     a.setWindowIcon(QIcon(":/pix/Quish.png"));
@@ -29,6 +29,8 @@ Settings::Settings(QObject *parent)
     defaults["minimizeToTray"] = QVariant(false);
     defaults["confirmExit"] = QVariant(true);
     defaults["statusBarTimeout"] = QVariant(3000); // Default to 3 seconds
+    defaults["useLauncher"] = QVariant(true);
+    defaults["stopSequence"] = QVariant("INT:2 TERM:5 KILL");
 
     // Read the settings from user's settings
     read();
@@ -131,6 +133,22 @@ void Settings::form(QWidget *w) {
     });
     form->addRow(lblConfirmExit, chkConfirmExit);
 
+    QLabel *lblUseLauncher = new QLabel(tr("Start commands from the pre-forked launcher"));
+    QCheckBox *chkUseLauncher = new QCheckBox();
+    chkUseLauncher->setChecked(get("useLauncher").toBool());
+    connect(chkUseLauncher, &QCheckBox::toggled, this, [this, chkUseLauncher]() {
+        handleCheckBoxChanged(chkUseLauncher, "useLauncher");
+    });
+    form->addRow(lblUseLauncher, chkUseLauncher);
+
+    QLabel *lblStopSequence = new QLabel(tr("Break sends to the process group"));
+    QLineEdit *txtStopSequence = new QLineEdit(get("stopSequence").toString());
+    txtStopSequence->setToolTip(tr("Signals with the seconds to wait before the next one"));
+    connect(txtStopSequence, &QLineEdit::editingFinished, this, [this, txtStopSequence]() {
+        handleLineEditChanged(txtStopSequence, "stopSequence");
+    });
+    form->addRow(lblStopSequence, txtStopSequence);
+
     // Status Bar Message Timeout setting
     QLabel *lblStatusBarTimeout = new QLabel(tr("Status Bar Message Timeout (ms)"));
     QSpinBox *spnStatusBarTimeout = new QSpinBox();
@@ -200,3 +218,13 @@ void Settings::handleSpinBoxChanged(QSpinBox *spinBox, const QString &param) {
     emit settingChanged(param, value);
     write();
 }
+
+//******************************************************************************
+// handleLineEditChanged()
+//******************************************************************************
+void Settings::handleLineEditChanged(QLineEdit *txt, const QString &param) {
+    QVariant value = QVariant(txt->text());
+    settings[param] = value;
+    emit settingChanged(param, value);
+    write();
+}
@@ -32,6 +32,7 @@ private:
     void handleTextChanged(QLabel *lbl, QLineEdit *txt); // Forward declaration
     void handleCheckBoxChanged(QCheckBox *chk, const QString &param); // New handler for checkboxes
     void handleSpinBoxChanged(QSpinBox *spinBox, const QString &param);
+    void handleLineEditChanged(QLineEdit *txt, const QString &param);
 };
 
 #endif // SETTINGS_H